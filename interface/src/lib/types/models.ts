@@ -305,6 +305,8 @@ export type Packet = {
 	data: Uint8Array;
 	counter: number;
 	hash: number;
+	rssi?: number; // dBm, of first occurrence
+	lqi?: number; // Link quality indicator, of first occurrence
 	generalInfo: GeneralInfo | null;
 	specificInfo: CommissioningInfo | DiscoveryResponseInfo | AlarmStartInfo | AlarmStopInfo | null;
 };
@@ -0,0 +1,105 @@
+/**
+ * Decoder for the binary frames sent by the WebSocket logger (/ws/logger)
+ *
+ * Frame (little endian):
+ *   header: version (u8), number of records (u8), flags (u16), base timestamp in us (u64)
+ *   record: timestamp delta in us (u32), length (u8), RSSI (i8), LQI (u8), flags (u8), payload[length]
+ */
+
+export const WSLOGGER_FORMAT_VERSION = 1;
+export const WSLOGGER_FLAG_CRC_OK = 0x01;
+export const WSLOGGER_FRAME_FLAG_HISTORY = 0x0001;
+
+const FRAME_HEADER_SIZE = 12;
+const RECORD_HEADER_SIZE = 8;
+
+export interface LoggedPacket {
+  /** Lower 32 bits of the receive timestamp in microseconds */
+  timestamp: number;
+  /** Received signal strength in dBm */
+  rssi: number;
+  /** Link quality indicator */
+  lqi: number;
+  /** Record flags (WSLOGGER_FLAG_*) */
+  flags: number;
+  /** Packet was received before the client connected (sent from the gateway's packet history) */
+  history: boolean;
+  /** Packet data (without CC1101 length and status bytes) */
+  data: Uint8Array;
+}
+
+/**
+ * Convert the raw RSSI value appended by CC1101 to dBm
+ */
+function rssiToDbm(raw: number): number {
+  return raw / 2 - 74;
+}
+
+/**
+ * Decode a binary WebSocket logger frame into its packets.
+ * Returns an empty array for frames of an unsupported version or malformed frames.
+ */
+export function decodeLoggerFrame(buffer: ArrayBuffer): LoggedPacket[] {
+  const packets: LoggedPacket[] = [];
+  if (buffer.byteLength < FRAME_HEADER_SIZE) return packets;
+
+  const dv = new DataView(buffer);
+  const version = dv.getUint8(0);
+  if (version !== WSLOGGER_FORMAT_VERSION) {
+    console.warn(`Unsupported WebSocket logger frame version: ${version}`);
+    return packets;
+  }
+
+  const numRecords = dv.getUint8(1);
+  const history = (dv.getUint16(2, true) & WSLOGGER_FRAME_FLAG_HISTORY) !== 0;
+  const baseTimestamp = dv.getUint32(4, true); // Lower 32 bits of the 64 bit base timestamp
+
+  let offset = FRAME_HEADER_SIZE;
+  for (let i = 0; i < numRecords; i++) {
+    if (offset + RECORD_HEADER_SIZE > buffer.byteLength) break;
+
+    const length = dv.getUint8(offset + 4);
+    if (offset + RECORD_HEADER_SIZE + length > buffer.byteLength) break;
+
+    packets.push({
+      timestamp: (baseTimestamp + dv.getUint32(offset, true)) >>> 0,
+      rssi: rssiToDbm(dv.getInt8(offset + 5)),
+      lqi: dv.getUint8(offset + 6),
+      flags: dv.getUint8(offset + 7),
+      history: history,
+      data: new Uint8Array(buffer, offset + RECORD_HEADER_SIZE, length)
+    });
+
+    offset += RECORD_HEADER_SIZE + length;
+  }
+
+  return packets;
+}
+
+/**
+ * Server-side filter for the packets sent to this client.
+ * All fields are optional; an empty filter clears a previously set one.
+ */
+export interface LoggerFilter {
+  /** Accepted genius packet types (-1 = unknown, 0 = commissioning, ..., 6 = line test stop) */
+  packetTypes?: number[];
+  /** Accepted origin radio module serial numbers */
+  origins?: number[];
+  /** Accepted sender radio module serial numbers */
+  senders?: number[];
+  /** Accepted alarm line IDs */
+  lines?: number[];
+  /** Minimum RSSI in dBm */
+  minRssi?: number;
+  /** Send repeated packets (default: true) */
+  duplicates?: boolean;
+  /** Send only every Nth matching packet (default: 1) */
+  sample?: number;
+}
+
+/**
+ * Encode a filter frame to be sent to the WebSocket logger
+ */
+export function encodeLoggerFilter(filter: LoggerFilter): string {
+  return JSON.stringify({ type: 'filter', ...filter });
+}
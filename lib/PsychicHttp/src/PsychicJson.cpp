@@ -1,4 +1,5 @@
 #include "PsychicJson.h"
+#include <algorithm>
 
 #ifdef ARDUINOJSON_6_COMPATIBILITY
   PsychicJsonResponse::PsychicJsonResponse(PsychicRequest *request, bool isArray, size_t maxJsonBufferSize) :
@@ -81,51 +82,121 @@ esp_err_t PsychicJsonResponse::send()
   return err;
 }
 
+PsychicBodyReader::PsychicBodyReader(PsychicRequest *request) :
+  _req(request->request()),
+  _remaining(request->contentLength()),
+  _length(0),
+  _position(0),
+  _failed(false)
+{}
+
+bool PsychicBodyReader::fill()
+{
+  while (_remaining > 0)
+  {
+    int received = httpd_req_recv(_req, _buffer, std::min(_remaining, sizeof(_buffer)));
+
+    if (received == HTTPD_SOCK_ERR_TIMEOUT)
+      continue;
+    else if (received <= 0)
+    {
+      ESP_LOGE(PH_TAG, "Failed to receive data.");
+      _failed = true;
+      _remaining = 0;
+      return false;
+    }
+
+    _remaining -= received;
+    _length = received;
+    _position = 0;
+    return true;
+  }
+
+  return false;
+}
+
+int PsychicBodyReader::read()
+{
+  if (_position >= _length && !fill())
+    return -1;
+
+  return (uint8_t)_buffer[_position++];
+}
+
+size_t PsychicBodyReader::readBytes(char *buffer, size_t length)
+{
+  size_t copied = 0;
+  while (copied < length && (_position < _length || fill()))
+  {
+    size_t chunk = std::min(length - copied, _length - _position);
+    memcpy(buffer + copied, _buffer + _position, chunk);
+    _position += chunk;
+    copied += chunk;
+  }
+
+  return copied;
+}
+
 #ifdef ARDUINOJSON_6_COMPATIBILITY
   PsychicJsonHandler::PsychicJsonHandler(size_t maxJsonBufferSize) :
     _onRequest(NULL),
     _maxJsonBufferSize(maxJsonBufferSize)
-  {};
+  {
+    //JSON is deserialized straight from the socket
+    _bufferBody = false;
+  };
 
   PsychicJsonHandler::PsychicJsonHandler(PsychicJsonRequestCallback onRequest, size_t maxJsonBufferSize) :
     _onRequest(onRequest),
     _maxJsonBufferSize(maxJsonBufferSize)
-  {}
+  {
+    //JSON is deserialized straight from the socket
+    _bufferBody = false;
+  }
 #else
   PsychicJsonHandler::PsychicJsonHandler() :
     _onRequest(NULL)
-  {};
+  {
+    //JSON is deserialized straight from the socket
+    _bufferBody = false;
+  };
 
   PsychicJsonHandler::PsychicJsonHandler(PsychicJsonRequestCallback onRequest) :
     _onRequest(onRequest)
-  {}
+  {
+    //JSON is deserialized straight from the socket
+    _bufferBody = false;
+  }
 #endif
 
 void PsychicJsonHandler::onRequest(PsychicJsonRequestCallback fn) { _onRequest = fn; }
 
 esp_err_t PsychicJsonHandler::handleRequest(PsychicRequest *request)
 {
-  //process basic stuff
-  PsychicWebHandler::handleRequest(request);
+  //process basic stuff, checks the body size up front but leaves the body on the socket
+  esp_err_t err = PsychicWebHandler::handleRequest(request);
+  if (err != ESP_OK)
+    return err;
 
   if (_onRequest)
   {
+    //deserialize straight from the socket, the body is never held as text
+    PsychicBodyReader reader(request);
+
     #ifdef ARDUINOJSON_6_COMPATIBILITY
       DynamicJsonDocument jsonBuffer(this->_maxJsonBufferSize);
-      DeserializationError error = deserializeJson(jsonBuffer, request->body());
-      if (error)
-        return request->reply(400);
-
-      JsonVariant json = jsonBuffer.as<JsonVariant>();
+      DeserializationError error = deserializeJson(jsonBuffer, reader);
     #else
       JsonDocument jsonBuffer;
-      DeserializationError error = deserializeJson(jsonBuffer, request->body());
-      if (error)
-        return request->reply(400);
-
-      JsonVariant json = jsonBuffer.as<JsonVariant>();
+      DeserializationError error = deserializeJson(jsonBuffer, reader);
     #endif
 
+    if (reader.failed())
+      return ESP_FAIL;
+    if (error)
+      return request->reply(400);
+
+    JsonVariant json = jsonBuffer.as<JsonVariant>();
     return _onRequest(request, json);
   }
   else
@@ -62,6 +62,33 @@ class PsychicJsonResponse : public PsychicResponse
     virtual esp_err_t send() override;
 };
 
+/*
+ * Reads the request body straight from the socket in small chunks,
+ * so ArduinoJson can deserialize it without buffering the whole body.
+ * */
+
+class PsychicBodyReader
+{
+  protected:
+    httpd_req_t *_req;
+    size_t _remaining;
+    char _buffer[128];
+    size_t _length;
+    size_t _position;
+    bool _failed;
+
+    bool fill();
+
+  public:
+    PsychicBodyReader(PsychicRequest *request);
+
+    int read();
+    size_t readBytes(char *buffer, size_t length);
+
+    //the connection broke before the whole body was received
+    bool failed() { return _failed; }
+};
+
 class PsychicJsonHandler : public PsychicWebHandler
 {
   protected:
@@ -160,7 +160,9 @@ esp_err_t PsychicStaticFileHandler::handleRequest(PsychicRequest *request)
     if (_file == true)
     {
         // is it not modified?
-        String etag = String(_file.size());
+        // quoted size and modification time, the size alone misses same sized changes
+        char etag[28];
+        snprintf(etag, sizeof(etag), "\"%x-%llx\"", (unsigned)_file.size(), (unsigned long long)_file.getLastWrite());
         if (_last_modified.length() && _last_modified == request->header("If-Modified-Since"))
         {
             _file.close();
@@ -173,7 +175,7 @@ esp_err_t PsychicStaticFileHandler::handleRequest(PsychicRequest *request)
 
             PsychicResponse response(request);
             response.addHeader("Cache-Control", _cache_control.c_str());
-            response.addHeader("ETag", etag.c_str());
+            response.addHeader("ETag", etag);
             response.setCode(304);
             response.send();
         }
@@ -187,7 +189,7 @@ esp_err_t PsychicStaticFileHandler::handleRequest(PsychicRequest *request)
             if (_cache_control.length())
             {
                 response.addHeader("Cache-Control", _cache_control.c_str());
-                response.addHeader("ETag", etag.c_str());
+                response.addHeader("ETag", etag);
             }
 
             _file.close();
@@ -4,7 +4,9 @@ PsychicWebHandler::PsychicWebHandler() :
   PsychicHandler(),
   _requestCallback(NULL),
   _onOpen(NULL),
-  _onClose(NULL)
+  _onClose(NULL),
+  _maxBodySize(0),
+  _bufferBody(true)
   {}
 PsychicWebHandler::~PsychicWebHandler() {}
 
@@ -20,23 +22,28 @@ esp_err_t PsychicWebHandler::handleRequest(PsychicRequest *request)
     openCallback(client);
 
   /* Request body cannot be larger than a limit */
-  if (request->contentLength() > request->server()->maxRequestBodySize)
+  size_t maxBodySize = _maxBodySize ? _maxBodySize : request->server()->maxRequestBodySize;
+  if (request->contentLength() > maxBodySize)
   {
     ESP_LOGE(PH_TAG, "Request body too large : %d bytes", request->contentLength());
 
     /* Respond with 400 Bad Request */
     char error[60];
-    sprintf(error, "Request body must be less than %lu bytes!", request->server()->maxRequestBodySize);
+    sprintf(error, "Request body must be less than %u bytes!", maxBodySize);
     httpd_resp_send_err(request->request(), HTTPD_400_BAD_REQUEST, error);
 
     /* Return failure to close underlying connection else the incoming file content will keep the socket busy */
     return ESP_FAIL;
   }
 
-  //get our body loaded up.
-  esp_err_t err = request->loadBody();
-  if (err != ESP_OK)
-    return err;
+  //get our body loaded up, unless the handler reads it from the socket itself.
+  esp_err_t err = ESP_OK;
+  if (_bufferBody)
+  {
+    err = request->loadBody();
+    if (err != ESP_OK)
+      return err;
+  }
 
   //load our params in.
   request->loadParams();
@@ -53,6 +60,11 @@ PsychicWebHandler * PsychicWebHandler::onRequest(PsychicHttpRequestCallback fn)
   return this;
 }
 
+PsychicWebHandler * PsychicWebHandler::setMaxBodySize(size_t size) {
+  _maxBodySize = size;
+  return this;
+}
+
 void PsychicWebHandler::openCallback(PsychicClient *client) {
   if (_onOpen != NULL)
     _onOpen(client);
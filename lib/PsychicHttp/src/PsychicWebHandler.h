@@ -15,6 +15,8 @@ class PsychicWebHandler : public PsychicHandler {
     PsychicHttpRequestCallback _requestCallback;
     PsychicClientCallback _onOpen;
     PsychicClientCallback _onClose;
+    size_t _maxBodySize; // 0 = server->maxRequestBodySize
+    bool _bufferBody; // load the body into request->body() before calling back
 
   public:
     PsychicWebHandler();
@@ -23,6 +25,7 @@ class PsychicWebHandler : public PsychicHandler {
     virtual bool canHandle(PsychicRequest *request) override;
     virtual esp_err_t handleRequest(PsychicRequest *request) override;
     PsychicWebHandler * onRequest(PsychicHttpRequestCallback fn);
+    PsychicWebHandler * setMaxBodySize(size_t size);
 
     virtual void openCallback(PsychicClient *client);
     virtual void closeCallback(PsychicClient *client);
@@ -45,11 +45,26 @@ esp_err_t PsychicWebSocketRequest::reply(const char *buf)
 /*************************************/
 
 PsychicWebSocketClient::PsychicWebSocketClient(PsychicClient *client)
-  : PsychicClient(client->server(), client->socket())
+  : PsychicClient(client->server(), client->socket()),
+  _handler(NULL),
+  _sendQueueMutex(NULL),
+  _drainScheduled(false),
+  _closing(false),
+  _droppedFrames(0),
+  _consecutiveDrops(0)
 {
 }
 
 PsychicWebSocketClient::~PsychicWebSocketClient() {
+  if (_sendQueueMutex != NULL)
+    vSemaphoreDelete(_sendQueueMutex);
+}
+
+void PsychicWebSocketClient::_enableSendQueue(PsychicWebSocketHandler *handler)
+{
+  _handler = handler;
+  if (_sendQueueMutex == NULL)
+    _sendQueueMutex = xSemaphoreCreateMutex();
 }
 
 esp_err_t PsychicWebSocketClient::sendMessage(httpd_ws_frame_t * ws_pkt)
@@ -74,11 +89,147 @@ esp_err_t PsychicWebSocketClient::sendMessage(const char *buf)
   return this->sendMessage(HTTPD_WS_TYPE_TEXT, buf, strlen(buf));
 }
 
+esp_err_t PsychicWebSocketClient::queueMessage(httpd_ws_type_t op, const void *data, size_t len)
+{
+  const uint8_t *bytes = (const uint8_t*)data;
+  return this->queueMessage(op, std::make_shared<const std::vector<uint8_t>>(bytes, bytes + len));
+}
+
+esp_err_t PsychicWebSocketClient::queueMessage(httpd_ws_type_t op, const PsychicWebSocketPayload &payload)
+{
+  //temporary clients (e.g. of a request) have no queue, send right away
+  if (_sendQueueMutex == NULL || _handler == NULL)
+    return this->sendMessage(op, payload->data(), payload->size());
+
+  bool disconnect = false;
+  esp_err_t ret = ESP_OK;
+
+  xSemaphoreTake(_sendQueueMutex, portMAX_DELAY);
+
+  if (_closing)
+  {
+    xSemaphoreGive(_sendQueueMutex);
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (_sendQueue.size() >= _handler->sendQueueSize())
+  {
+    _droppedFrames++;
+    _consecutiveDrops++;
+
+    uint32_t maxDrops = _handler->maxConsecutiveDrops();
+    if (maxDrops > 0 && _consecutiveDrops >= maxDrops)
+    {
+      _closing = true;
+      disconnect = true;
+    }
+
+    if (_handler->dropPolicy() == PSYCHIC_WS_DROP_NEWEST)
+      ret = ESP_ERR_NO_MEM;
+    else
+      _sendQueue.pop_front();
+  }
+
+  if (ret == ESP_OK && !disconnect)
+  {
+    _sendQueue.push_back({op, payload});
+
+    //let the http server task send it
+    if (!_drainScheduled)
+    {
+      DrainWork *work = new DrainWork({_handler, this->socket()});
+      _drainScheduled = true;
+      if (httpd_queue_work(this->server(), _drainSendQueueWork, work) != ESP_OK)
+      {
+        ESP_LOGE(PH_TAG, "Failed to queue websocket send work (fd=%d)", this->socket());
+        _drainScheduled = false;
+        delete work;
+        ret = ESP_FAIL;
+      }
+    }
+  }
+
+  xSemaphoreGive(_sendQueueMutex);
+
+  if (disconnect)
+  {
+    ESP_LOGW(PH_TAG, "Websocket client (fd=%d) too slow, %u frames dropped -> disconnecting", this->socket(), _droppedFrames);
+    httpd_sess_trigger_close(this->server(), this->socket());
+    return ESP_FAIL;
+  }
+
+  return ret;
+}
+
+void PsychicWebSocketClient::_drainSendQueueWork(void *arg)
+{
+  //runs in the http server task, which is also the one removing clients
+  DrainWork *work = (DrainWork*)arg;
+  PsychicWebSocketClient *client = work->handler->getClient(work->socket);
+  delete work;
+
+  if (client != NULL)
+    client->_drainSendQueue();
+}
+
+void PsychicWebSocketClient::_drainSendQueue()
+{
+  while (true)
+  {
+    xSemaphoreTake(_sendQueueMutex, portMAX_DELAY);
+    if (_sendQueue.empty())
+    {
+      _drainScheduled = false;
+      xSemaphoreGive(_sendQueueMutex);
+      return;
+    }
+    QueuedFrame frame = _sendQueue.front();
+    _sendQueue.pop_front();
+    xSemaphoreGive(_sendQueueMutex);
+
+    if (this->sendMessage(frame.type, frame.payload->data(), frame.payload->size()) != ESP_OK)
+    {
+      xSemaphoreTake(_sendQueueMutex, portMAX_DELAY);
+      _sendQueue.clear();
+      _drainScheduled = false;
+      _closing = true;
+      xSemaphoreGive(_sendQueueMutex);
+
+      ESP_LOGW(PH_TAG, "Websocket send failed (fd=%d) -> disconnecting", this->socket());
+      httpd_sess_trigger_close(this->server(), this->socket());
+      return;
+    }
+
+    xSemaphoreTake(_sendQueueMutex, portMAX_DELAY);
+    _consecutiveDrops = 0;
+    xSemaphoreGive(_sendQueueMutex);
+  }
+}
+
+uint32_t PsychicWebSocketClient::droppedFrames()
+{
+  return _droppedFrames;
+}
+
+size_t PsychicWebSocketClient::queuedFrames()
+{
+  if (_sendQueueMutex == NULL)
+    return 0;
+
+  xSemaphoreTake(_sendQueueMutex, portMAX_DELAY);
+  size_t size = _sendQueue.size();
+  xSemaphoreGive(_sendQueueMutex);
+  return size;
+}
+
 PsychicWebSocketHandler::PsychicWebSocketHandler() :
   PsychicHandler(),
   _onOpen(NULL),
   _onFrame(NULL),
-  _onClose(NULL)
+  _onClose(NULL),
+  _sendQueueSize(PSYCHIC_WS_SEND_QUEUE_SIZE),
+  _dropPolicy(PSYCHIC_WS_DROP_OLDEST),
+  _maxConsecutiveDrops(PSYCHIC_WS_MAX_CONSECUTIVE_DROPS)
   {
   }
 
@@ -104,13 +255,18 @@ PsychicWebSocketClient * PsychicWebSocketHandler::getClient(PsychicClient *clien
 }
 
 void PsychicWebSocketHandler::addClient(PsychicClient *client) {
-  client->_friend = new PsychicWebSocketClient(client);
+  PsychicWebSocketClient *buddy = new PsychicWebSocketClient(client);
+  buddy->_enableSendQueue(this);
+  client->_friend = buddy;
   PsychicHandler::addClient(client);
 }
 
 void PsychicWebSocketHandler::removeClient(PsychicClient *client) {
   PsychicHandler::removeClient(client);
-  delete (PsychicWebSocketClient*)client->_friend;
+  PsychicWebSocketClient *buddy = (PsychicWebSocketClient*)client->_friend;
+  if (buddy != NULL && buddy->droppedFrames() > 0)
+    ESP_LOGI(PH_TAG, "Websocket client (fd=%d) closed, %u frames dropped", client->socket(), buddy->droppedFrames());
+  delete buddy;
   client->_friend = NULL;
 }
 
@@ -224,35 +380,40 @@ PsychicWebSocketHandler * PsychicWebSocketHandler::onClose(PsychicWebSocketClien
   return this;
 }
 
+PsychicWebSocketHandler * PsychicWebSocketHandler::setSendQueue(size_t size, PsychicWebSocketDropPolicy policy, uint32_t maxConsecutiveDrops) {
+  _sendQueueSize = size > 0 ? size : 1;
+  _dropPolicy = policy;
+  _maxConsecutiveDrops = maxConsecutiveDrops;
+  return this;
+}
+
 void PsychicWebSocketHandler::sendAll(httpd_ws_frame_t * ws_pkt)
 {
-  for (PsychicClient *client : _clients)
-  {
-    //ESP_LOGD(PH_TAG, "Active client (fd=%d) -> sending async message", client->socket());
-
-    if (client->_friend == NULL)
-    {
-      return;
-    }
-
-    if (((PsychicWebSocketClient*)client->_friend)->sendMessage(ws_pkt) != ESP_OK)
-      break;
-  }
+  this->sendAll(ws_pkt->type, ws_pkt->payload, ws_pkt->len);
 }
 
 void PsychicWebSocketHandler::sendAll(httpd_ws_type_t op, const void *data, size_t len)
 {
-  httpd_ws_frame_t ws_pkt;
-  memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
-
-  ws_pkt.payload = (uint8_t*)data;
-  ws_pkt.len = len;
-  ws_pkt.type = op;
-
-  this->sendAll(&ws_pkt);
+  //one copy of the payload, shared by all client queues
+  const uint8_t *bytes = (const uint8_t*)data;
+  this->sendAll(op, std::make_shared<const std::vector<uint8_t>>(bytes, bytes + len));
 }
 
 void PsychicWebSocketHandler::sendAll(const char *buf)
 {
   this->sendAll(HTTPD_WS_TYPE_TEXT, buf, strlen(buf));
 }
+
+void PsychicWebSocketHandler::sendAll(httpd_ws_type_t op, const PsychicWebSocketPayload &payload)
+{
+  for (PsychicClient *client : _clients)
+  {
+    //ESP_LOGD(PH_TAG, "Active client (fd=%d) -> queueing message", client->socket());
+
+    if (client->_friend == NULL)
+      continue;
+
+    //a slow client only affects its own queue
+    ((PsychicWebSocketClient*)client->_friend)->queueMessage(op, payload);
+  }
+}
@@ -3,16 +3,62 @@
 
 #include "PsychicCore.h"
 #include "PsychicRequest.h"
+#include <deque>
+#include <memory>
+#include <vector>
+
+#ifndef PSYCHIC_WS_SEND_QUEUE_SIZE
+#define PSYCHIC_WS_SEND_QUEUE_SIZE 16 // frames queued per client
+#endif
+
+#ifndef PSYCHIC_WS_MAX_CONSECUTIVE_DROPS
+#define PSYCHIC_WS_MAX_CONSECUTIVE_DROPS 64 // client is disconnected after this many drops without a successful send
+#endif
 
 class PsychicWebSocketRequest;
 class PsychicWebSocketClient;
+class PsychicWebSocketHandler;
 
 //callback function definitions
 typedef std::function<void(PsychicWebSocketClient *client)> PsychicWebSocketClientCallback;
 typedef std::function<esp_err_t(PsychicWebSocketRequest *request, httpd_ws_frame *frame)> PsychicWebSocketFrameCallback;
 
+//frame payload shared by the send queues of all receiving clients
+typedef std::shared_ptr<const std::vector<uint8_t>> PsychicWebSocketPayload;
+
+//what to drop when a client's send queue is full
+enum PsychicWebSocketDropPolicy {
+  PSYCHIC_WS_DROP_OLDEST,
+  PSYCHIC_WS_DROP_NEWEST
+};
+
 class PsychicWebSocketClient : public PsychicClient
 {
+  friend class PsychicWebSocketHandler;
+
+  private:
+    struct QueuedFrame {
+      httpd_ws_type_t type;
+      PsychicWebSocketPayload payload;
+    };
+
+    struct DrainWork {
+      PsychicWebSocketHandler *handler;
+      int socket;
+    };
+
+    PsychicWebSocketHandler *_handler;
+    SemaphoreHandle_t _sendQueueMutex;
+    std::deque<QueuedFrame> _sendQueue;
+    bool _drainScheduled;
+    bool _closing;
+    uint32_t _droppedFrames;
+    uint32_t _consecutiveDrops;
+
+    void _enableSendQueue(PsychicWebSocketHandler *handler);
+    void _drainSendQueue();
+    static void _drainSendQueueWork(void *arg);
+
   public:
     PsychicWebSocketClient(PsychicClient *client);
     ~PsychicWebSocketClient();
@@ -20,6 +66,13 @@ class PsychicWebSocketClient : public PsychicClient
     esp_err_t sendMessage(httpd_ws_frame_t * ws_pkt);
     esp_err_t sendMessage(httpd_ws_type_t op, const void *data, size_t len);
     esp_err_t sendMessage(const char *buf);
+
+    //non-blocking send: frame is queued and sent by the http server task
+    esp_err_t queueMessage(httpd_ws_type_t op, const PsychicWebSocketPayload &payload);
+    esp_err_t queueMessage(httpd_ws_type_t op, const void *data, size_t len);
+
+    uint32_t droppedFrames();
+    size_t queuedFrames();
 };
 
 class PsychicWebSocketRequest : public PsychicRequest
@@ -44,6 +97,10 @@ class PsychicWebSocketHandler : public PsychicHandler {
     PsychicWebSocketFrameCallback _onFrame;
     PsychicWebSocketClientCallback _onClose;
 
+    size_t _sendQueueSize;
+    PsychicWebSocketDropPolicy _dropPolicy;
+    uint32_t _maxConsecutiveDrops;
+
   public:
     PsychicWebSocketHandler();
     ~PsychicWebSocketHandler();
@@ -62,9 +119,17 @@ class PsychicWebSocketHandler : public PsychicHandler {
     PsychicWebSocketHandler *onFrame(PsychicWebSocketFrameCallback fn);
     PsychicWebSocketHandler *onClose(PsychicWebSocketClientCallback fn);
 
+    //per client send queue: size, what to drop if full, and drops without a successful send until disconnect (0 = never)
+    PsychicWebSocketHandler *setSendQueue(size_t size, PsychicWebSocketDropPolicy policy = PSYCHIC_WS_DROP_OLDEST, uint32_t maxConsecutiveDrops = PSYCHIC_WS_MAX_CONSECUTIVE_DROPS);
+    size_t sendQueueSize() { return _sendQueueSize; }
+    PsychicWebSocketDropPolicy dropPolicy() { return _dropPolicy; }
+    uint32_t maxConsecutiveDrops() { return _maxConsecutiveDrops; }
+
+    //queue the frame for all clients (non-blocking)
     void sendAll(httpd_ws_frame_t * ws_pkt);
     void sendAll(httpd_ws_type_t op, const void *data, size_t len);
     void sendAll(const char *buf);
+    void sendAll(httpd_ws_type_t op, const PsychicWebSocketPayload &payload);
 };
 
 #endif // PsychicWebSocket_h
\ No newline at end of file
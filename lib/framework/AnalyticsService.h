@@ -29,7 +29,7 @@ public:
 
     void begin()
     {
-        _socket->registerEvent(EVENT_ANALYTICS);
+        _event = _socket->registerEvent(EVENT_ANALYTICS);
     }
 
     void loop()
@@ -47,6 +47,8 @@ public:
             doc["fs_used"] = ESPFS.usedBytes();
             doc["fs_total"] = ESPFS.totalBytes();
             doc["core_temp"] = temperatureRead();
+            doc["event_emits"] = _socket->getEmitCount();
+            doc["event_emit_avg_us"] = _socket->getAverageEmitTimeUs();
             if (psramFound())
             {
                 doc["free_psram"] = ESP.getFreePsram();
@@ -55,12 +57,13 @@ public:
             }
 
             JsonObject jsonObject = doc.as<JsonObject>();
-            _socket->emitEvent(EVENT_ANALYTICS, jsonObject);
+            _socket->emitEvent(_event, jsonObject);
         }
     };
 
 protected:
     EventSocket *_socket;
+    EventHandle _event = EVENT_HANDLE_INVALID;
 
     unsigned long lastMillis = 0;
 };
@@ -14,6 +14,93 @@
 
 #include <ESP32SvelteKit.h>
 
+#ifdef EMBED_WWW
+#include <WWWData.h>
+
+// Checks a comma separated If-None-Match list for the ETag (weak comparison as in RFC 9110)
+static bool etagMatches(const char *ifNoneMatch, const char *etag)
+{
+    size_t etagLen = strlen(etag);
+    const char *p = ifNoneMatch;
+    while (*p)
+    {
+        while (*p == ' ' || *p == ',')
+            p++;
+        if (*p == '*')
+            return true;
+        if (strncmp(p, "W/", 2) == 0)
+            p += 2;
+        if (strncmp(p, etag, etagLen) == 0 && (p[etagLen] == '\0' || p[etagLen] == ',' || p[etagLen] == ' '))
+            return true;
+        while (*p && *p != ',')
+            p++;
+    }
+    return false;
+}
+
+// Checks an Accept-Encoding list for a content coding not refused with q=0
+static bool acceptsEncoding(const char *acceptEncoding, const char *coding)
+{
+    size_t codingLen = strlen(coding);
+    const char *p = acceptEncoding;
+    while (*p)
+    {
+        while (*p == ' ' || *p == ',')
+            p++;
+        if (strncmp(p, coding, codingLen) == 0 && strchr(" ,;", p[codingLen]))
+        {
+            const char *q = p + codingLen;
+            while (*q == ' ')
+                q++;
+            return !(strncmp(q, ";q=0", 4) == 0 && strspn(q + 4, ".0") == strcspn(q + 4, " ,"));
+        }
+        while (*p && *p != ',')
+            p++;
+    }
+    return false;
+}
+
+// Serves the embedded web app straight from flash, unknown paths get index.html for client side routing
+static esp_err_t serveEmbeddedAsset(PsychicRequest *request)
+{
+    httpd_req_t *req = request->request();
+    if (req->method != HTTP_GET)
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, nullptr);
+
+    size_t pathLen = strcspn(req->uri, "?#");
+    const WWWAsset *asset = WWWData::find(req->uri, pathLen);
+    if (!asset)
+        asset = WWWData::index();
+    if (!asset)
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, nullptr);
+
+    // Header values are read into stack buffers, the response only references flash strings
+    char header[128];
+    bool useBrotli = false;
+    if (asset->br && httpd_req_get_hdr_value_str(req, "Accept-Encoding", header, sizeof(header)) == ESP_OK)
+        useBrotli = acceptsEncoding(header, "br");
+    const char *etag = useBrotli ? asset->etagBr : asset->etag;
+
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", asset->cacheControl);
+    if (asset->br)
+        httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+
+    // Lists longer than the buffer are not evaluated, the asset is just sent again
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", header, sizeof(header)) == ESP_OK && etagMatches(header, etag))
+    {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, nullptr, 0);
+    }
+
+    httpd_resp_set_type(req, asset->mime);
+    httpd_resp_set_hdr(req, "Content-Encoding", useBrotli ? "br" : "gzip");
+    if (useBrotli)
+        return httpd_resp_send(req, (const char *)asset->br, asset->brLen);
+    return httpd_resp_send(req, (const char *)asset->gzip, asset->gzipLen);
+}
+#endif
+
 ESP32SvelteKit::ESP32SvelteKit(PsychicHttpServer *server, unsigned int numberEndpoints) : _server(server),
                                                                                           _numberEndpoints(numberEndpoints),
                                                                                           _featureService(server, &_socket),
@@ -57,6 +144,7 @@ ESP32SvelteKit::ESP32SvelteKit(PsychicHttpServer *server, unsigned int numberEnd
 #if FT_ENABLED(FT_COREDUMP)
                                                                                           _coreDump(server, &_securitySettingsService),
 #endif
+                                                                                          _loopScheduler(server, &_securitySettingsService),
                                                                                           _systemStatus(server, &_securitySettingsService)
 {
 }
@@ -68,38 +156,15 @@ void ESP32SvelteKit::begin()
 
     _wifiSettingsService.initWiFi();
 
-    // SvelteKit uses a lot of handlers, so we need to increase the max_uri_handlers
-    // WWWData has 77 Endpoints, Framework has 27, and Lighstate Demo has 4
+    // The framework and the app use a lot of handlers, so we need to increase the max_uri_handlers
+    // (embedded WWW data is served by the default endpoint and needs none)
     _server->config.max_uri_handlers = _numberEndpoints;
     _server->listen(80);
 
 #ifdef EMBED_WWW
-    // Serve static resources from PROGMEM
-    ESP_LOGV(SVK_TAG, "Registering routes from PROGMEM static resources");
-    WWWData::registerRoutes(
-        [&](const String &uri, const String &contentType, const uint8_t *content, size_t len)
-        {
-            PsychicHttpRequestCallback requestHandler = [contentType, content, len](PsychicRequest *request)
-            {
-                PsychicResponse response(request);
-                response.setCode(200);
-                response.setContentType(contentType.c_str());
-                response.addHeader("Content-Encoding", "gzip");
-                response.addHeader("Cache-Control", "public, immutable, max-age=31536000");
-                response.setContent(content, len);
-                return response.send();
-            };
-            PsychicWebHandler *handler = new PsychicWebHandler();
-            handler->onRequest(requestHandler);
-            _server->on(uri.c_str(), HTTP_GET, handler);
-
-            // Set default end-point for all non matching requests
-            // this is easier than using webServer.onNotFound()
-            if (uri.equals("/index.html"))
-            {
-                _server->defaultEndpoint->setHandler(handler);
-            }
-        });
+    // Serve static resources from PROGMEM by a single handler for all paths without an endpoint
+    ESP_LOGV(SVK_TAG, "Serving %u static resources from PROGMEM", WWWData::NUM_ASSETS);
+    _server->onNotFound(serveEmbeddedAsset);
 #else
     // Serve static resources from /www/
     ESP_LOGV(SVK_TAG, "Registering routes from FS /www/ static resources");
@@ -147,6 +212,7 @@ void ESP32SvelteKit::begin()
     _factoryResetService.begin();
     _featureService.begin();
     _healthCheckService.begin();
+    _loopScheduler.begin();
     _restartService.begin();
     _systemStatus.begin();
     _wifiSettingsService.begin();
@@ -204,6 +270,9 @@ void ESP32SvelteKit::begin()
     _analyticsService.begin();
 #endif
 
+    // Framework services check their own intervals, they only need to be polled
+    _loopScheduler.addTask("framework", std::bind(&ESP32SvelteKit::_loopServices, this), ESP32SVELTEKIT_SERVICES_INTERVAL);
+
     // Start the loop task
     ESP_LOGV(SVK_TAG, "Starting loop task");
     xTaskCreatePinnedToCore(
@@ -219,64 +288,64 @@ void ESP32SvelteKit::begin()
 
 void ESP32SvelteKit::_loop()
 {
-    TickType_t xLastWakeTime = xTaskGetTickCount();
+    _loopScheduler.setLoopTaskHandle(xTaskGetCurrentTaskHandle());
 
+    while (1)
+    {
+        // Run the due tasks and sleep until the next one is due (or a task is pulled forward)
+        TickType_t ticksToNextTask = _loopScheduler.runDue();
+
+#ifdef TELEPLOT_TASKS
+        static int lastTime = 0;
+        if (millis() - lastTime > 1000)
+        {
+            lastTime = millis();
+            Serial.printf(">ESP32SveltekitTask:%i:%i\n", millis(), uxTaskGetStackHighWaterMark(NULL));
+        }
+#endif
+        ulTaskNotifyTake(pdTRUE, ticksToNextTask);
+    }
+}
+
+void ESP32SvelteKit::_loopServices()
+{
     bool wifi = false;
     bool ap = false;
     bool event = false;
     bool mqtt = false;
 
-    while (1)
-    {
-        _wifiSettingsService.loop(); // 30 seconds
-        _apSettingsService.loop();   // 10 seconds
+    _wifiSettingsService.loop(); // 30 seconds
+    _apSettingsService.loop();   // 10 seconds
 #if FT_ENABLED(FT_MQTT)
-        _mqttSettingsService.loop(); // 5 seconds
+    _mqttSettingsService.loop(); // 5 seconds
 #endif
 #if FT_ENABLED(FT_ANALYTICS)
-        _analyticsService.loop();
+    _analyticsService.loop();
 #endif
 
-        // Query the connectivity status
-        wifi = _wifiStatus.isConnected();
-        ap = _apStatus.isActive();
-        event = _socket.getConnectedClients() > 0;
+    // Query the connectivity status
+    wifi = _wifiStatus.isConnected();
+    ap = _apStatus.isActive();
+    event = _socket.getConnectedClients() > 0;
 #if FT_ENABLED(FT_MQTT)
-        mqtt = _mqttStatus.isConnected();
+    mqtt = _mqttStatus.isConnected();
 #endif
 
-        // Update the system status
-        if (wifi && mqtt)
-        {
-            _connectionStatus = ConnectionStatus::STA_MQTT;
-        }
-        else if (wifi)
-        {
-            _connectionStatus = event ? ConnectionStatus::STA_CONNECTED : ConnectionStatus::STA;
-        }
-        else if (ap)
-        {
-            _connectionStatus = event ? ConnectionStatus::AP_CONNECTED : ConnectionStatus::AP;
-        }
-        else
-        {
-            _connectionStatus = ConnectionStatus::OFFLINE;
-        }
-
-        // iterate over all loop functions
-        for (auto &function : _loopFunctions)
-        {
-            function();
-        }
-
-#ifdef TELEPLOT_TASKS
-        static int lastTime = 0;
-        if (millis() - lastTime > 1000)
-        {
-            lastTime = millis();
-            Serial.printf(">ESP32SveltekitTask:%i:%i\n", millis(), uxTaskGetStackHighWaterMark(NULL));
-        }
-#endif
-        vTaskDelayUntil(&xLastWakeTime, ESP32SVELTEKIT_LOOP_INTERVAL / portTICK_PERIOD_MS);
+    // Update the system status
+    if (wifi && mqtt)
+    {
+        _connectionStatus = ConnectionStatus::STA_MQTT;
+    }
+    else if (wifi)
+    {
+        _connectionStatus = event ? ConnectionStatus::STA_CONNECTED : ConnectionStatus::STA;
+    }
+    else if (ap)
+    {
+        _connectionStatus = event ? ConnectionStatus::AP_CONNECTED : ConnectionStatus::AP;
+    }
+    else
+    {
+        _connectionStatus = ConnectionStatus::OFFLINE;
     }
 }
@@ -40,6 +40,7 @@
 #include <SystemStatus.h>
 #include <CoreDump.h>
 #include <HealthCheckService.h>
+#include <LoopScheduler.h>
 #include <WiFiScanner.h>
 #include <WiFiSettingsService.h>
 #include <WiFiStatus.h>
@@ -47,10 +48,6 @@
 #include <PsychicHttp.h>
 #include <vector>
 
-#ifdef EMBED_WWW
-#include <WWWData.h>
-#endif
-
 #ifndef CORS_ORIGIN
 #define CORS_ORIGIN "*"
 #endif
@@ -71,6 +68,11 @@
 #define ESP32SVELTEKIT_LOOP_INTERVAL 10
 #endif
 
+// period of the framework's own services (WiFi, AP, MQTT, analytics) in the loop
+#ifndef ESP32SVELTEKIT_SERVICES_INTERVAL
+#define ESP32SVELTEKIT_SERVICES_INTERVAL 100
+#endif
+
 // define callback function to include into the main loop
 typedef std::function<void()> loopCallback;
 
@@ -202,9 +204,25 @@ public:
         _apSettingsService.recoveryMode();
     }
 
+    LoopScheduler *getLoopScheduler()
+    {
+        return &_loopScheduler;
+    }
+
+    // run a function every ESP32SVELTEKIT_LOOP_INTERVAL, prefer addLoopTask() with the period actually needed
     void addLoopFunction(loopCallback function)
     {
-        _loopFunctions.push_back(function);
+        _loopScheduler.addTask("loop function", function, ESP32SVELTEKIT_LOOP_INTERVAL);
+    }
+
+    loop_task_id_t addLoopTask(const char *name, loopCallback function, uint32_t periodMs, uint32_t phaseMs = 0, uint32_t deadlineMs = 0)
+    {
+        return _loopScheduler.addTask(name, function, periodMs, phaseMs, deadlineMs);
+    }
+
+    void runLoopTaskSoon(loop_task_id_t id, uint32_t delayMs = 0)
+    {
+        _loopScheduler.runSoon(id, delayMs);
     }
 
 private:
@@ -252,6 +270,7 @@ private:
     RestartService _restartService;
     FactoryResetService _factoryResetService;
     HealthCheckService _healthCheckService;
+    LoopScheduler _loopScheduler;
     SystemStatus _systemStatus;
 
     String _appName = APP_NAME;
@@ -259,8 +278,7 @@ private:
 protected:
     static void _loopImpl(void *_this) { static_cast<ESP32SvelteKit *>(_this)->_loop(); }
     void _loop();
-
-    std::vector<loopCallback> _loopFunctions;
+    void _loopServices();
 
     // Connectivity status
     ConnectionStatus _connectionStatus = ConnectionStatus::OFFLINE;
@@ -40,7 +40,7 @@ public:
 
     void begin()
     {
-        _socket->registerEvent(_event);
+        _eventHandle = _socket->registerEvent(_event);
         _socket->onEvent(_event, std::bind(&EventEndpoint::updateState, this, std::placeholders::_1, std::placeholders::_2));
         _socket->onSubscribe(_event, [&](const String &originId)
                              { syncState(originId, true); });
@@ -52,6 +52,7 @@ private:
     StatefulService<T> *_statefulService;
     EventSocket *_socket;
     const char *_event;
+    EventHandle _eventHandle = EVENT_HANDLE_INVALID;
 
     void updateState(JsonObject &root, int originId)
     {
@@ -64,7 +65,7 @@ private:
         JsonObject root = jsonDocument.to<JsonObject>();
         _statefulService->read(root, _stateReader);
         JsonObject jsonObject = jsonDocument.as<JsonObject>();
-        _socket->emitEvent(_event, jsonObject, originId.c_str(), sync);
+        _socket->emitEvent(_eventHandle, jsonObject, originId.c_str(), sync);
     }
 };
 
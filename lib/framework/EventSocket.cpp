@@ -1,4 +1,5 @@
 #include <EventSocket.h>
+#include <algorithm>
 
 SemaphoreHandle_t clientSubscriptionsMutex = xSemaphoreCreateMutex();
 
@@ -6,7 +7,9 @@ EventSocket::EventSocket(PsychicHttpServer *server,
                          SecurityManager *securityManager,
                          AuthenticationPredicate authenticationPredicate) : _server(server),
                                                                             _securityManager(securityManager),
-                                                                            _authenticationPredicate(authenticationPredicate)
+                                                                            _authenticationPredicate(authenticationPredicate),
+                                                                            _emitCount(0),
+                                                                            _emitTimeUs(0)
 {
 }
 
@@ -21,17 +24,55 @@ void EventSocket::begin()
     ESP_LOGV(SVK_TAG, "Registered event socket endpoint: %s", EVENT_SERVICE_PATH);
 }
 
-void EventSocket::registerEvent(String event)
+EventHandle EventSocket::registerEvent(const String &event)
 {
-    if (!isEventValid(event))
+    xSemaphoreTake(clientSubscriptionsMutex, portMAX_DELAY);
+    EventHandle handle = findEvent(event);
+    if (handle != EVENT_HANDLE_INVALID)
+    {
+        xSemaphoreGive(clientSubscriptionsMutex);
+        ESP_LOGW(SVK_TAG, "Event already registered: %s", event.c_str());
+        return handle;
+    }
+
+    ESP_LOGD(SVK_TAG, "Registering event: %s", event.c_str());
+
+    RegisteredEvent registered;
+    registered.name = event;
+
+    // event names are plain identifiers, so they can be serialized without escaping
+#if FT_ENABLED(EVENT_USE_JSON)
+    String prefix = "{\"event\":\"" + event + "\",\"data\":";
+    registered.prefix.assign(prefix.c_str(), prefix.c_str() + prefix.length());
+#else
+    // fixmap with 2 entries, "event": <name>, "data": ...
+    registered.prefix = {0x82, 0xa5, 'e', 'v', 'e', 'n', 't'};
+    if (event.length() < 32)
     {
-        ESP_LOGD(SVK_TAG, "Registering event: %s", event.c_str());
-        events.push_back(event);
+        registered.prefix.push_back(0xa0 | event.length());
     }
     else
     {
-        ESP_LOGW(SVK_TAG, "Event already registered: %s", event.c_str());
+        registered.prefix.push_back(0xd9);
+        registered.prefix.push_back(event.length());
     }
+    registered.prefix.insert(registered.prefix.end(), event.c_str(), event.c_str() + event.length());
+    registered.prefix.insert(registered.prefix.end(), {0xa4, 'd', 'a', 't', 'a'});
+#endif
+
+    events.push_back(std::move(registered));
+    handle = events.size() - 1;
+    xSemaphoreGive(clientSubscriptionsMutex);
+
+    return handle;
+}
+
+EventHandle EventSocket::getEventHandle(const String &event)
+{
+    xSemaphoreTake(clientSubscriptionsMutex, portMAX_DELAY);
+    EventHandle handle = findEvent(event);
+    xSemaphoreGive(clientSubscriptionsMutex);
+    return handle;
 }
 
 void EventSocket::onWSOpen(PsychicWebSocketClient *client)
@@ -42,9 +83,10 @@ void EventSocket::onWSOpen(PsychicWebSocketClient *client)
 void EventSocket::onWSClose(PsychicWebSocketClient *client)
 {
     xSemaphoreTake(clientSubscriptionsMutex, portMAX_DELAY);
-    for (auto &event_subscriptions : client_subscriptions)
+    for (auto &event : events)
     {
-        event_subscriptions.second.remove(client->socket());
+        auto &subscriptions = event.subscriptions;
+        subscriptions.erase(std::remove(subscriptions.begin(), subscriptions.end(), client->socket()), subscriptions.end());
     }
     xSemaphoreGive(clientSubscriptionsMutex);
     ESP_LOGI(SVK_TAG, "ws[%s][%u] disconnect", client->remoteIP().toString().c_str(), client->socket());
@@ -74,28 +116,53 @@ esp_err_t EventSocket::onFrame(PsychicWebSocketRequest *request, httpd_ws_frame
 
         if (!error && doc.is<JsonObject>())
         {
+            int socket = request->client()->socket();
             String event = doc["event"];
             if (event == "subscribe")
             {
                 // only subscribe to events that are registered
-                if (isEventValid(doc["data"].as<String>()))
+                String data = doc["data"].as<String>();
+                xSemaphoreTake(clientSubscriptionsMutex, portMAX_DELAY);
+                EventHandle handle = findEvent(data);
+                if (handle != EVENT_HANDLE_INVALID)
+                {
+                    auto &subscriptions = events[handle].subscriptions;
+                    if (std::find(subscriptions.begin(), subscriptions.end(), socket) == subscriptions.end())
+                        subscriptions.push_back(socket);
+                }
+                xSemaphoreGive(clientSubscriptionsMutex);
+
+                if (handle != EVENT_HANDLE_INVALID)
                 {
-                    client_subscriptions[doc["data"]].push_back(request->client()->socket());
-                    handleSubscribeCallbacks(doc["data"], String(request->client()->socket()));
+                    handleSubscribeCallbacks(handle, String(socket));
                 }
                 else
                 {
-                    ESP_LOGW(SVK_TAG, "Client tried to subscribe to unregistered event: %s", doc["data"].as<String>().c_str());
+                    ESP_LOGW(SVK_TAG, "Client tried to subscribe to unregistered event: %s", data.c_str());
                 }
             }
             else if (event == "unsubscribe")
             {
-                client_subscriptions[doc["data"]].remove(request->client()->socket());
+                xSemaphoreTake(clientSubscriptionsMutex, portMAX_DELAY);
+                EventHandle handle = findEvent(doc["data"].as<String>());
+                if (handle != EVENT_HANDLE_INVALID)
+                {
+                    auto &subscriptions = events[handle].subscriptions;
+                    subscriptions.erase(std::remove(subscriptions.begin(), subscriptions.end(), socket), subscriptions.end());
+                }
+                xSemaphoreGive(clientSubscriptionsMutex);
             }
             else
             {
-                JsonObject jsonObject = doc["data"].as<JsonObject>();
-                handleEventCallbacks(event, jsonObject, request->client()->socket());
+                xSemaphoreTake(clientSubscriptionsMutex, portMAX_DELAY);
+                EventHandle handle = findEvent(event);
+                xSemaphoreGive(clientSubscriptionsMutex);
+
+                if (handle != EVENT_HANDLE_INVALID)
+                {
+                    JsonObject jsonObject = doc["data"].as<JsonObject>();
+                    handleEventCallbacks(handle, jsonObject, socket);
+                }
             }
             return ESP_OK;
         }
@@ -104,44 +171,64 @@ esp_err_t EventSocket::onFrame(PsychicWebSocketRequest *request, httpd_ws_frame
     return ESP_OK;
 }
 
-void EventSocket::emitEvent(String event, JsonObject &jsonObject, const char *originId, bool onlyToSameOrigin)
+void EventSocket::emitEvent(const String &event, JsonObject &jsonObject, const char *originId, bool onlyToSameOrigin)
 {
-    // Only process valid events
-    if (!isEventValid(String(event)))
+    EventHandle handle = getEventHandle(event);
+    if (handle == EVENT_HANDLE_INVALID)
     {
-        ESP_LOGW(SVK_TAG, "Method tried to emit unregistered event: %s", event);
+        ESP_LOGW(SVK_TAG, "Method tried to emit unregistered event: %s", event.c_str());
         return;
     }
+    emitEvent(handle, jsonObject, originId, onlyToSameOrigin);
+}
 
+void EventSocket::emitEvent(EventHandle event, JsonObject &jsonObject, const char *originId, bool onlyToSameOrigin)
+{
+    int64_t startTime = esp_timer_get_time();
     int originSubscriptionId = originId[0] ? atoi(originId) : -1;
+
     xSemaphoreTake(clientSubscriptionsMutex, portMAX_DELAY);
-    auto &subscriptions = client_subscriptions[event];
-    if (subscriptions.empty())
+
+    // Only process valid events
+    if (event < 0 || event >= (EventHandle)events.size())
     {
         xSemaphoreGive(clientSubscriptionsMutex);
+        ESP_LOGW(SVK_TAG, "Method tried to emit unregistered event handle: %d", event);
         return;
     }
 
-    JsonDocument doc;
-    doc["event"] = event;
-    doc["data"] = jsonObject;
+    RegisteredEvent &registered = events[event];
+    auto &subscriptions = registered.subscriptions;
+    if (subscriptions.empty())
+    {
+        xSemaphoreGive(clientSubscriptionsMutex);
+        return;
+    }
 
+    // serialize once into a buffer shared by the send queues of all subscribers,
+    // the message prefix is prepared at registration, so only the data is serialized
+    size_t prefixLength = registered.prefix.size();
 #if FT_ENABLED(EVENT_USE_JSON)
-    size_t len = measureJson(doc);
+    size_t len = prefixLength + measureJson(jsonObject) + 1;
 #else
-    size_t len = measureMsgPack(doc);
+    size_t len = prefixLength + measureMsgPack(jsonObject);
 #endif
 
-    char *output = new char[len + 1];
+    auto buffer = std::make_shared<std::vector<uint8_t>>(len + 1);
+    char *output = (char *)buffer->data();
+    memcpy(output, registered.prefix.data(), prefixLength);
 
 #if FT_ENABLED(EVENT_USE_JSON)
-    serializeJson(doc, output, len + 1);
+    serializeJson(jsonObject, output + prefixLength, len - prefixLength);
+    output[len - 1] = '}';
 #else
-    serializeMsgPack(doc, output, len);
+    serializeMsgPack(jsonObject, output + prefixLength, len - prefixLength);
 #endif
 
-    // null terminate the string
+    // null terminate the string for logging, but do not send the terminator
     output[len] = '\0';
+    buffer->resize(len);
+    PsychicWebSocketPayload payload = buffer;
 
     // if onlyToSameOrigin == true, send the message back to the origin
     if (onlyToSameOrigin && originSubscriptionId > 0)
@@ -149,83 +236,121 @@ void EventSocket::emitEvent(String event, JsonObject &jsonObject, const char *or
         auto *client = _socket.getClient(originSubscriptionId);
         if (client)
         {
-            ESP_LOGV(SVK_TAG, "Emitting event: %s to %s[%u], Message[%d]: %s", event, client->remoteIP().toString().c_str(), client->socket(), len, output);
+            ESP_LOGV(SVK_TAG, "Emitting event: %s to %s[%u], Message[%d]: %.*s", registered.name.c_str(), client->remoteIP().toString().c_str(), client->socket(), len, (int)len, output);
 #if FT_ENABLED(EVENT_USE_JSON)
-            client->sendMessage(HTTPD_WS_TYPE_TEXT, output, len);
+            client->queueMessage(HTTPD_WS_TYPE_TEXT, payload);
 #else
-            client->sendMessage(HTTPD_WS_TYPE_BINARY, output, len);
+            client->queueMessage(HTTPD_WS_TYPE_BINARY, payload);
 #endif
         }
     }
     else
     { // else send the message to all other clients
 
-        for (int subscription : client_subscriptions[event])
+        for (size_t i = 0; i < subscriptions.size();)
         {
-            if (subscription == originSubscriptionId)
-                continue;
-            auto *client = _socket.getClient(subscription);
-            if (!client)
+            int subscription = subscriptions[i];
+            auto *client = subscription != originSubscriptionId ? _socket.getClient(subscription) : nullptr;
+            if (subscription != originSubscriptionId && !client)
             {
-                subscriptions.remove(subscription);
+                // client is gone, drop its subscription
+                subscriptions.erase(subscriptions.begin() + i);
                 continue;
             }
-            ESP_LOGV(SVK_TAG, "Emitting event: %s to %s[%u], Message[%d]: %s", event, client->remoteIP().toString().c_str(), client->socket(), len, output);
+            i++;
+
+            if (!client)
+                continue;
+
+            ESP_LOGV(SVK_TAG, "Emitting event: %s to %s[%u], Message[%d]: %.*s", registered.name.c_str(), client->remoteIP().toString().c_str(), client->socket(), len, (int)len, output);
 #if FT_ENABLED(EVENT_USE_JSON)
-            client->sendMessage(HTTPD_WS_TYPE_TEXT, output, len);
+            client->queueMessage(HTTPD_WS_TYPE_TEXT, payload);
 #else
-            client->sendMessage(HTTPD_WS_TYPE_BINARY, output, len);
+            client->queueMessage(HTTPD_WS_TYPE_BINARY, payload);
 #endif
         }
     }
 
-    delete[] output;
+    _emitCount++;
+    _emitTimeUs += esp_timer_get_time() - startTime;
+
     xSemaphoreGive(clientSubscriptionsMutex);
 }
 
-void EventSocket::handleEventCallbacks(String event, JsonObject &jsonObject, int originId)
+void EventSocket::handleEventCallbacks(EventHandle event, JsonObject &jsonObject, int originId)
 {
-    for (auto &callback : event_callbacks[event])
+    // callbacks may emit events, so they are called without holding the mutex
+    xSemaphoreTake(clientSubscriptionsMutex, portMAX_DELAY);
+    std::list<EventCallback> callbacks = events[event].eventCallbacks;
+    xSemaphoreGive(clientSubscriptionsMutex);
+
+    for (auto &callback : callbacks)
     {
         callback(jsonObject, originId);
     }
 }
 
-void EventSocket::handleSubscribeCallbacks(String event, const String &originId)
+void EventSocket::handleSubscribeCallbacks(EventHandle event, const String &originId)
 {
-    for (auto &callback : subscribe_callbacks[event])
+    xSemaphoreTake(clientSubscriptionsMutex, portMAX_DELAY);
+    std::list<SubscribeCallback> callbacks = events[event].subscribeCallbacks;
+    xSemaphoreGive(clientSubscriptionsMutex);
+
+    for (auto &callback : callbacks)
     {
         callback(originId);
     }
 }
 
-void EventSocket::onEvent(String event, EventCallback callback)
+void EventSocket::onEvent(const String &event, EventCallback callback)
 {
-    if (!isEventValid(event))
-    {
+    xSemaphoreTake(clientSubscriptionsMutex, portMAX_DELAY);
+    EventHandle handle = findEvent(event);
+    if (handle != EVENT_HANDLE_INVALID)
+        events[handle].eventCallbacks.push_back(callback);
+    xSemaphoreGive(clientSubscriptionsMutex);
+
+    if (handle == EVENT_HANDLE_INVALID)
         ESP_LOGW(SVK_TAG, "Method tried to register unregistered event: %s", event.c_str());
-        return;
-    }
-    event_callbacks[event].push_back(callback);
 }
 
-void EventSocket::onSubscribe(String event, SubscribeCallback callback)
+void EventSocket::onSubscribe(const String &event, SubscribeCallback callback)
 {
-    if (!isEventValid(event))
+    xSemaphoreTake(clientSubscriptionsMutex, portMAX_DELAY);
+    EventHandle handle = findEvent(event);
+    if (handle != EVENT_HANDLE_INVALID)
+        events[handle].subscribeCallbacks.push_back(callback);
+    xSemaphoreGive(clientSubscriptionsMutex);
+
+    if (handle == EVENT_HANDLE_INVALID)
     {
         ESP_LOGW(SVK_TAG, "Method tried to subscribe to unregistered event: %s", event.c_str());
         return;
     }
-    subscribe_callbacks[event].push_back(callback);
     ESP_LOGI(SVK_TAG, "onSubscribe for event: %s", event.c_str());
 }
 
-bool EventSocket::isEventValid(String event)
+EventHandle EventSocket::findEvent(const String &event)
 {
-    return std::find(events.begin(), events.end(), event) != events.end();
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        if (events[i].name == event)
+            return i;
+    }
+    return EVENT_HANDLE_INVALID;
 }
 
 unsigned int EventSocket::getConnectedClients()
 {
     return (unsigned int)_socket.getClientList().size();
 }
+
+uint32_t EventSocket::getEmitCount()
+{
+    return _emitCount;
+}
+
+uint32_t EventSocket::getAverageEmitTimeUs()
+{
+    return _emitCount > 0 ? (uint32_t)(_emitTimeUs / _emitCount) : 0;
+}
@@ -24,9 +24,14 @@
 
 #define EVENT_SERVICE_PATH "/ws/events"
 
+#define EVENT_HANDLE_INVALID -1
+
 typedef std::function<void(JsonObject &root, int originId)> EventCallback;
 typedef std::function<void(const String &originId)> SubscribeCallback;
 
+// handle of a registered event, index into the event table
+typedef int16_t EventHandle;
+
 class EventSocket
 {
 public:
@@ -34,31 +39,51 @@ public:
 
     void begin();
 
-    void registerEvent(String event);
+    // registers the event once and returns its handle, use the handle to emit the event
+    EventHandle registerEvent(const String &event);
 
-    void onEvent(String event, EventCallback callback);
+    EventHandle getEventHandle(const String &event);
 
-    void onSubscribe(String event, SubscribeCallback callback);
+    void onEvent(const String &event, EventCallback callback);
 
-    void emitEvent(String event, JsonObject &jsonObject, const char *originId = "", bool onlyToSameOrigin = false);
+    void onSubscribe(const String &event, SubscribeCallback callback);
+
+    void emitEvent(EventHandle event, JsonObject &jsonObject, const char *originId = "", bool onlyToSameOrigin = false);
+    void emitEvent(const String &event, JsonObject &jsonObject, const char *originId = "", bool onlyToSameOrigin = false);
     // if onlyToSameOrigin == true, the message will be sent to the originId only, otherwise it will be broadcasted to all clients except the originId
 
     unsigned int getConnectedClients();
 
+    // number of emitted events and average time to serialize and queue them
+    uint32_t getEmitCount();
+    uint32_t getAverageEmitTimeUs();
+
 private:
     PsychicHttpServer *_server;
     PsychicWebSocketHandler _socket;
     SecurityManager *_securityManager;
     AuthenticationPredicate _authenticationPredicate;
 
-    std::vector<String> events;
-    std::map<String, std::list<int>> client_subscriptions;
-    std::map<String, std::list<EventCallback>> event_callbacks;
-    std::map<String, std::list<SubscribeCallback>> subscribe_callbacks;
-    void handleEventCallbacks(String event, JsonObject &jsonObject, int originId);
-    void handleSubscribeCallbacks(String event, const String &originId);
+    struct RegisteredEvent
+    {
+        String name;
+        std::vector<uint8_t> prefix; // serialized message up to the data, e.g. {"event":"name","data":
+        std::vector<int> subscriptions;
+        std::list<EventCallback> eventCallbacks;
+        std::list<SubscribeCallback> subscribeCallbacks;
+    };
+
+    // indexed by EventHandle, guarded by clientSubscriptionsMutex
+    std::vector<RegisteredEvent> events;
+
+    uint32_t _emitCount;
+    uint64_t _emitTimeUs;
+
+    void handleEventCallbacks(EventHandle event, JsonObject &jsonObject, int originId);
+    void handleSubscribeCallbacks(EventHandle event, const String &originId);
 
-    bool isEventValid(String event);
+    // must be called with clientSubscriptionsMutex taken
+    EventHandle findEvent(const String &event);
 
     void onWSOpen(PsychicWebSocketClient *client);
     void onWSClose(PsychicWebSocketClient *client);
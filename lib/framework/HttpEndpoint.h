@@ -24,6 +24,7 @@ protected:
     AuthenticationPredicate _authenticationPredicate;
     PsychicHttpServer *_server;
     const char *_servicePath;
+    size_t _maxBodySize;
 
 public:
     HttpEndpoint(JsonStateReader<T> stateReader,
@@ -32,13 +33,15 @@ public:
                  PsychicHttpServer *server,
                  const char *servicePath,
                  SecurityManager *securityManager,
-                 AuthenticationPredicate authenticationPredicate = AuthenticationPredicates::IS_ADMIN) : _stateReader(stateReader),
-                                                                                                         _stateUpdater(stateUpdater),
-                                                                                                         _statefulService(statefulService),
-                                                                                                         _server(server),
-                                                                                                         _servicePath(servicePath),
-                                                                                                         _securityManager(securityManager),
-                                                                                                         _authenticationPredicate(authenticationPredicate)
+                 AuthenticationPredicate authenticationPredicate = AuthenticationPredicates::IS_ADMIN,
+                 size_t maxBodySize = 0) : _stateReader(stateReader),
+                                           _stateUpdater(stateUpdater),
+                                           _statefulService(statefulService),
+                                           _server(server),
+                                           _servicePath(servicePath),
+                                           _securityManager(securityManager),
+                                           _authenticationPredicate(authenticationPredicate),
+                                           _maxBodySize(maxBodySize)
     {
     }
 
@@ -72,8 +75,8 @@ public:
                         _authenticationPredicate));
         ESP_LOGV(SVK_TAG, "Registered GET endpoint: %s", _servicePath);
 
-        // POST
-        _server->on(_servicePath,
+        // POST, the body size limit defaults to the server's maxRequestBodySize
+        PsychicEndpoint *postEndpoint = _server->on(_servicePath,
                     HTTP_POST,
                     _securityManager->wrapCallback(
                         [this](PsychicRequest *request, JsonVariant &json)
@@ -104,6 +107,8 @@ public:
                             return response.send();
                         },
                         _authenticationPredicate));
+        if (_maxBodySize)
+            static_cast<PsychicJsonHandler *>(postEndpoint->handler())->setMaxBodySize(_maxBodySize);
 
         ESP_LOGV(SVK_TAG, "Registered POST endpoint: %s", _servicePath);
     }
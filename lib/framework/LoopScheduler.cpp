@@ -0,0 +1,205 @@
+/**
+ *   LoopScheduler - Periodic task scheduler for the framework loop
+ *
+ *   Runs the tasks registered with the ESP32 SvelteKit framework loop when they
+ *   are due and lets the loop task sleep until the next one is due.
+ *
+ *   Copyright (C) 2025 hmbacher
+ *
+ *   All Rights Reserved. This software may be modified and distributed under
+ *   the terms of the LGPL v3 license. See the LICENSE file for details.
+ **/
+
+#include <LoopScheduler.h>
+#include <algorithm>
+
+// Orders the heap by the next due time, earliest on top
+static bool laterDue(const LoopTask_t *a, const LoopTask_t *b)
+{
+    return a->nextDueUs > b->nextDueUs;
+}
+
+LoopScheduler::LoopScheduler(PsychicHttpServer *server, SecurityManager *securityManager) : _server(server),
+                                                                                            _securityManager(securityManager),
+                                                                                            _mutex(xSemaphoreCreateMutex()),
+                                                                                            _loopTaskHandle(nullptr),
+                                                                                            _wakeups(0),
+                                                                                            _busySumUs(0)
+{
+}
+
+void LoopScheduler::begin()
+{
+    _server->on(LOOP_SCHEDULER_SERVICE_PATH,
+                HTTP_GET,
+                _securityManager->wrapRequest(std::bind(&LoopScheduler::getStats, this, std::placeholders::_1),
+                                              AuthenticationPredicates::IS_AUTHENTICATED));
+
+    ESP_LOGV(SVK_TAG, "Registered GET endpoint: %s", LOOP_SCHEDULER_SERVICE_PATH);
+}
+
+loop_task_id_t LoopScheduler::addTask(const char *name, LoopTaskCallback cb, uint32_t periodMs, uint32_t phaseMs, uint32_t deadlineMs)
+{
+    if (!cb)
+    {
+        ESP_LOGW(SVK_TAG, "Cannot add loop task 'null'");
+        return 0;
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    LoopTask_t task = {};
+    task.id = _tasks.size() + 1;
+    task.name = name;
+    task.cb = cb;
+    task.periodMs = periodMs;
+    task.phaseMs = phaseMs;
+    task.deadlineMs = deadlineMs;
+    task.nextDueUs = periodMs > 0 || phaseMs > 0 ? esp_timer_get_time() + phaseMs * 1000LL : INT64_MAX;
+    _tasks.push_back(task);
+
+    _dueHeap.push_back(&_tasks.back());
+    std::push_heap(_dueHeap.begin(), _dueHeap.end(), laterDue);
+
+    xSemaphoreGive(_mutex);
+
+    ESP_LOGV(SVK_TAG, "Added loop task '%s' (period: %lu ms, phase: %lu ms)", name, periodMs, phaseMs);
+
+    // The loop may sleep longer than the first run of the new task is due in
+    if (_loopTaskHandle && xTaskGetCurrentTaskHandle() != _loopTaskHandle)
+        xTaskNotifyGive(_loopTaskHandle);
+
+    return task.id;
+}
+
+void LoopScheduler::runSoon(loop_task_id_t id, uint32_t delayMs)
+{
+    bool pulledForward = false;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    if (id > 0 && id <= _tasks.size())
+    {
+        LoopTask_t &task = _tasks[id - 1];
+        int64_t dueUs = esp_timer_get_time() + delayMs * 1000LL;
+        if (dueUs < task.nextDueUs)
+        {
+            task.nextDueUs = dueUs;
+            std::make_heap(_dueHeap.begin(), _dueHeap.end(), laterDue); // Task is not in the heap while it runs
+            pulledForward = true;
+        }
+    }
+    xSemaphoreGive(_mutex);
+
+    // Let the loop task recalculate its sleep time
+    if (pulledForward && _loopTaskHandle && xTaskGetCurrentTaskHandle() != _loopTaskHandle)
+        xTaskNotifyGive(_loopTaskHandle);
+}
+
+TickType_t LoopScheduler::runDue()
+{
+    int64_t passStartUs = esp_timer_get_time();
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _wakeups++;
+
+    // Run only tasks due at the start of this pass, a task pulling itself forward runs in the next one
+    while (!_dueHeap.empty() && _dueHeap.front()->nextDueUs <= passStartUs)
+    {
+        std::pop_heap(_dueHeap.begin(), _dueHeap.end(), laterDue);
+        LoopTask_t *task = _dueHeap.back();
+        _dueHeap.pop_back();
+
+        int64_t startUs = esp_timer_get_time();
+        int64_t dueUs = task->nextDueUs;
+
+        // Schedule the next run before running, so the task can pull it forward with runSoon()
+        if (task->periodMs > 0)
+        {
+            int64_t periodUs = task->periodMs * 1000LL;
+            int64_t nextDueUs = dueUs + periodUs;
+            if (nextDueUs <= startUs)
+            {
+                int64_t missed = (startUs - nextDueUs) / periodUs + 1;
+                task->skipped += missed;
+                nextDueUs += missed * periodUs;
+            }
+            task->nextDueUs = nextDueUs;
+        }
+        else
+        {
+            task->nextDueUs = INT64_MAX;
+        }
+
+        xSemaphoreGive(_mutex);
+        task->cb();
+        int64_t endUs = esp_timer_get_time();
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+
+        uint32_t runtimeUs = endUs - startUs;
+        uint32_t deadlineMs = task->deadlineMs > 0 ? task->deadlineMs : task->periodMs;
+        task->runs++;
+        task->runtimeLastUs = runtimeUs;
+        task->runtimeMaxUs = std::max(task->runtimeMaxUs, runtimeUs);
+        task->runtimeSumUs += runtimeUs;
+        task->latenessMaxUs = std::max<uint32_t>(task->latenessMaxUs, startUs - dueUs);
+        if (deadlineMs > 0 && endUs - dueUs > deadlineMs * 1000LL)
+            task->overruns++;
+        _busySumUs += runtimeUs;
+
+        _dueHeap.push_back(task);
+        std::push_heap(_dueHeap.begin(), _dueHeap.end(), laterDue);
+    }
+
+    // Sleep until the next task is due, tasks becoming due during the pass are run right away
+    TickType_t ticks = pdMS_TO_TICKS(LOOP_SCHEDULER_MAX_SLEEP_MS);
+    if (!_dueHeap.empty() && _dueHeap.front()->nextDueUs != INT64_MAX)
+    {
+        int64_t waitUs = _dueHeap.front()->nextDueUs - esp_timer_get_time();
+        if (waitUs <= 0)
+            ticks = 0;
+        else
+            ticks = std::min<int64_t>(ticks, (waitUs * configTICK_RATE_HZ + 999999) / 1000000);
+    }
+
+    xSemaphoreGive(_mutex);
+
+    return ticks;
+}
+
+esp_err_t LoopScheduler::getStats(PsychicRequest *request)
+{
+    PsychicJsonResponse response = PsychicJsonResponse(request, false);
+    JsonObject root = response.getRoot();
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    int64_t nowUs = esp_timer_get_time();
+    root["wakeups"] = _wakeups;
+    root["load"] = nowUs > 0 ? 100.0f * _busySumUs / nowUs : 0.0f;
+
+    JsonArray tasks = root["tasks"].to<JsonArray>();
+    for (const LoopTask_t &task : _tasks)
+    {
+        JsonObject jsonTask = tasks.add<JsonObject>();
+        jsonTask["name"] = task.name;
+        jsonTask["period"] = task.periodMs;
+        jsonTask["phase"] = task.phaseMs;
+        jsonTask["deadline"] = task.deadlineMs > 0 ? task.deadlineMs : task.periodMs;
+        jsonTask["runs"] = task.runs;
+        jsonTask["runtimeLast"] = task.runtimeLastUs;
+        jsonTask["runtimeMean"] = task.runs > 0 ? static_cast<uint32_t>(task.runtimeSumUs / task.runs) : 0;
+        jsonTask["runtimeMax"] = task.runtimeMaxUs;
+        jsonTask["load"] = nowUs > 0 ? 100.0f * task.runtimeSumUs / nowUs : 0.0f;
+        jsonTask["latenessMax"] = task.latenessMaxUs;
+        jsonTask["overruns"] = task.overruns;
+        jsonTask["skipped"] = task.skipped;
+        if (task.nextDueUs != INT64_MAX)
+            jsonTask["nextDue"] = static_cast<int32_t>(std::max<int64_t>(task.nextDueUs - nowUs, 0) / 1000);
+        else
+            jsonTask["nextDue"] = nullptr;
+    }
+
+    xSemaphoreGive(_mutex);
+
+    return response.send();
+}
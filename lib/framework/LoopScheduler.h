@@ -0,0 +1,113 @@
+#ifndef LoopScheduler_h
+#define LoopScheduler_h
+
+/**
+ *   LoopScheduler - Periodic task scheduler for the framework loop
+ *
+ *   Runs the tasks registered with the ESP32 SvelteKit framework loop when they
+ *   are due and lets the loop task sleep until the next one is due.
+ *
+ *   Copyright (C) 2025 hmbacher
+ *
+ *   All Rights Reserved. This software may be modified and distributed under
+ *   the terms of the LGPL v3 license. See the LICENSE file for details.
+ **/
+
+#include <PsychicHttp.h>
+#include <SecurityManager.h>
+#include <ArduinoJson.h>
+#include <functional>
+#include <vector>
+#include <deque>
+
+#define LOOP_SCHEDULER_SERVICE_PATH "/rest/loopTasks"
+
+#ifndef LOOP_SCHEDULER_MAX_SLEEP_MS
+#define LOOP_SCHEDULER_MAX_SLEEP_MS 1000
+#endif
+
+/**
+ * LoopScheduler keeps the tasks of the framework loop in a min-heap ordered by their next due time.
+ *
+ * Tasks are registered with a period, a phase (delay of the first run) and an optional deadline. Tasks
+ * with period 0 run on request only. Any task may be pulled forward with runSoon(), e.g. from another
+ * FreeRTOS task that produced work for it, which also wakes the loop task.
+ *
+ *   // Check the radio every second, starting 500 ms after registration
+ *   esp32SvelteKit.addLoopTask("radio", [&]() { radio.check(); }, 1000, 500);
+ *
+ * Per task the scheduler counts runs, runtime, lateness and overruns (runs finished later than the
+ * deadline after becoming due), which are available at /rest/loopTasks.
+ */
+
+typedef size_t loop_task_id_t;
+typedef std::function<void()> LoopTaskCallback;
+
+typedef struct LoopTask
+{
+    loop_task_id_t id;
+    const char *name;
+    LoopTaskCallback cb;
+    uint32_t periodMs;     // 0 = on request only
+    uint32_t phaseMs;
+    uint32_t deadlineMs;   // 0 = period (no deadline for tasks run on request without deadline)
+    int64_t nextDueUs;     // INT64_MAX = not scheduled
+    uint32_t runs;
+    uint32_t overruns;
+    uint32_t skipped;      // Periods skipped because the task was late by more than a period
+    uint32_t runtimeLastUs;
+    uint32_t runtimeMaxUs;
+    uint64_t runtimeSumUs;
+    uint32_t latenessMaxUs; // Start after the due time
+} LoopTask_t;
+
+class LoopScheduler
+{
+public:
+    LoopScheduler(PsychicHttpServer *server, SecurityManager *securityManager);
+
+    void begin();
+
+    /**
+     * @brief Register a task run by the framework loop
+     * @param name Name shown in the statistics (must outlive the scheduler, e.g. a string literal)
+     * @param cb Task function
+     * @param periodMs Period between two runs, 0 for tasks run on request only (see runSoon())
+     * @param phaseMs Delay of the first run, spreads tasks of the same period
+     * @param deadlineMs Time after becoming due a run must be finished in, 0 = period
+     * @return Task ID (>0) for runSoon(). Returns 0 if the callback is null.
+     */
+    loop_task_id_t addTask(const char *name, LoopTaskCallback cb, uint32_t periodMs, uint32_t phaseMs = 0, uint32_t deadlineMs = 0);
+
+    /**
+     * @brief Run a task within the given delay at the latest (earlier if it is due anyway)
+     *
+     * Can be called from any task, including the task itself while running.
+     */
+    void runSoon(loop_task_id_t id, uint32_t delayMs = 0);
+
+    /**
+     * @brief Run all due tasks
+     * @return Ticks until the next task is due (at most LOOP_SCHEDULER_MAX_SLEEP_MS)
+     */
+    TickType_t runDue();
+
+    /**
+     * @brief Set the task running the loop, woken when a task is pulled forward
+     */
+    void setLoopTaskHandle(TaskHandle_t handle) { _loopTaskHandle = handle; }
+
+private:
+    PsychicHttpServer *_server;
+    SecurityManager *_securityManager;
+    SemaphoreHandle_t _mutex;
+    TaskHandle_t _loopTaskHandle;
+    std::deque<LoopTask_t> _tasks; // References stay valid when tasks are added
+    std::vector<LoopTask_t *> _dueHeap;
+    uint32_t _wakeups;
+    uint64_t _busySumUs;
+
+    esp_err_t getStats(PsychicRequest *request);
+};
+
+#endif // end LoopScheduler_h
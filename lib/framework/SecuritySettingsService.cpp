@@ -19,10 +19,14 @@
 SecuritySettingsService::SecuritySettingsService(PsychicHttpServer *server, FS *fs) : _server(server),
                                                                                       _httpEndpoint(SecuritySettings::read, SecuritySettings::update, this, server, SECURITY_SETTINGS_PATH, this),
                                                                                       _fsPersistence(SecuritySettings::read, SecuritySettings::update, this, fs, SECURITY_SETTINGS_FILE),
-                                                                                      _jwtHandler(FACTORY_JWT_SECRET)
+                                                                                      _jwtHandler(FACTORY_JWT_SECRET),
+                                                                                      _jwtCacheMutex(xSemaphoreCreateMutex()),
+                                                                                      _jwtCacheClock(0),
+                                                                                      _jwtCacheGeneration(0)
 {
     addUpdateHandler([&](const String &originId)
-                     { configureJWTHandler(); },
+                     { configureJWTHandler();
+                       invalidateJWTCache(); },
                      false);
 }
 
@@ -67,8 +71,58 @@ void SecuritySettingsService::configureJWTHandler()
     _jwtHandler.setSecret(_state.jwtSecret);
 }
 
+void SecuritySettingsService::invalidateJWTCache()
+{
+    xSemaphoreTake(_jwtCacheMutex, portMAX_DELAY);
+    for (JWTCacheEntry_t &entry : _jwtCache)
+    {
+        entry.lastUsed = 0;
+    }
+    _jwtCacheGeneration++;
+    xSemaphoreGive(_jwtCacheMutex);
+}
+
+void SecuritySettingsService::cacheJWT(const uint8_t *digest, User &user, uint32_t generation)
+{
+    xSemaphoreTake(_jwtCacheMutex, portMAX_DELAY);
+    // settings changed while the token was verified, the result may be outdated
+    if (generation == _jwtCacheGeneration)
+    {
+        JWTCacheEntry_t *lru = &_jwtCache[0];
+        for (JWTCacheEntry_t &entry : _jwtCache)
+        {
+            if (entry.lastUsed < lru->lastUsed)
+            {
+                lru = &entry;
+            }
+        }
+        memcpy(lru->digest, digest, JWT_DIGEST_SIZE);
+        lru->lastUsed = ++_jwtCacheClock;
+        lru->user = user;
+    }
+    xSemaphoreGive(_jwtCacheMutex);
+}
+
 Authentication SecuritySettingsService::authenticateJWT(String &jwt)
 {
+    // tokens verified before are found by their SHA-256 digest, which cannot be forged to match another token
+    uint8_t digest[JWT_DIGEST_SIZE];
+    mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const unsigned char *)jwt.c_str(), jwt.length(), digest);
+
+    xSemaphoreTake(_jwtCacheMutex, portMAX_DELAY);
+    for (JWTCacheEntry_t &entry : _jwtCache)
+    {
+        if (entry.lastUsed && memcmp(entry.digest, digest, JWT_DIGEST_SIZE) == 0)
+        {
+            entry.lastUsed = ++_jwtCacheClock;
+            User user = entry.user;
+            xSemaphoreGive(_jwtCacheMutex);
+            return Authentication(user);
+        }
+    }
+    uint32_t generation = _jwtCacheGeneration;
+    xSemaphoreGive(_jwtCacheMutex);
+
     JsonDocument payloadDocument;
     _jwtHandler.parseJWT(jwt, payloadDocument);
     if (payloadDocument.is<JsonObject>())
@@ -79,6 +133,7 @@ Authentication SecuritySettingsService::authenticateJWT(String &jwt)
         {
             if (_user.username == username && validatePayload(parsedPayload, &_user))
             {
+                cacheJWT(digest, _user, generation);
                 return Authentication(_user);
             }
         }
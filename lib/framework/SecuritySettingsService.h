@@ -41,6 +41,13 @@
 #define FACTORY_GUEST_PASSWORD "guest"
 #endif
 
+// number of verified tokens remembered, authenticating a known token skips signature check and payload parsing
+#ifndef JWT_CACHE_SIZE
+#define JWT_CACHE_SIZE 8
+#endif
+
+#define JWT_DIGEST_SIZE 32
+
 #define SECURITY_SETTINGS_FILE "/config/securitySettings.json"
 #define SECURITY_SETTINGS_PATH "/rest/securitySettings"
 
@@ -93,6 +100,17 @@ public:
     }
 };
 
+/*
+ * Verified JWT, identified by the SHA-256 digest of the token
+ */
+typedef struct JWTCacheEntry
+{
+    uint8_t digest[JWT_DIGEST_SIZE];
+    uint32_t lastUsed; // 0 = unused
+    User user;
+    JWTCacheEntry() : digest{}, lastUsed(0), user("", "", false) {}
+} JWTCacheEntry_t;
+
 class SecuritySettingsService : public StatefulService<SecuritySettings>, public SecurityManager
 {
 public:
@@ -115,11 +133,25 @@ private:
     HttpEndpoint<SecuritySettings> _httpEndpoint;
     FSPersistence<SecuritySettings> _fsPersistence;
     ArduinoJsonJWT _jwtHandler;
+    SemaphoreHandle_t _jwtCacheMutex;
+    JWTCacheEntry_t _jwtCache[JWT_CACHE_SIZE];
+    uint32_t _jwtCacheClock;      // last use counter for LRU replacement
+    uint32_t _jwtCacheGeneration; // incremented on invalidation, drops verifications started before
 
     esp_err_t generateToken(PsychicRequest *request);
 
     void configureJWTHandler();
 
+    /*
+     * Forget all verified tokens, the secret or the users changed
+     */
+    void invalidateJWTCache();
+
+    /*
+     * Remember a verified token, replacing the least recently used one
+     */
+    void cacheJWT(const uint8_t *digest, User &user, uint32_t generation);
+
     /*
      * Lookup the user by JWT
      */
@@ -14,7 +14,7 @@
 
 #include <SystemHealthService.h>
 
-SystemHealthService::SystemHealthService(EventSocket *socket) : _socket(socket), _lastHealthUpdate(0)
+SystemHealthService::SystemHealthService(EventSocket *socket) : _socket(socket), _event(EVENT_HANDLE_INVALID), _lastHealthUpdate(0)
 {
     _bootTime = millis();
     _lastResetReason = esp_reset_reason();
@@ -22,7 +22,7 @@ SystemHealthService::SystemHealthService(EventSocket *socket) : _socket(socket),
 
 void SystemHealthService::begin()
 {
-    _socket->registerEvent(EVENT_SYSTEM_HEALTH);
+    _event = _socket->registerEvent(EVENT_SYSTEM_HEALTH);
     ESP_LOGI("SystemHealth", "System Health Service initialized - Boot time: %lu ms, Reset reason: %s", 
              _bootTime, getResetReasonString((esp_reset_reason_t)_lastResetReason).c_str());
 }
@@ -146,7 +146,7 @@ void SystemHealthService::updateSystemHealth()
              (int)healthScore, status.c_str(), heapUsage, WiFi.isConnected() ? WiFi.RSSI() : 0);
     
     JsonObject jsonObject = doc.as<JsonObject>();
-    _socket->emitEvent(EVENT_SYSTEM_HEALTH, jsonObject);
+    _socket->emitEvent(_event, jsonObject);
 }
 
 String SystemHealthService::getResetReasonString(esp_reset_reason_t reason)
@@ -35,6 +35,7 @@ public:
 
 private:
     EventSocket *_socket;
+    EventHandle _event;
     unsigned long _lastHealthUpdate;
     unsigned long _bootTime;
     unsigned long _lastResetReason;
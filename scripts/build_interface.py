@@ -19,6 +19,7 @@ from os.path import exists, getmtime
 import os
 import sys
 import gzip
+import hashlib
 import mimetypes
 import glob
 from datetime import datetime
@@ -103,53 +104,166 @@ def embed_webapp():
     add_app_to_filesystem()
 
 
+def fnv1a(seed, text):
+    value = (2166136261 ^ seed) & 0xFFFFFFFF
+    for byte in text.encode():
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def find_perfect_hash(paths):
+    # Smallest power of two with at least four slots per path keeps the seed search short
+    slots = 1
+    while slots < 4 * max(len(paths), 1):
+        slots <<= 1
+    while True:
+        for seed in range(100000):
+            used = set()
+            for path in paths:
+                slot = fnv1a(seed, path) & (slots - 1)
+                if slot in used:
+                    break
+                used.add(slot)
+            else:
+                return seed, slots
+        slots <<= 1
+
+
+def load_brotli():
+    if not flag_exists("EMBED_WWW_BROTLI"):
+        return None
+    try:
+        import brotli
+        return brotli
+    except ImportError:
+        print("EMBED_WWW_BROTLI set, but python module 'brotli' is missing (pip install brotli). Embedding gzip only.")
+        return None
+
+
+def write_bytes(progmem, var, data):
+    progmem.write(f"const uint8_t {var}[] = {{\n\t")
+    for i, byte in enumerate(data):
+        if i and not (i % 16):
+            progmem.write("\n\t")
+        progmem.write(f"0x{byte:02X},")
+    progmem.write("\n};\n\n")
+
+
 def build_progmem():
     mimetypes.init()
+    brotli = load_brotli()
     with open(output_file, "w") as progmem:
-        progmem.write("#include <functional>\n")
         progmem.write("#include <Arduino.h>\n")
+        progmem.write("#include <string.h>\n\n")
 
-        assetMap = {}
+        assets = []
 
-        for idx, path in enumerate(Path(build_dir).rglob("*.*")):
-            asset_path = path.relative_to(build_dir).as_posix()
+        for idx, path in enumerate(sorted(Path(build_dir).rglob("*.*"))):
+            asset_path = "/" + path.relative_to(build_dir).as_posix()
             asset_mime = (
                 mimetypes.guess_type(asset_path)[0] or "application/octet-stream"
             )
             print(f"Converting {asset_path}")
 
+            content = path.read_bytes()
+            # Strong ETag: hash of the content, independent of the build time (mtime=0 keeps gzip deterministic)
+            content_hash = hashlib.sha256(content).hexdigest()[:16]
+            # Hashed SvelteKit bundles never change, everything else is revalidated with the ETag
+            cache_control = (
+                "public, max-age=31536000, immutable"
+                if asset_path.startswith("/_app/immutable/")
+                else "no-cache"
+            )
+
             asset_var = f"ESP_SVELTEKIT_DATA_{idx}"
             progmem.write(f"// {asset_path}\n")
-            progmem.write(f"const uint8_t {asset_var}[] = {{\n\t")
-            file_data = gzip.compress(path.read_bytes())
-
-            for i, byte in enumerate(file_data):
-                if i and not (i % 16):
-                    progmem.write("\n\t")
-                progmem.write(f"0x{byte:02X},")
+            gzip_data = gzip.compress(content, compresslevel=9, mtime=0)
+            write_bytes(progmem, asset_var, gzip_data)
+
+            br_var = "nullptr"
+            br_size = 0
+            if brotli:
+                br_data = brotli.compress(content, quality=11)
+                if len(br_data) < len(gzip_data):
+                    br_var = asset_var + "_BR"
+                    br_size = len(br_data)
+                    write_bytes(progmem, br_var, br_data)
+
+            assets.append(
+                {
+                    "path": asset_path,
+                    "mime": asset_mime,
+                    "hash": content_hash,
+                    "cache": cache_control,
+                    "gzip": asset_var,
+                    "gzip_size": len(gzip_data),
+                    "br": br_var,
+                    "br_size": br_size,
+                }
+            )
 
-            progmem.write("\n};\n\n")
-            assetMap[asset_path] = {
-                "name": asset_var,
-                "mime": asset_mime,
-                "size": len(file_data),
-            }
+        paths = [asset["path"] for asset in assets]
+        seed, slots = find_perfect_hash(paths)
+        slot_table = [0xFFFF] * slots
+        for index, path in enumerate(paths):
+            slot_table[fnv1a(seed, path) & (slots - 1)] = index
+        index_asset = paths.index("/index.html") if "/index.html" in paths else 0xFFFF
 
         progmem.write(
-            "typedef std::function<void(const String& uri, const String& contentType, const uint8_t * content, size_t len)> RouteRegistrationHandler;\n\n"
-        )
-        progmem.write("class WWWData {\n")
-        progmem.write("\tpublic:\n")
-        progmem.write(
-            "\t\tstatic void registerRoutes(RouteRegistrationHandler handler) {\n"
+            "// Embedded asset, served straight from flash\n"
+            "typedef struct WWWAsset {\n"
+            "\tconst char *path;\n"
+            "\tconst char *mime;\n"
+            "\tconst char *cacheControl;\n"
+            "\tconst char *etag;     // strong ETag of the gzip variant (hash of the uncompressed content)\n"
+            "\tconst char *etagBr;   // strong ETag of the brotli variant\n"
+            "\tconst uint8_t *gzip;\n"
+            "\tuint32_t gzipLen;\n"
+            "\tconst uint8_t *br;    // nullptr without brotli variant\n"
+            "\tuint32_t brLen;\n"
+            "} WWWAsset;\n\n"
         )
 
-        for asset_path, asset in assetMap.items():
+        progmem.write("const WWWAsset WWW_ASSETS[] = {\n")
+        for asset in assets:
             progmem.write(
-                f'\t\t\thandler("/{asset_path}", "{asset["mime"]}", {asset["name"]}, {asset["size"]});\n'
+                f'\t{{"{asset["path"]}", "{asset["mime"]}", "{asset["cache"]}", '
+                f'"\\"{asset["hash"]}\\"", "\\"{asset["hash"]}-br\\"", '
+                f'{asset["gzip"]}, {asset["gzip_size"]}, {asset["br"]}, {asset["br_size"]}}},\n'
             )
+        progmem.write("};\n\n")
+
+        progmem.write("// Perfect hash of the asset paths (FNV-1a with seed) to their index\n")
+        progmem.write(f"const uint16_t WWW_ASSET_SLOTS[{slots}] = {{\n\t")
+        for i, index in enumerate(slot_table):
+            if i and not (i % 16):
+                progmem.write("\n\t")
+            progmem.write(f"0x{index:04X},")
+        progmem.write("\n};\n\n")
 
-        progmem.write("\t\t}\n")
+        progmem.write("class WWWData {\n")
+        progmem.write("\tpublic:\n")
+        progmem.write(f"\t\tstatic constexpr size_t NUM_ASSETS = {len(assets)};\n")
+        progmem.write(f"\t\tstatic constexpr uint32_t HASH_SEED = {seed};\n")
+        progmem.write(f"\t\tstatic constexpr uint32_t NUM_SLOTS = {slots};\n")
+        progmem.write(f"\t\tstatic constexpr uint16_t INDEX_ASSET = 0x{index_asset:04X};\n\n")
+        progmem.write(
+            "\t\t// Find an asset by its path (not NUL-terminated, e.g. the URI without query), nullptr if unknown\n"
+            "\t\tstatic const WWWAsset *find(const char *path, size_t len) {\n"
+            "\t\t\tuint32_t hash = 2166136261u ^ HASH_SEED;\n"
+            "\t\t\tfor (size_t i = 0; i < len; i++)\n"
+            "\t\t\t\thash = (hash ^ (uint8_t)path[i]) * 16777619u;\n"
+            "\t\t\tuint16_t index = WWW_ASSET_SLOTS[hash & (NUM_SLOTS - 1)];\n"
+            "\t\t\tif (index >= NUM_ASSETS)\n"
+            "\t\t\t\treturn nullptr;\n"
+            "\t\t\tconst WWWAsset *asset = &WWW_ASSETS[index];\n"
+            "\t\t\treturn strncmp(asset->path, path, len) == 0 && asset->path[len] == '\\0' ? asset : nullptr;\n"
+            "\t\t}\n\n"
+            "\t\t// Page served for all paths without an asset (client side routing)\n"
+            "\t\tstatic const WWWAsset *index() {\n"
+            "\t\t\treturn INDEX_ASSET < NUM_ASSETS ? &WWW_ASSETS[INDEX_ASSET] : nullptr;\n"
+            "\t\t}\n"
+        )
         progmem.write("};\n\n")
 
 
@@ -33,47 +33,56 @@ AlarmBlocker::AlarmBlocker(ESP32SvelteKit *sveltekit) : _sveltekit(sveltekit),
                                                         _server(sveltekit->getServer()),
                                                         _securityManager(sveltekit->getSecurityManager()),
                                                         _eventSocket(sveltekit->getSocket()),
+                                                        _remainingBlockTimeEvent(EVENT_HANDLE_INVALID),
                                                         _lastLooped(0),
                                                         _isBlocked(false),
-                                                        _remainingBlockingTimeMS(0)
+                                                        _remainingBlockingTimeMS(0),
+                                                        _reportedBlocked(false),
+                                                        _stateEmitter(ALARMBLOCKER_LOOP_PERIOD_MS, std::bind(&AlarmBlocker::_emitRemainingBlockingTime, this))
 {
 }
 
 void AlarmBlocker::begin()
 {
-    _eventSocket->registerEvent(ALARMBLOCKER_EVENT_REMAINING_BLOCK_TIME);
-    _sveltekit->addLoopFunction(std::bind(&AlarmBlocker::loop, this));
+    _remainingBlockTimeEvent = _eventSocket->registerEvent(ALARMBLOCKER_EVENT_REMAINING_BLOCK_TIME);
+    _sveltekit->addLoopTask("alarm-blocker", std::bind(&AlarmBlocker::loop, this), ALARMBLOCKER_LOOP_PERIOD_MS);
+    _stateEmitter.begin(_sveltekit, "alarm-blocker-emit");
 }
 
 void AlarmBlocker::loop()
 {
+    // Called every ALARMBLOCKER_LOOP_PERIOD_MS by the loop scheduler, count the time actually elapsed
     uint32_t currentMillis = millis();
     uint32_t timeElapsed = currentMillis - _lastLooped;
+    _lastLooped = currentMillis;
 
-    // Process only if enough time has elapsed
-    if (timeElapsed >= ALARMBLOCKER_LOOP_PERIOD_MS)
+    beginTransaction();
+    if (_isBlocked)
     {
-        _lastLooped = currentMillis;
-
-        beginTransaction();
-        if (_isBlocked)
+        // Decrease remaining alarm blocking time
+        if (_remainingBlockingTimeMS >= timeElapsed)
+            _remainingBlockingTimeMS -= timeElapsed;
+        else
         {
-            // Decrease remaining alarm blocking time
-            if (_remainingBlockingTimeMS >= timeElapsed)
-                _remainingBlockingTimeMS -= timeElapsed;
-            else
-            {
-                // Time has expired, unblock alarms
-                _remainingBlockingTimeMS = 0;
-                _isBlocked = false;
-                ESP_LOGI(TAG, "Alarm blocking ended due to time expiration.");
-            }
-
-            // Emit current status to WebSocket clients
-            _emitRemainingBlockingTime();
+            // Time has expired, unblock alarms
+            _remainingBlockingTimeMS = 0;
+            _isBlocked = false;
+            ESP_LOGI(TAG, "Alarm blocking ended due to time expiration.");
         }
-        endTransaction();
+
+        // Emit current status to WebSocket clients, if the displayed seconds changed
+        _updateBlockingState();
     }
+    endTransaction();
+}
+
+void AlarmBlocker::_updateBlockingState()
+{
+    // State is identified by blocking flag (bit 31) and remaining seconds as emitted,
+    // start and end of blocking bypass the rate limit of the countdown
+    bool blockingChanged = _isBlocked != _reportedBlocked;
+    _reportedBlocked = _isBlocked;
+    _stateEmitter.update((_isBlocked ? 0x80000000UL : 0) | (_remainingBlockingTimeMS / 1000), blockingChanged);
 }
 
 void AlarmBlocker::_emitRemainingBlockingTime()
@@ -88,5 +97,5 @@ void AlarmBlocker::_emitRemainingBlockingTime()
     endTransaction();
 
     // Send status update via WebSocket
-    _eventSocket->emitEvent(ALARMBLOCKER_EVENT_REMAINING_BLOCK_TIME, jsonRoot);
+    _eventSocket->emitEvent(_remainingBlockTimeEvent, jsonRoot);
 }
\ No newline at end of file
@@ -35,6 +35,7 @@
 #include <SecurityManager.h>
 #include <PsychicHttp.h>
 #include <ThreadSafeService.h>
+#include <ThrottledEmitter.h>
 
 #define ALARMBLOCKER_EVENT_REMAINING_BLOCK_TIME "rem-alarm-block-time" ///< WebSocket event for remaining block time updates
 #define ALARMBLOCKER_LOOP_PERIOD_MS 1000                               ///< Loop processing period in milliseconds
@@ -57,6 +58,7 @@ public:
         beginTransaction();
         _isBlocked = true;
         _remainingBlockingTimeMS = seconds * 1000; // Convert seconds to milliseconds
+        _updateBlockingState();
         endTransaction();
     }
 
@@ -66,6 +68,7 @@ public:
         beginTransaction();
         _isBlocked = false;
         _remainingBlockingTimeMS = 0;
+        _updateBlockingState();
         endTransaction();
 
         return ESP_OK;
@@ -84,14 +87,20 @@ public:
 private:
     static constexpr const char *TAG = "AlarmBlocker"; ///< Logging tag
 
-    ESP32SvelteKit *_sveltekit;        ///< ESP32SvelteKit framework instance
-    PsychicHttpServer *_server;        ///< HTTP server instance
-    SecurityManager *_securityManager; ///< Security manager instance
-    EventSocket *_eventSocket;         ///< WebSocket event manager
+    ESP32SvelteKit *_sveltekit;           ///< ESP32SvelteKit framework instance
+    PsychicHttpServer *_server;           ///< HTTP server instance
+    SecurityManager *_securityManager;    ///< Security manager instance
+    EventSocket *_eventSocket;            ///< WebSocket event manager
+    EventHandle _remainingBlockTimeEvent; ///< Handle of the remaining block time event
 
     volatile uint32_t _lastLooped;     ///< Last loop processing time (ms)
     bool _isBlocked;                   ///< Current blocking state
     uint32_t _remainingBlockingTimeMS; ///< Remaining blocking time (ms)
+    bool _reportedBlocked;             ///< Blocking flag of the last reported state
+    ThrottledEmitter _stateEmitter;    ///< Emits the blocking state on changes only, rate limited
+
+    /// Report the blocking state, emitted via WebSocket if it changed (must be called within transaction)
+    void _updateBlockingState();
 
     /// Emit remaining blocking time via WebSocket (thread-safe)
     void _emitRemainingBlockingTime();
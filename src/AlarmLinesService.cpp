@@ -109,15 +109,26 @@ AlarmLinesService::AlarmLinesService(ESP32SvelteKit *sveltekit, CC1101Controller
                                                                                                 _cc1101Ctrl(cc1101Ctrl),
                                                                                                 _txTaskHandle(nullptr),
                                                                                                 _txSemaphore(nullptr),
-                                                                                                _timerHandle(nullptr),
+                                                                                                _txTimer(nullptr),
                                                                                                 _isTransmitting(false),
+                                                                                                _preemptRequested(false),
+                                                                                                _currentPriority(0),
                                                                                                 _transmissionTimeElapsed(0),
                                                                                                 _lastTXLoop(0),
-                                                                                                _txRepeat(0),
-                                                                                                _txDataLength(0),
-                                                                                                _packetCntStep(0.0f),
-                                                                                                _currentPacketCnt(0.0f),
-                                                                                                _txPeriodUs(0),
+                                                                                                _train{{}, 0, 0, 0, ALARMLINES_ID_NONE, 0, ""},
+                                                                                                _txQueueMutex(nullptr),
+                                                                                                _txQueueStats{},
+                                                                                                _txStatsWritten(0),
+                                                                                                _txStatsLock(portMUX_INITIALIZER_UNLOCKED),
+                                                                                                _seqPersistedBound(ALARMLINES_NVS_SEQ_DEFAULT),
+                                                                                                _seqRequestedBound(ALARMLINES_NVS_SEQ_DEFAULT),
+                                                                                                _seqMutex(nullptr),
+                                                                                                _seqStats{},
+                                                                                                _lastSeqCommitFailure(0),
+                                                                                                _seqCommitTask(0),
+                                                                                                _numKnownLineIds(0),
+                                                                                                _knownLineIdsSeq(0),
+                                                                                                _knownLineIdsLock(portMUX_INITIALIZER_UNLOCKED),
                                                                                                 _packet_sequence_number(ALARMLINES_NVS_SEQ_DEFAULT)
 {
 }
@@ -125,12 +136,34 @@ AlarmLinesService::AlarmLinesService(ESP32SvelteKit *sveltekit, CC1101Controller
 void AlarmLinesService::begin()
 {
     _httpEndpoint.begin();
-    _fsPersistence.readFromFS(); // Load the persisted packet sequence number from NVS
-    if (loadPcktSeqNum() != ESP_OK)
+    _fsPersistence.readFromFS();
+
+    // Register WebSocket events for real-time notifications
+    _eventSocket->registerEvent(ALARMLINES_EVENT_NEW_LINE);
+    _eventSocket->registerEvent(ALARMLINES_EVENT_ACTION_FINISHED);
+    _eventSocket->registerEvent(ALARMLINES_EVENT_LINES_CHANGED);
+
+    /* Keep the known line IDs of the RX path in sync with every change of the alarm lines and notify clients */
+    addUpdateHandler([&](const String &originId)
+                     {
+                         _updateKnownLineIds();
+                         _emitLinesChangedEvent();
+                     },
+                     false);
+    _updateKnownLineIds();
+
+    // Load the persisted packet sequence number from NVS
+    _seqMutex = xSemaphoreCreateMutex();
+    if (_seqMutex == nullptr)
     {
-        ESP_LOGE(TAG, "Failed to load packet sequence number from NVS. Using default value: %u.", ALARMLINES_NVS_SEQ_DEFAULT);
-        _packet_sequence_number = ALARMLINES_NVS_SEQ_DEFAULT;
+        ESP_LOGE(TAG, "Failed to create sequence number mutex.");
+        return;
     }
+    if (loadPcktSeqNum() != ESP_OK)
+        ESP_LOGE(TAG, "Failed to reserve packet sequence numbers in NVS, continuing at %u.", (uint8_t)(_packet_sequence_number + 1));
+
+    // Background commit of reserved sequence number blocks
+    _seqCommitTask = _sveltekit->addLoopTask("alarm-lines-seq", std::bind(&AlarmLinesService::loop, this), ALARMLINES_NVS_SEQ_RETRY_MS);
 
 #if FT_ENABLED(FT_ALLOW_BROADCAST)
     _featureService->addFeature("allow_broadcast", true);
@@ -154,6 +187,14 @@ void AlarmLinesService::begin()
 
     ESP_LOGI(TAG, "TX semaphore created (%p).", _txSemaphore);
 
+    // Initialize the mutex protecting the queue of pending actions
+    _txQueueMutex = xSemaphoreCreateMutex();
+    if (_txQueueMutex == nullptr)
+    {
+        ESP_LOGE(TAG, "Failed to create TX queue mutex.");
+        return;
+    }
+
     // Create TX task for handling RF transmission operations
     BaseType_t xReturned;
     xReturned = xTaskCreatePinnedToCore(
@@ -173,16 +214,22 @@ void AlarmLinesService::begin()
 
     ESP_LOGI(TAG, "TX task created (%p).", _txTaskHandle);
 
-    // Configure ESP timer for accurate transmission intervals
-    const esp_timer_create_args_t timer_args = {
-        .callback = _onTimerImpl,
-        .arg = this,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = ALARMLINES_TX_PERIOD_TIMER_NAME};
+    // Configure periodic hardware timer for accurate transmission intervals, its alarm is handled in ISR context
+    gptimer_config_t timerConfig = {};
+    timerConfig.clk_src = GPTIMER_CLK_SRC_DEFAULT;
+    timerConfig.direction = GPTIMER_COUNT_UP;
+    timerConfig.resolution_hz = ALARMLINES_TX_TIMER_RESOLUTION_HZ;
+
+    gptimer_event_callbacks_t timerCallbacks = {};
+    timerCallbacks.on_alarm = _onTimerISR;
 
-    esp_err_t ret = esp_timer_create(&timer_args, &_timerHandle);
+    esp_err_t ret = gptimer_new_timer(&timerConfig, &_txTimer);
+    if (ret == ESP_OK)
+        ret = gptimer_register_event_callbacks(_txTimer, &timerCallbacks, this);
+    if (ret == ESP_OK)
+        ret = gptimer_enable(_txTimer);
     if (ret != ESP_OK)
-        ESP_LOGE(TAG, "Failed to create TX timer.");
+        ESP_LOGE(TAG, "Failed to create TX timer: %s", esp_err_to_name(ret));
 
     // Register REST endpoint for triggering alarm line actions
     _server->on(ALARMLINES_PATH_ACTIONS,
@@ -190,109 +237,250 @@ void AlarmLinesService::begin()
                 _securityManager->wrapCallback(std::bind(&AlarmLinesService::_performAction, this, std::placeholders::_1, std::placeholders::_2),
                                                AuthenticationPredicates::IS_ADMIN));
 
-    // Register WebSocket events for real-time notifications
-    _eventSocket->registerEvent(ALARMLINES_EVENT_NEW_LINE);
-    _eventSocket->registerEvent(ALARMLINES_EVENT_ACTION_FINISHED);
+    // Register REST endpoint for the timing statistics of the last transmissions
+    _server->on(ALARMLINES_PATH_TX_STATS,
+                HTTP_GET,
+                _securityManager->wrapRequest(std::bind(&AlarmLinesService::_handleGetTxStats, this, std::placeholders::_1),
+                                              AuthenticationPredicates::IS_AUTHENTICATED));
+
+    // Register REST endpoint for the pending actions and scheduler statistics
+    _server->on(ALARMLINES_PATH_TX_QUEUE,
+                HTTP_GET,
+                _securityManager->wrapRequest(std::bind(&AlarmLinesService::_handleGetTxQueue, this, std::placeholders::_1),
+                                              AuthenticationPredicates::IS_AUTHENTICATED));
 }
 
-void AlarmLinesService::_onTimer()
+bool IRAM_ATTR AlarmLinesService::_onTimerISR(gptimer_handle_t timer, const gptimer_alarm_event_data_t *eventData, void *userContext)
 {
-    gpio_set_level(static_cast<gpio_num_t>(GPIO_TEST2), 0); // Temporary for testing
+    AlarmLinesService *service = static_cast<AlarmLinesService *>(userContext);
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+
+    // Only signal the TX task, the packet is written to the FIFO there
+    vTaskNotifyGiveIndexedFromISR(service->_txTaskHandle, ALARMLINES_TX_TASK_NOTIFICATION_INDEX, &higherPriorityTaskWoken);
 
-    // Signal TX task to proceed with next packet transmission
-    xTaskNotifyGiveIndexed(_txTaskHandle, ALARMLINES_TX_TASK_NOTIFICATION_INDEX);
+    return higherPriorityTaskWoken == pdTRUE;
 }
 
-void AlarmLinesService::_txLoop()
+void AlarmLinesService::_buildTrain(alarm_lines_tx_train_t &train, const uint8_t *basePackets, size_t numLines, size_t length,
+                                    uint32_t numPackets, uint16_t firstPacketCnt, uint16_t lastPacketCnt, uint32_t periodUs)
 {
-    ESP_LOGI(pcTaskGetName(0), "Started.");
+    // Each line keeps the protocol period, its packets are sent in consecutive slots of the period
+    train.packetLength = length;
+    train.numPackets = numPackets * numLines;
+    train.numLines = numLines;
+    train.periodUs = periodUs / numLines;
+    train.packets.resize(train.numPackets * length);
+
+    // Packet counter descends linearly from first to last value (truncated as by the detectors' own trains)
+    uint32_t countRange = firstPacketCnt - lastPacketCnt;
+    for (uint32_t i = 0; i < numPackets; i++)
+    {
+        uint16_t packetCnt = numPackets > 1 ? firstPacketCnt - (i * countRange + numPackets - 2) / (numPackets - 1) : firstPacketCnt;
 
-    while (1)
+        for (size_t line = 0; line < numLines; line++)
+        {
+            uint8_t *packet = &train.packets[(i * numLines + line) * length];
+            memcpy(packet, &basePackets[line * length], length);
+            packet[ALARMLINES_PACKET_POS_COUNTER] = packetCnt & 0xFF;
+            packet[ALARMLINES_PACKET_POS_COUNTER + 1] = packetCnt >> 8;
+        }
+    }
+}
+
+uint32_t AlarmLinesService::_slotsPerPeriod(size_t length, uint32_t periodUs)
+{
+    uint32_t slotUs = (ALARMLINES_RF_OVERHEAD_BYTES + length) * ALARMLINES_RF_BYTE_DURATION_NS / 1000 + ALARMLINES_TX_SLOT_GUARD_US;
+    return std::max<uint32_t>(1, periodUs / slotUs);
+}
+
+/// Add a per-packet duration to its min/max and running sum
+static inline void accumulateDuration(alarm_lines_tx_duration_stats_t &duration, uint64_t &sum, uint32_t value, bool first)
+{
+    duration.min = first ? value : std::min(duration.min, value);
+    duration.max = first ? value : std::max(duration.max, value);
+    sum += value;
+}
+
+bool AlarmLinesService::_sendTrain(const alarm_lines_tx_train_t &train, alarm_lines_tx_stats_t &stats)
+{
+    stats = {};
+    stats.timestamp = time(nullptr);
+    stats.action = train.action;
+    stats.lineId = train.lineId;
+    stats.numLines = train.numLines;
+    stats.numPackets = train.numPackets;
+    stats.targetPeriodUs = train.periodUs;
+    stats.targetDurationUs = train.numPackets > 0 ? (train.numPackets - 1) * train.periodUs : 0;
+
+    ESP_LOGI(pcTaskGetName(0), "Starting transmission: lines: %lu, packets: %lu, period: %.3f ms, first packet count: 0x%02x%02x.",
+             train.numLines,
+             train.numPackets,
+             train.periodUs / 1000.0,
+             train.packets[ALARMLINES_PACKET_POS_COUNTER + 1],
+             train.packets[ALARMLINES_PACKET_POS_COUNTER]);
+
+    // Periodic alarm, reloaded by hardware, so the period does not depend on task scheduling
+    gptimer_alarm_config_t alarmConfig = {};
+    alarmConfig.alarm_count = train.periodUs * (ALARMLINES_TX_TIMER_RESOLUTION_HZ / 1000000);
+    alarmConfig.reload_count = 0;
+    alarmConfig.flags.auto_reload_on_alarm = true;
+
+    ulTaskNotifyValueClearIndexed(NULL, ALARMLINES_TX_TASK_NOTIFICATION_INDEX, UINT32_MAX);
+    if (gptimer_set_alarm_action(_txTimer, &alarmConfig) != ESP_OK ||
+        gptimer_set_raw_count(_txTimer, 0) != ESP_OK ||
+        gptimer_start(_txTimer) != ESP_OK)
     {
-        // Wait for transmission request via semaphore
-        if (xSemaphoreTake(_txSemaphore, portMAX_DELAY) == pdTRUE)
+        ESP_LOGE(TAG, "Failed to start TX timer.");
+        stats.timedOut = true;
+        return true;
+    }
+
+    bool timedOut = false;
+    _lastTXLoop = millis();
+
+    int64_t firstPacketStart = 0;
+    int64_t lastPacketStart = 0;
+    uint64_t periodSum = 0, periodSquareSum = 0;
+    uint64_t fifoWriteSum = 0, gdo0HighWaitSum = 0, gdo0LowWaitSum = 0;
+    uint64_t cpuSum = 0;
+
+    for (uint32_t i = 0; i < train.numPackets; i++)
+    {
+        // Wait for the timer before every packet but the first
+        if (i > 0 && ulTaskNotifyTakeIndexed(ALARMLINES_TX_TASK_NOTIFICATION_INDEX, pdTRUE, ALARMLINES_TX_TASK_ITERATION_MAX_WAITING_TICKS) == 0)
         {
-            _isTransmitting = true;
+            ESP_LOGE(TAG, "Failed to receive timer notification @ iteration %lu.", i);
+            break;
+        }
 
-            // Temporarily disable RX monitoring to avoid interference
-            _cc1101Ctrl->disableRXMonitoring();
+        // Give way to a higher priority action at the packet boundary
+        if (_preemptRequested)
+        {
+            ESP_LOGI(TAG, "Transmission preempted by higher priority action after %lu packets.", i);
+            stats.preempted = true;
+            break;
+        }
 
-            // Initialize transmission monitoring
-            bool timedOut = false;
-            _transmissionTimeElapsed = 0;
-            _lastTXLoop = millis();
+        // Check for transmission timeout
+        uint32_t _transmissionTimeElapsed = millis() - _lastTXLoop;
+        if (_transmissionTimeElapsed >= ALARMLINES_TX_TIMEOUT_MS)
+        {
+            ESP_LOGW(TAG, "Transmission timeout reached (%lu ms). Cancelling running transmission.", ALARMLINES_TX_TIMEOUT_MS);
+            timedOut = true;
+            break;
+        }
 
-            ESP_LOGI(pcTaskGetName(0), "Starting transmission: packets: %lu, period: %.3f ms, first packet count: %u (0x%04x), packet count step: %u.",
-                     _txRepeat,
-                     _txPeriodUs / 1000.0,
-                     static_cast<uint16_t>(_currentPacketCnt),
-                     static_cast<uint16_t>(_currentPacketCnt),
-                     static_cast<uint16_t>(_packetCntStep));
+        gpio_set_level(static_cast<gpio_num_t>(GPIO_TEST1), 1); // Temporary for testing
 
-            for (int i = 1; i <= _txRepeat; i++)
-            {
-                // Check for transmission timeout
-                uint32_t currentMillis = millis();
-                uint32_t _transmissionTimeElapsed = currentMillis - _lastTXLoop;
-                if (_transmissionTimeElapsed >= ALARMLINES_TX_TIMEOUT_MS)
-                {
-                    ESP_LOGW(TAG, "Transmission timeout reached (%lu ms). Cancelling running transmission.", ALARMLINES_TX_TIMEOUT_MS);
-                    timedOut = true;
-                    break;
-                }
+        // Measure the actual period against the packet's slot on the timer grid
+        int64_t packetStart = esp_timer_get_time();
+        if (i == 0)
+        {
+            firstPacketStart = packetStart;
+        }
+        else
+        {
+            uint32_t period = packetStart - lastPacketStart;
+            stats.periodMinUs = i == 1 ? period : std::min(stats.periodMinUs, period);
+            stats.periodMaxUs = std::max(stats.periodMaxUs, period);
+            periodSum += period;
+            periodSquareSum += static_cast<uint64_t>(period) * period;
+
+            if (packetStart - firstPacketStart > static_cast<int64_t>(i) * train.periodUs + ALARMLINES_TX_DEADLINE_TOLERANCE_US)
+                stats.missedDeadlines++;
+        }
+        lastPacketStart = packetStart;
 
-                // GPIO timing markers for debug/analysis
-                gpio_set_level(static_cast<gpio_num_t>(GPIO_TEST1), 1); // Temporary for testing
-                gpio_set_level(static_cast<gpio_num_t>(GPIO_TEST2), 1); // Temporary for testing
+        // Execute RF packet transmission of the precomputed packet
+        cc1101_tx_timing_t timing = {};
+        if (cc1101_send_data_timed(const_cast<uint8_t *>(&train.packets[i * train.packetLength]), train.packetLength, &timing) != ESP_OK)
+            ESP_LOGE(pcTaskGetName(0), "Failed to send packet @ iteration %lu.", i);
 
-                // Configure timer for next iteration (except for last packet)
-                if (i < _txRepeat) // Don't (re)start the timer for the last iteration
-                {
-                    esp_err_t ret = esp_timer_start_once(_timerHandle, _txPeriodUs);
-                    if (ret != ESP_OK)
-                    {
-                        ESP_LOGE(TAG, "Failed to start TX timer: %s.", esp_err_to_name(ret));
-                        break;
-                    }
-                }
+        accumulateDuration(stats.fifoWrite, fifoWriteSum, timing.fifo_write_us, i == 0);
+        accumulateDuration(stats.gdo0HighWait, gdo0HighWaitSum, timing.gdo0_high_wait_us, i == 0);
+        accumulateDuration(stats.gdo0LowWait, gdo0LowWaitSum, timing.gdo0_low_wait_us, i == 0);
+        cpuSum += timing.cpu_us;
+        stats.numSent++;
 
-                // Update packet count in transmission buffer (2 bytes, little-endian)
-                *(uint16_t *)&_txBuffer[1] = (uint16_t)_currentPacketCnt;
+        _lastTXLoop = millis();
 
-                // Execute RF packet transmission
-                if (cc1101_send_data(_txBuffer, _txDataLength) != ESP_OK)
-                    ESP_LOGE(pcTaskGetName(0), "Failed to send packet @ iteration %d.", i);
+        gpio_set_level(static_cast<gpio_num_t>(GPIO_TEST1), 0); // Temporary for testing
+    }
+
+    gptimer_stop(_txTimer);
 
-                // Progress packet count for fire alarm sequences
-                _currentPacketCnt = std::max(_currentPacketCnt - _packetCntStep, 0.0f);
+    // Finalize the statistics
+    stats.timedOut = timedOut;
+    stats.durationUs = lastPacketStart - firstPacketStart;
+    if (stats.durationUs > 0)
+        stats.cpuLoad = 100.0f * cpuSum / stats.durationUs;
+    if (stats.numSent > 0)
+    {
+        stats.fifoWrite.mean = fifoWriteSum / stats.numSent;
+        stats.gdo0HighWait.mean = gdo0HighWaitSum / stats.numSent;
+        stats.gdo0LowWait.mean = gdo0LowWaitSum / stats.numSent;
+    }
+    if (stats.numSent > 1)
+    {
+        uint32_t numPeriods = stats.numSent - 1;
+        double mean = static_cast<double>(periodSum) / numPeriods;
+        double variance = static_cast<double>(periodSquareSum) / numPeriods - mean * mean;
+        stats.periodMeanUs = static_cast<uint32_t>(mean + 0.5);
+        stats.periodStddevUs = variance > 0 ? sqrt(variance) : 0.0f;
+    }
+
+    ESP_LOGI(pcTaskGetName(0), "Transmission timing: period %lu/%lu/%lu us (min/mean/max, target %lu us), stddev %.1f us, %lu missed deadlines, duration %lu us (target %lu us).",
+             stats.periodMinUs, stats.periodMeanUs, stats.periodMaxUs, stats.targetPeriodUs,
+             stats.periodStddevUs, stats.missedDeadlines, stats.durationUs, stats.targetDurationUs);
+    ESP_LOGI(pcTaskGetName(0), "TX task CPU load during transmission: %.1f %%.", stats.cpuLoad);
+
+    return timedOut;
+}
+
+void AlarmLinesService::_txLoop()
+{
+    ESP_LOGI(pcTaskGetName(0), "Started.");
+
+    while (1)
+    {
+        // Wait for transmission request via semaphore
+        if (xSemaphoreTake(_txSemaphore, portMAX_DELAY) == pdTRUE)
+        {
+            // Perform all pending actions, highest priority first
+            alarm_lines_tx_request_t request;
+            while (_dequeueAction(request))
+            {
+                // Temporarily disable RX monitoring to avoid interference
+                _cc1101Ctrl->disableRXMonitoring();
 
-                _lastTXLoop = millis();
+                size_t numLines = _buildActionTrain(request);
 
-                gpio_set_level(static_cast<gpio_num_t>(GPIO_TEST1), 0); // Temporary for testing
+                alarm_lines_tx_stats_t stats;
+                _sendTrain(_train, stats);
+                _recordTxStats(stats);
 
-                // Wait for timer notification before next packet (except last iteration)
-                if (i < _txRepeat) // Don't wait after the last iteration
+                // Perform the interrupted action again after the higher priority one, continue with remaining lines of a batch
+                if (stats.preempted)
                 {
-                    if (ulTaskNotifyTakeIndexed(ALARMLINES_TX_TASK_NOTIFICATION_INDEX, pdTRUE, ALARMLINES_TX_TASK_ITERATION_MAX_WAITING_TICKS) != 1)
-                    {
-                        ESP_LOGE(TAG, "Failed to receive timer notification @ iteration %d.", i);
-                        break;
-                    }
+                    _requeueAction(request, true);
+                }
+                else if (numLines < request.lineIds.size())
+                {
+                    request.lineIds.erase(request.lineIds.begin(), request.lineIds.begin() + numLines);
+                    _requeueAction(request, false);
                 }
-            }
-
-            _isTransmitting = false;
 
-            // Notify clients of transmission completion
-            _emitActionFinishedEvent(timedOut);
+                // Notify clients of transmission completion
+                _emitActionFinishedEvent(stats);
 
-            // Restore RF controller to receive state
-            cc1101_set_rx_state();
+                // Restore RF controller to receive state
+                cc1101_set_rx_state();
 
-            // Re-enable RX monitoring after transmission completion
-            _cc1101Ctrl->enableRXMonitoring();
+                // Re-enable RX monitoring after transmission completion
+                _cc1101Ctrl->enableRXMonitoring();
 
-            ESP_LOGI(pcTaskGetName(0), "Transmission finished.");
+                ESP_LOGI(pcTaskGetName(0), "Transmission finished.");
+            }
         }
         else
         {
@@ -307,95 +495,351 @@ void AlarmLinesService::_txLoop()
 
 esp_err_t AlarmLinesService::_performAction(PsychicRequest *request, JsonVariant &json)
 {
-    if (_isTransmitting)
-    {
-        ESP_LOGW(TAG, "Previous action is still performed. Wait until it finishes to start another action.");
-        return request->reply(503, "application/json", "{\"success\": false, \"reason\": \"Previous action is still performed.\"}");
-    }
+    int64_t start = esp_timer_get_time();
 
     if (!json.is<JsonObject>())
         return request->reply(400, "application/json", "{\"success\": false, \"reason\": \"Invalid JSON\"}");
 
     JsonObject jsonObject = json.as<JsonObject>();
-    if (!jsonObject["lineId"].is<uint32_t>())
+
+    // Either a single line or a batch of lines
+    std::vector<uint32_t> lineIds;
+    if (jsonObject["lineIds"].is<JsonArray>())
+    {
+        JsonArray jsonLineIds = jsonObject["lineIds"].as<JsonArray>();
+        if (jsonLineIds.size() == 0 || jsonLineIds.size() > ALARMLINES_MAX_NUM)
+            return request->reply(400, "application/json", "{\"success\": false, \"reason\": \"Invalid number of line IDs.\"}");
+
+        for (JsonVariant jsonLineId : jsonLineIds)
+        {
+            if (!jsonLineId.is<uint32_t>())
+                return request->reply(400, "application/json", "{\"success\": false, \"reason\": \"Invalid line ID.\"}");
+            uint32_t lineId = jsonLineId.as<uint32_t>();
+            if (std::find(lineIds.begin(), lineIds.end(), lineId) == lineIds.end())
+                lineIds.push_back(lineId);
+        }
+    }
+    else if (jsonObject["lineId"].is<uint32_t>())
+    {
+        lineIds.push_back(jsonObject["lineId"].as<uint32_t>());
+    }
+    else
+    {
         return request->reply(400, "application/json", "{\"success\": false, \"reason\": \"Invalid line ID.\"}");
+    }
 
-    // Extract target alarm line ID and convert to network byte order
-    uint32_t lineId = htonl(jsonObject["lineId"].as<uint32_t>());
+    // A batch may be sent as a single broadcast train instead, if allowed
+    if (lineIds.size() > 1 && (jsonObject["broadcast"] | false))
+    {
+#if FT_ENABLED(FT_ALLOW_BROADCAST)
+        lineIds.assign(1, ALARMLINES_ID_BROADCAST);
+#else
+        return request->reply(400, "application/json", "{\"success\": false, \"reason\": \"Broadcast is not allowed.\"}");
+#endif
+    }
 
     if (!jsonObject["action"].is<String>())
         return request->reply(400, "application/json", "{\"success\": false, \"reason\": \"Action missing or of wrong type.\"}");
 
-    String action = jsonObject["action"].as<String>();
+    String actionName = jsonObject["action"].as<String>();
+    alarm_lines_action_t action;
+    if (!_parseAction(actionName, action))
+    {
+        ESP_LOGE(TAG, "Unknown action '%s'.", actionName.c_str());
+        return request->reply(400, "application/json", "{\"success\": false, \"reason\": \"Unknown action.\"}");
+    }
 
-    // Configure transmission parameters based on requested action
-    if (action == "line-test-start" || action == "line-test-stop") // Line test operations
+    // Queue the action, the TX task transmits it by priority
+    bool merged = false;
+    size_t position = 0;
+    if (_enqueueAction(lineIds, action, merged, position) != ESP_OK)
     {
-        _txPeriodUs = ALARMLINES_TX_PERIOD_LINETEST_US;
-        _txRepeat = ALARMLINES_TX_NUM_REPEAT_LINETEST;
-        _currentPacketCnt = ALARMLINES_LINETEST_FIRST_PCKTCNT;
-        _packetCntStep = ALARMLINES_LINETEST_PCKTCNT_STEP;
+        ESP_LOGW(TAG, "TX queue is full. Wait until pending actions are performed.");
+        return request->reply(503, "application/json", "{\"success\": false, \"reason\": \"Too many pending actions.\"}");
+    }
 
-        size_t datalen = std::min(sizeof(_packet_base_linetest), sizeof(_txBuffer));
-        memcpy(_txBuffer, _packet_base_linetest, datalen);
+    // Notify the pending TX task to start the transmission
+    if (xSemaphoreGive(_txSemaphore) != pdTRUE)
+        ESP_LOGV(TAG, "TX task already notified.");
+
+    // Processing time of accepted requests
+    uint32_t durationUs = esp_timer_get_time() - start;
+    xSemaphoreTake(_txQueueMutex, portMAX_DELAY);
+    _txQueueStats.requestMinUs = _txQueueStats.requests == 0 ? durationUs : std::min(_txQueueStats.requestMinUs, durationUs);
+    _txQueueStats.requestMaxUs = std::max(_txQueueStats.requestMaxUs, durationUs);
+    _txQueueStats.requestSumUs += durationUs;
+    _txQueueStats.requests++;
+    xSemaphoreGive(_txQueueMutex);
+
+    ESP_LOGV(TAG, "Action '%s' queued for %u line(s), first line ID '%lu' (position %u%s).", actionName.c_str(), lineIds.size(), lineIds.front(), position, merged ? ", merged" : "");
+
+    char body[64];
+    snprintf(body, sizeof(body), "{\"success\": true, \"queued\": %u, \"merged\": %s}", position, merged ? "true" : "false");
+    return request->reply(200, "application/json", body);
+}
 
-        if (action == "line-test-start")
-            _txBuffer[28] = 0x06; // Set line test start flag
-        else
-            _txBuffer[28] = 0x00; // Set line test stop flag
+bool AlarmLinesService::_parseAction(const String &name, alarm_lines_action_t &action)
+{
+    if (name == "line-test-start")
+        action = ALACT_LINE_TEST_START;
+    else if (name == "line-test-stop")
+        action = ALACT_LINE_TEST_STOP;
+    else if (name == "fire-alarm-start")
+        action = ALACT_FIRE_ALARM_START;
+    else if (name == "fire-alarm-stop")
+        action = ALACT_FIRE_ALARM_STOP;
+    else
+        return false;
 
-        _txDataLength = datalen;
+    return true;
+}
+
+const char *AlarmLinesService::_actionName(alarm_lines_action_t action)
+{
+    switch (action)
+    {
+    case ALACT_LINE_TEST_START:
+        return "line-test-start";
+    case ALACT_LINE_TEST_STOP:
+        return "line-test-stop";
+    case ALACT_FIRE_ALARM_START:
+        return "fire-alarm-start";
+    case ALACT_FIRE_ALARM_STOP:
+        return "fire-alarm-stop";
+    default:
+        return "unknown";
     }
-    else if (action == "fire-alarm-start" || action == "fire-alarm-stop") // start/stop fire alarm
+}
+
+uint8_t AlarmLinesService::_actionPriority(alarm_lines_action_t action)
+{
+    return (action == ALACT_FIRE_ALARM_START || action == ALACT_FIRE_ALARM_STOP) ? 1 : 0;
+}
+
+esp_err_t AlarmLinesService::_enqueueAction(const std::vector<uint32_t> &lineIds, alarm_lines_action_t action, bool &merged, size_t &position)
+{
+    esp_err_t ret = ESP_OK;
+    uint8_t priority = _actionPriority(action);
+    merged = false;
+
+    xSemaphoreTake(_txQueueMutex, portMAX_DELAY);
+
+    // A pending single line action of the same kind (line test / fire alarm) on the same line is superseded by the new one
+    for (auto it = _txQueue.begin(); lineIds.size() == 1 && it != _txQueue.end(); ++it)
     {
-        _txPeriodUs = ALARMLINES_TX_PERIOD_FIREALARM_US;
-        _txRepeat = ALARMLINES_TX_NUM_REPEAT_FIREALARM;
-        _currentPacketCnt = ALARMLINES_FIREALARM_FIRST_PCKTCNT;
-        _packetCntStep = ALARMLINES_FIREALARM_PCKTCNT_STEP;
+        if (!it->started && it->lineIds == lineIds && _actionPriority(it->action) == priority)
+        {
+            it->action = action;
+            merged = true;
+            position = it - _txQueue.begin();
+            _txQueueStats.merged++;
+            break;
+        }
+    }
 
-        size_t datalen = std::min(sizeof(_packet_base_firealarm), sizeof(_txBuffer));
-        memcpy(_txBuffer, _packet_base_firealarm, datalen);
-        if (action == "fire-alarm-start")
-            _txBuffer[28] = 0x01; // Set fire alarm start flag
+    if (!merged)
+    {
+        if (_txQueue.size() >= ALARMLINES_TX_QUEUE_SIZE)
+        {
+            _txQueueStats.rejected++;
+            ret = ESP_ERR_NO_MEM;
+        }
         else
-            _txBuffer[30] = 0x01; // Set fire alarm end flag
-
-        _txDataLength = datalen;
+        {
+            _txQueue.push_back({lineIds, action, esp_timer_get_time(), false});
+            position = _txQueue.size() - 1;
+            _txQueueStats.enqueued++;
+        }
     }
-    else
+
+    // Stop a running lower priority train at its next packet boundary
+    if (ret == ESP_OK && _isTransmitting && priority > _currentPriority)
+        _preemptRequested = true;
+
+    xSemaphoreGive(_txQueueMutex);
+
+    return ret;
+}
+
+bool AlarmLinesService::_dequeueAction(alarm_lines_tx_request_t &request)
+{
+    xSemaphoreTake(_txQueueMutex, portMAX_DELAY);
+
+    if (_txQueue.empty())
     {
-        ESP_LOGE(TAG, "Unknown action '%s'.", action.c_str());
-        return request->reply(400, "application/json", "{\"success\": false, \"reason\": \"Unknown action.\"}");
+        _isTransmitting = false;
+        xSemaphoreGive(_txQueueMutex);
+        return false;
     }
 
-    // Common packet preparation
-    memcpy(&_txBuffer[18], &lineId, sizeof(lineId)); // Set line id
-    _txBuffer[23] = incPcktSeqNum();                 // Increment and persist sequence number
+    // Highest priority first, FIFO within a priority
+    auto next = _txQueue.begin();
+    for (auto it = _txQueue.begin(); it != _txQueue.end(); ++it)
+    {
+        if (_actionPriority(it->action) > _actionPriority(next->action))
+            next = it;
+    }
+    request = *next;
+    _txQueue.erase(next);
 
-    // Notify the pending TX task to start the transmission
-    if (xSemaphoreGive(_txSemaphore) != pdTRUE)
+    // Queue wait time until the first transmission of an action
+    if (!request.started)
     {
-        ESP_LOGE(TAG, "Failed to give semaphore.");
-        return request->reply(500, "application/json", "{\"success\": false, \"reason\": \"Failed to give semaphore.\"}");
+        uint32_t waitMs = (esp_timer_get_time() - request.enqueuedUs) / 1000;
+        _txQueueStats.waitMinMs = _txQueueStats.started == 0 ? waitMs : std::min(_txQueueStats.waitMinMs, waitMs);
+        _txQueueStats.waitMaxMs = std::max(_txQueueStats.waitMaxMs, waitMs);
+        _txQueueStats.waitSumMs += waitMs;
+        _txQueueStats.started++;
+        request.started = true;
     }
 
-    ESP_LOGV(TAG, "Action triggered successfully für line ID '%lu'.", lineId);
-    return request->reply(200, "application/json", "{\"success\": true}");
+    _isTransmitting = true;
+    _currentPriority = _actionPriority(request.action);
+    _preemptRequested = false;
+
+    xSemaphoreGive(_txQueueMutex);
+
+    return true;
 }
 
-bool AlarmLinesService::_alarmLineExists(uint32_t id)
+void AlarmLinesService::_requeueAction(const alarm_lines_tx_request_t &request, bool preempted)
 {
-    bool found = false;
+    xSemaphoreTake(_txQueueMutex, portMAX_DELAY);
 
-    beginTransaction();
-    for (const auto &line : _state.lines)
+    if (preempted)
+        _txQueueStats.preempted++;
+
+    // A newer request of the same kind for this line makes the interrupted one obsolete
+    bool superseded = false;
+    for (const auto &pending : _txQueue)
     {
-        if (line.id == id)
+        if (request.lineIds.size() == 1 && pending.lineIds == request.lineIds && _actionPriority(pending.action) == _actionPriority(request.action))
         {
-            found = true;
+            superseded = true;
             break;
         }
     }
+
+    // Not bounded by the queue size, an action once started is always completed
+    if (superseded)
+        ESP_LOGI(TAG, "Action '%s' for line %lu superseded by a pending action.", _actionName(request.action), request.lineIds.front());
+    else
+        _txQueue.push_front(request);
+
+    xSemaphoreGive(_txQueueMutex);
+}
+
+size_t AlarmLinesService::_buildActionTrain(const alarm_lines_tx_request_t &request)
+{
+    // Prepare the base packet of the requested action
+    uint8_t basePacket[CC1101_MAX_PACKET_LEN];
+    size_t datalen;
+    bool lineTest = request.action == ALACT_LINE_TEST_START || request.action == ALACT_LINE_TEST_STOP;
+
+    if (lineTest) // Line test operations
+    {
+        datalen = std::min(sizeof(_packet_base_linetest), sizeof(basePacket));
+        memcpy(basePacket, _packet_base_linetest, datalen);
+
+        if (request.action == ALACT_LINE_TEST_START)
+            basePacket[28] = 0x06; // Set line test start flag
+        else
+            basePacket[28] = 0x00; // Set line test stop flag
+    }
+    else // start/stop fire alarm
+    {
+        datalen = std::min(sizeof(_packet_base_firealarm), sizeof(basePacket));
+        memcpy(basePacket, _packet_base_firealarm, datalen);
+
+        if (request.action == ALACT_FIRE_ALARM_START)
+            basePacket[28] = 0x01; // Set fire alarm start flag
+        else
+            basePacket[30] = 0x01; // Set fire alarm end flag
+    }
+
+    uint32_t periodUs = lineTest ? ALARMLINES_TX_PERIOD_LINETEST_US : ALARMLINES_TX_PERIOD_FIREALARM_US;
+
+    // Interleave as many lines as fit into the protocol period, remaining lines of a batch follow in further trains
+    size_t numLines = std::min<size_t>(request.lineIds.size(), _slotsPerPeriod(datalen, periodUs));
+    std::vector<uint8_t> basePackets(numLines * datalen);
+
+    for (size_t line = 0; line < numLines; line++)
+    {
+        uint8_t *linePacket = &basePackets[line * datalen];
+        memcpy(linePacket, basePacket, datalen);
+
+        // Per line packet preparation
+        uint32_t lineId = htonl(request.lineIds[line]);                               // Convert to network byte order
+        memcpy(&linePacket[ALARMLINES_PACKET_POS_LINE_ID], &lineId, sizeof(lineId)); // Set line id
+        linePacket[ALARMLINES_PACKET_POS_SEQ_NUM] = incPcktSeqNum();                  // Increment sequence number (reserved in NVS)
+    }
+
+    // Precompute the whole train, so the TX loop only has to write the packets
+    if (lineTest)
+        _buildTrain(_train, basePackets.data(), numLines, datalen, ALARMLINES_TX_NUM_REPEAT_LINETEST,
+                    ALARMLINES_LINETEST_FIRST_PCKTCNT, ALARMLINES_LINETEST_LAST_PCKTCNT, periodUs);
+    else
+        _buildTrain(_train, basePackets.data(), numLines, datalen, ALARMLINES_TX_NUM_REPEAT_FIREALARM,
+                    ALARMLINES_FIREALARM_FIRST_PCKTCNT, ALARMLINES_FIREALARM_LAST_PCKTCNT, periodUs);
+
+    _train.lineId = request.lineIds.front();
+    _train.action = _actionName(request.action);
+
+    return numLines;
+}
+
+bool AlarmLinesService::isKnownAlarmLine(uint32_t id) const
+{
+    uint32_t seq = _knownLineIdsSeq.load(std::memory_order_acquire);
+    if (seq & 1) // IDs are being rewritten, let the caller take the slow path
+        return false;
+
+    // Binary search in the sorted IDs
+    uint32_t count = _numKnownLineIds.load(std::memory_order_relaxed);
+    uint32_t low = 0;
+    uint32_t high = count;
+    while (low < high)
+    {
+        uint32_t mid = (low + high) / 2;
+        if (_knownLineIds[mid].load(std::memory_order_relaxed) < id)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    bool found = low < count && _knownLineIds[low].load(std::memory_order_relaxed) == id;
+
+    // Result is only valid if no writer interfered
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return found && _knownLineIdsSeq.load(std::memory_order_relaxed) == seq;
+}
+
+void AlarmLinesService::_updateKnownLineIds()
+{
+    std::vector<uint32_t> ids;
+
+    beginTransaction();
+    _state.lines.ids(ids); // Sorted and unique by the store's ID index
+    endTransaction();
+
+    uint32_t count = std::min<size_t>(ids.size(), AlarmLineStore::CAPACITY);
+
+    taskENTER_CRITICAL(&_knownLineIdsLock);
+    uint32_t seq = _knownLineIdsSeq.load(std::memory_order_relaxed);
+    _knownLineIdsSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (uint32_t i = 0; i < count; i++)
+        _knownLineIds[i].store(ids[i], std::memory_order_relaxed);
+    _numKnownLineIds.store(count, std::memory_order_relaxed);
+    _knownLineIdsSeq.store(seq + 2, std::memory_order_release);
+    taskEXIT_CRITICAL(&_knownLineIdsLock);
+
+    ESP_LOGV(TAG, "Known alarm line IDs updated (%lu).", count);
+}
+
+bool AlarmLinesService::_alarmLineExists(uint32_t id)
+{
+    beginTransaction();
+    bool found = _state.lines.contains(id);
     endTransaction();
 
     return found;
@@ -409,6 +853,12 @@ esp_err_t AlarmLinesService::addAlarmLine(uint32_t id, String name, alarm_line_a
         return ESP_ERR_INVALID_ARG;
     }
 
+    if (isKnownAlarmLine(id)) // Fast path without locking
+    {
+        ESP_LOGV(TAG, "Alarm line with ID %lu already exists.", id);
+        return ESP_ERR_INVALID_STATE;
+    }
+
     if (name.length() > ALARMLINES_NAME_MAX_LENGTH)
     {
         ESP_LOGE(TAG, "Alarm line name is too long. Maximum length is %d.", ALARMLINES_NAME_MAX_LENGTH);
@@ -421,25 +871,42 @@ esp_err_t AlarmLinesService::addAlarmLine(uint32_t id, String name, alarm_line_a
         return ESP_ERR_INVALID_ARG;
     }
 
-    if (_alarmLineExists(id))
-    {
-        ESP_LOGV(TAG, "Alarm line with ID %lu already exists.", id);
-        return ESP_ERR_INVALID_STATE;
-    }
-
     genius_alarm_line_t newLine;
     newLine.id = id;
     newLine.name = name;
     newLine.created = time(nullptr);
     newLine.acquisition = acquisition;
 
+    // Existence check and insert in one transaction
+    esp_err_t err = ESP_OK;
     beginTransaction();
-    if (toFront)
-        _state.lines.insert(_state.lines.begin(), newLine);
+    if (_state.lines.contains(id))
+    {
+        err = ESP_ERR_INVALID_STATE;
+    }
+    else if (!_state.lines.insert(newLine, toFront))
+    {
+        err = ESP_ERR_NO_MEM;
+    }
     else
-        _state.lines.push_back(newLine);
+    {
+        _state.changes.clear();
+        _state.changes.added.push_back(id);
+    }
     endTransaction();
 
+    if (err == ESP_ERR_INVALID_STATE)
+    {
+        ESP_LOGV(TAG, "Alarm line with ID %lu already exists.", id);
+        return err;
+    }
+    if (err == ESP_ERR_NO_MEM)
+    {
+        // Debug level only, every packet of an unknown line ends up here while the store is full
+        ESP_LOGD(TAG, "Cannot add alarm line %lu, maximum number of alarm lines reached.", id);
+        return err;
+    }
+
     ESP_LOGI(TAG, "Added alarm line '%s' with id %lu", newLine.name.c_str(), newLine.id);
 
     callUpdateHandlers(ALARMLINES_ORIGIN_ID);
@@ -458,14 +925,173 @@ void AlarmLinesService::_emitNewAlarmLineEvent(uint32_t id)
     _eventSocket->emitEvent(ALARMLINES_EVENT_NEW_LINE, jsonRoot);
 }
 
-void AlarmLinesService::_emitActionFinishedEvent(bool timedOut)
+void AlarmLinesService::_emitLinesChangedEvent()
 {
+    beginTransaction();
+    AlarmLinesChangeSet changes = _state.changes;
+    endTransaction();
+
+    if (changes.empty())
+        return;
+
     JsonDocument jsonDoc;
     JsonObject jsonRoot = jsonDoc.to<JsonObject>();
-    jsonRoot["timedOut"] = timedOut;
+    JsonArray jsonAdded = jsonRoot["added"].to<JsonArray>();
+    for (uint32_t id : changes.added)
+        jsonAdded.add(id);
+    JsonArray jsonUpdated = jsonRoot["updated"].to<JsonArray>();
+    for (uint32_t id : changes.updated)
+        jsonUpdated.add(id);
+    JsonArray jsonRemoved = jsonRoot["removed"].to<JsonArray>();
+    for (uint32_t id : changes.removed)
+        jsonRemoved.add(id);
+    jsonRoot["reordered"] = changes.reordered;
+    _eventSocket->emitEvent(ALARMLINES_EVENT_LINES_CHANGED, jsonRoot);
+}
+
+void AlarmLinesService::_emitActionFinishedEvent(const alarm_lines_tx_stats_t &stats)
+{
+    JsonDocument jsonDoc;
+    JsonObject jsonRoot = jsonDoc.to<JsonObject>();
+    jsonRoot["timedOut"] = stats.timedOut;
+    jsonRoot["preempted"] = stats.preempted;
+    JsonObject jsonStats = jsonRoot["stats"].to<JsonObject>();
+    _txStatsToJson(stats, jsonStats);
     _eventSocket->emitEvent(ALARMLINES_EVENT_ACTION_FINISHED, jsonRoot);
 }
 
+void AlarmLinesService::_recordTxStats(const alarm_lines_tx_stats_t &stats)
+{
+    taskENTER_CRITICAL(&_txStatsLock);
+    _txStats[_txStatsWritten % ALARMLINES_TX_STATS_HISTORY_SIZE] = stats;
+    _txStatsWritten++;
+    taskEXIT_CRITICAL(&_txStatsLock);
+}
+
+void AlarmLinesService::_txStatsToJson(const alarm_lines_tx_stats_t &stats, JsonObject &json)
+{
+    char dateBuf[Utils::ISO8601_BUFFER_SIZE];
+    Utils::time_t_to_iso8601(stats.timestamp, dateBuf, sizeof(dateBuf));
+    json["timestamp"] = dateBuf;
+    json["action"] = stats.action;
+    json["lineId"] = stats.lineId;
+    json["numLines"] = stats.numLines;
+    json["numPackets"] = stats.numPackets;
+    json["numSent"] = stats.numSent;
+    json["timedOut"] = stats.timedOut;
+    json["preempted"] = stats.preempted;
+
+    JsonObject period = json["period"].to<JsonObject>();
+    period["target"] = stats.targetPeriodUs;
+    period["min"] = stats.periodMinUs;
+    period["mean"] = stats.periodMeanUs;
+    period["max"] = stats.periodMaxUs;
+    period["stddev"] = roundf(stats.periodStddevUs * 10.0f) / 10.0f;
+    json["missedDeadlines"] = stats.missedDeadlines;
+
+    const struct
+    {
+        const char *key;
+        const alarm_lines_tx_duration_stats_t &duration;
+    } durations[] = {{"fifoWrite", stats.fifoWrite},
+                     {"gdo0HighWait", stats.gdo0HighWait},
+                     {"gdo0LowWait", stats.gdo0LowWait}};
+    for (const auto &entry : durations)
+    {
+        JsonObject duration = json[entry.key].to<JsonObject>();
+        duration["min"] = entry.duration.min;
+        duration["mean"] = entry.duration.mean;
+        duration["max"] = entry.duration.max;
+    }
+
+    json["duration"] = stats.durationUs;
+    json["targetDuration"] = stats.targetDurationUs;
+    json["cpuLoad"] = roundf(stats.cpuLoad * 10.0f) / 10.0f;
+}
+
+esp_err_t AlarmLinesService::_handleGetTxStats(PsychicRequest *request)
+{
+    // Copy the ring, serialization must not run inside the critical section
+    std::vector<alarm_lines_tx_stats_t> snapshot(ALARMLINES_TX_STATS_HISTORY_SIZE);
+
+    taskENTER_CRITICAL(&_txStatsLock);
+    uint32_t written = _txStatsWritten;
+    memcpy(snapshot.data(), _txStats, sizeof(_txStats));
+    taskEXIT_CRITICAL(&_txStatsLock);
+
+    uint32_t count = std::min<uint32_t>(written, ALARMLINES_TX_STATS_HISTORY_SIZE);
+
+    PsychicJsonResponse response = PsychicJsonResponse(request, false);
+    JsonObject root = response.getRoot();
+    JsonArray transmissions = root["transmissions"].to<JsonArray>();
+
+    // Most recent transmission first
+    for (uint32_t i = 1; i <= count; i++)
+    {
+        JsonObject jsonStats = transmissions.add<JsonObject>();
+        _txStatsToJson(snapshot[(written - i) % ALARMLINES_TX_STATS_HISTORY_SIZE], jsonStats);
+    }
+
+    return response.send();
+}
+
+esp_err_t AlarmLinesService::_handleGetTxQueue(PsychicRequest *request)
+{
+    PsychicJsonResponse response = PsychicJsonResponse(request, false);
+    JsonObject root = response.getRoot();
+    JsonArray pending = root["pending"].to<JsonArray>();
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(_txQueueMutex, portMAX_DELAY);
+
+    root["transmitting"] = _isTransmitting;
+    for (const auto &queued : _txQueue)
+    {
+        JsonObject jsonQueued = pending.add<JsonObject>();
+        JsonArray jsonLineIds = jsonQueued["lineIds"].to<JsonArray>();
+        for (uint32_t lineId : queued.lineIds)
+            jsonLineIds.add(lineId);
+        jsonQueued["action"] = _actionName(queued.action);
+        jsonQueued["priority"] = _actionPriority(queued.action);
+        jsonQueued["waiting"] = static_cast<uint32_t>((now - queued.enqueuedUs) / 1000);
+    }
+
+    alarm_lines_tx_queue_stats_t stats = _txQueueStats;
+
+    xSemaphoreGive(_txQueueMutex);
+
+    xSemaphoreTake(_seqMutex, portMAX_DELAY);
+    alarm_lines_seq_stats_t seqStats = _seqStats;
+    uint8_t seqBound = _seqPersistedBound;
+    uint8_t seqCurrent = _packet_sequence_number;
+    xSemaphoreGive(_seqMutex);
+
+    JsonObject jsonStats = root["stats"].to<JsonObject>();
+    jsonStats["enqueued"] = stats.enqueued;
+    jsonStats["merged"] = stats.merged;
+    jsonStats["rejected"] = stats.rejected;
+    jsonStats["started"] = stats.started;
+    jsonStats["preempted"] = stats.preempted;
+    jsonStats["waitMin"] = stats.waitMinMs;
+    jsonStats["waitMean"] = stats.started > 0 ? static_cast<uint32_t>(stats.waitSumMs / stats.started) : 0;
+    jsonStats["waitMax"] = stats.waitMaxMs;
+    jsonStats["requests"] = stats.requests;
+    jsonStats["requestMin"] = stats.requestMinUs;
+    jsonStats["requestMean"] = stats.requests > 0 ? static_cast<uint32_t>(stats.requestSumUs / stats.requests) : 0;
+    jsonStats["requestMax"] = stats.requestMaxUs;
+
+    JsonObject jsonSeq = root["sequence"].to<JsonObject>();
+    jsonSeq["current"] = seqCurrent;
+    jsonSeq["reservedUntil"] = seqBound;
+    jsonSeq["nvsWrites"] = seqStats.nvsWrites;
+    jsonSeq["blockingWrites"] = seqStats.blockingWrites;
+    jsonSeq["writeLast"] = seqStats.writeLastUs;
+    jsonSeq["writeMean"] = seqStats.nvsWrites > 0 ? static_cast<uint32_t>(seqStats.writeSumUs / seqStats.nvsWrites) : 0;
+    jsonSeq["writeMax"] = seqStats.writeMaxUs;
+
+    return response.send();
+}
+
 esp_err_t AlarmLinesService::_removeAlarmLine(uint32_t id)
 {
     if (id == ALARMLINES_ID_NONE)
@@ -474,17 +1100,12 @@ esp_err_t AlarmLinesService::_removeAlarmLine(uint32_t id)
         return ESP_ERR_INVALID_ARG;
     }
 
-    bool removed = false;
-
     beginTransaction();
-    for (auto line = _state.lines.begin(); line != _state.lines.end(); ++line)
+    bool removed = _state.lines.remove(id);
+    if (removed)
     {
-        if (line->id == id)
-        {
-            _state.lines.erase(line);
-            removed = true;
-            break;
-        }
+        _state.changes.clear();
+        _state.changes.removed.push_back(id);
     }
     endTransaction();
 
@@ -501,36 +1122,73 @@ esp_err_t AlarmLinesService::_removeAlarmLine(uint32_t id)
     return ESP_OK;
 }
 
+void AlarmLinesService::loop()
+{
+    // Reserve the next block of sequence numbers before the TX task runs out of the current one
+    if (_seqRequestedBound != _seqPersistedBound &&
+        (_lastSeqCommitFailure == 0 || millis() - _lastSeqCommitFailure >= ALARMLINES_NVS_SEQ_RETRY_MS))
+    {
+        _lastSeqCommitFailure = savePcktSeqNum() == ESP_OK ? 0 : std::max<uint32_t>(millis(), 1);
+    }
+}
+
 uint8_t AlarmLinesService::incPcktSeqNum()
 {
     // Increment the sequence number (with rollover at 255)
-    _packet_sequence_number = (_packet_sequence_number + 1) % 256;
+    uint8_t next = _packet_sequence_number + 1;
 
-    // Persist to NVS
-    esp_err_t err = savePcktSeqNum();
-    if (err != ESP_OK)
+    // Request the next block from the background committer once half of the current block is used
+    if (static_cast<uint8_t>(_seqRequestedBound - next) <= ALARMLINES_NVS_SEQ_BLOCK / 2)
+    {
+        _seqRequestedBound = next + ALARMLINES_NVS_SEQ_BLOCK;
+        _sveltekit->runLoopTaskSoon(_seqCommitTask);
+    }
+
+    // Block exhausted before the background commit: persist now, a number must never be used before it is reserved
+    if (next == _seqPersistedBound)
     {
-        ESP_LOGE(TAG, "Failed to persist incremented packet sequence number: %s", esp_err_to_name(err));
-        // Continue anyway, the in-memory value is still incremented
+        esp_err_t err = savePcktSeqNum(true);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to reserve packet sequence numbers: %s", esp_err_to_name(err));
+            // Continue anyway, the in-memory value is still incremented
+        }
     }
 
+    _packet_sequence_number = next;
+
     return _packet_sequence_number;
 }
 
-esp_err_t AlarmLinesService::savePcktSeqNum()
+esp_err_t AlarmLinesService::savePcktSeqNum(bool blocking)
 {
+    xSemaphoreTake(_seqMutex, portMAX_DELAY);
+
+    // Bound only grows, a concurrent commit may already have persisted it
+    uint8_t bound = _seqRequestedBound;
+    if (bound == _seqPersistedBound)
+    {
+        xSemaphoreGive(_seqMutex);
+        return ESP_OK;
+    }
+
+    if (blocking)
+        _seqStats.blockingWrites++;
+
+    int64_t start = esp_timer_get_time();
+
     // Persist to NVS
     nvs_handle_t nvs_handle;
     esp_err_t err = nvs_open(ALARMLINES_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (err == ESP_OK)
     {
-        err = nvs_set_u8(nvs_handle, ALARMLINES_NVS_SEQ_KEY, _packet_sequence_number);
+        err = nvs_set_u8(nvs_handle, ALARMLINES_NVS_SEQ_BOUND_KEY, bound);
         if (err == ESP_OK)
         {
             err = nvs_commit(nvs_handle);
             if (err == ESP_OK)
             {
-                ESP_LOGV(TAG, "Persisted packet sequence number %u to NVS.", _packet_sequence_number);
+                ESP_LOGV(TAG, "Reserved packet sequence numbers up to %u in NVS.", bound);
             }
             else
             {
@@ -548,34 +1206,46 @@ esp_err_t AlarmLinesService::savePcktSeqNum()
         ESP_LOGE(TAG, "Failed to open NVS handle for packet sequence number: %s", esp_err_to_name(err));
     }
 
+    uint32_t durationUs = esp_timer_get_time() - start;
+    _seqStats.nvsWrites++;
+    _seqStats.writeLastUs = durationUs;
+    _seqStats.writeMaxUs = std::max(_seqStats.writeMaxUs, durationUs);
+    _seqStats.writeSumUs += durationUs;
+
+    if (err == ESP_OK)
+        _seqPersistedBound = bound;
+
+    xSemaphoreGive(_seqMutex);
+
     return err;
 }
 
 esp_err_t AlarmLinesService::loadPcktSeqNum()
 {
+    // Continue at the end of the block reserved before the reboot, numbers of that block may have been used
+    uint8_t start = ALARMLINES_NVS_SEQ_DEFAULT;
+
     nvs_handle_t nvs_handle;
     esp_err_t err = nvs_open(ALARMLINES_NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
     if (err == ESP_OK)
     {
-        err = nvs_get_u8(nvs_handle, ALARMLINES_NVS_SEQ_KEY, &_packet_sequence_number);
+        uint8_t value;
+        err = nvs_get_u8(nvs_handle, ALARMLINES_NVS_SEQ_BOUND_KEY, &value);
         if (err == ESP_OK)
         {
-            ESP_LOGI(TAG, "Loaded packet sequence number from NVS: %u", _packet_sequence_number);
+            start = value;
+            ESP_LOGI(TAG, "Loaded reserved packet sequence number block end from NVS: %u", value);
+        }
+        else if (err == ESP_ERR_NVS_NOT_FOUND && nvs_get_u8(nvs_handle, ALARMLINES_NVS_SEQ_KEY, &value) == ESP_OK) // Upgrade: last used number
+        {
+            start = value + 1;
+            err = ESP_OK;
+            ESP_LOGI(TAG, "Loaded last packet sequence number from NVS: %u", value);
         }
         else if (err == ESP_ERR_NVS_NOT_FOUND) // First time - initialize to default value
         {
-            ESP_LOGI(TAG, "Packet sequence number not found in NVS, creating and initializing it to %u.", ALARMLINES_NVS_SEQ_DEFAULT);
-            _packet_sequence_number = ALARMLINES_NVS_SEQ_DEFAULT;
-            esp_err_t save_err = savePcktSeqNum();
-            if (save_err != ESP_OK)
-            {
-                ESP_LOGE(TAG, "Failed to save initial packet sequence number: %s", esp_err_to_name(save_err));
-                err = save_err;
-            }
-            else
-            {
-                err = ESP_OK;
-            }
+            err = ESP_OK;
+            ESP_LOGI(TAG, "Packet sequence number not found in NVS, initializing it to %u.", ALARMLINES_NVS_SEQ_DEFAULT);
         }
         else // Any other error
         {
@@ -584,25 +1254,294 @@ esp_err_t AlarmLinesService::loadPcktSeqNum()
 
         nvs_close(nvs_handle);
     }
-    else if (err == ESP_ERR_NVS_NOT_FOUND) // NVS namespace not found, create it
+    else if (err == ESP_ERR_NVS_NOT_FOUND) // NVS namespace not found, will be created by the first reservation
+    {
+        err = ESP_OK;
+        ESP_LOGI(TAG, "NVS namespace '%s' not found, initializing packet sequence number to %u.", ALARMLINES_NVS_NAMESPACE, ALARMLINES_NVS_SEQ_DEFAULT);
+    }
+    else // Any other error
+    {
+        ESP_LOGE(TAG, "Failed to open NVS handle for reading packet sequence number: %s.", esp_err_to_name(err));
+    }
+
+    _packet_sequence_number = start - 1;
+    _seqPersistedBound = start;
+
+    // Reserve the first block synchronously, nothing is sent before begin() finished
+    _seqRequestedBound = start + ALARMLINES_NVS_SEQ_BLOCK;
+    esp_err_t saveErr = savePcktSeqNum();
+
+    return err != ESP_OK ? err : saveErr;
+}
+
+AlarmLineStore::AlarmLineStore() : _namesGarbage(0)
+{
+    // Allocate once, inserts never reallocate up to the capacity
+    _slots.reserve(CAPACITY);
+    _freeSlots.reserve(CAPACITY);
+    _byId.reserve(CAPACITY);
+    _order.reserve(CAPACITY);
+}
+
+size_t AlarmLineStore::_lowerBound(uint32_t id) const
+{
+    size_t low = 0;
+    size_t high = _byId.size();
+    while (low < high)
+    {
+        size_t mid = (low + high) / 2;
+        if (_slots[_byId[mid]].id < id)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+const alarm_line_record_t *AlarmLineStore::find(uint32_t id) const
+{
+    size_t pos = _lowerBound(id);
+    if (pos < _byId.size() && _slots[_byId[pos]].id == id)
+        return &_slots[_byId[pos]];
+    return nullptr;
+}
+
+void AlarmLineStore::ids(std::vector<uint32_t> &ids) const
+{
+    ids.clear();
+    ids.reserve(_byId.size());
+    for (uint16_t slot : _byId)
+        ids.push_back(_slots[slot].id);
+}
+
+bool AlarmLineStore::insert(const genius_alarm_line_t &line, bool toFront)
+{
+    if (full())
+        return false;
+
+    size_t pos = _lowerBound(line.id);
+    if (pos < _byId.size() && _slots[_byId[pos]].id == line.id)
+        return false;
+
+    uint16_t slot;
+    if (!_freeSlots.empty())
+    {
+        slot = _freeSlots.back();
+        _freeSlots.pop_back();
+    }
+    else
     {
-        _packet_sequence_number = ALARMLINES_NVS_SEQ_DEFAULT;
-        ESP_LOGI(TAG, "NVS namespace '%s' not found, creating and initializing packet sequence number to %u.", ALARMLINES_NVS_NAMESPACE, ALARMLINES_NVS_SEQ_DEFAULT);
-        esp_err_t save_err = savePcktSeqNum();
-        if (save_err != ESP_OK)
+        slot = _slots.size();
+        _slots.emplace_back();
+    }
+
+    alarm_line_record_t &record = _slots[slot];
+    record.id = line.id;
+    record.created = line.created;
+    record.acquisition = line.acquisition;
+    _storeName(record, line.name);
+
+    _byId.insert(_byId.begin() + pos, slot);
+    if (toFront)
+        _order.insert(_order.begin(), slot);
+    else
+        _order.push_back(slot);
+
+    return true;
+}
+
+bool AlarmLineStore::remove(uint32_t id)
+{
+    size_t pos = _lowerBound(id);
+    if (pos >= _byId.size() || _slots[_byId[pos]].id != id)
+        return false;
+
+    uint16_t slot = _byId[pos];
+    _byId.erase(_byId.begin() + pos);
+    _order.erase(std::find(_order.begin(), _order.end(), slot));
+    _freeSlots.push_back(slot);
+    _releaseName(_slots[slot]);
+
+    return true;
+}
+
+bool AlarmLineStore::assign(const genius_alarm_line_t &line)
+{
+    size_t pos = _lowerBound(line.id);
+    if (pos >= _byId.size() || _slots[_byId[pos]].id != line.id)
+        return false;
+
+    alarm_line_record_t &record = _slots[_byId[pos]];
+    bool changed = false;
+
+    if (record.created != line.created || record.acquisition != line.acquisition)
+    {
+        record.created = line.created;
+        record.acquisition = line.acquisition;
+        changed = true;
+    }
+
+    size_t nameLength = std::min<size_t>(line.name.length(), ALARMLINES_NAME_MAX_LENGTH);
+    if (record.nameLength != nameLength || memcmp(name(record), line.name.c_str(), nameLength) != 0)
+    {
+        // Release the old name only after storing the new one, a compaction keeps the names referenced by records
+        alarm_line_record_t oldName = record;
+        _storeName(record, line.name);
+        _releaseName(oldName);
+        changed = true;
+    }
+
+    return changed;
+}
+
+bool AlarmLineStore::reorder(const std::vector<uint32_t> &ids)
+{
+    if (ids.size() != _order.size())
+        return false;
+
+    bool changed = false;
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        size_t pos = _lowerBound(ids[i]);
+        if (pos >= _byId.size() || _slots[_byId[pos]].id != ids[i])
+            return false; // Unknown ID, keep the current order
+
+        if (_order[i] != _byId[pos])
+            changed = true;
+    }
+
+    if (!changed)
+        return false;
+
+    for (size_t i = 0; i < ids.size(); i++)
+        _order[i] = _byId[_lowerBound(ids[i])];
+
+    return true;
+}
+
+void AlarmLineStore::_storeName(alarm_line_record_t &record, const String &name)
+{
+    size_t length = std::min<size_t>(name.length(), ALARMLINES_NAME_MAX_LENGTH);
+    record.nameOffset = _names.size();
+    record.nameLength = length;
+    _names.insert(_names.end(), name.c_str(), name.c_str() + length);
+    _names.push_back('\0');
+}
+
+void AlarmLineStore::_releaseName(const alarm_line_record_t &record)
+{
+    _namesGarbage += record.nameLength + 1;
+    if (_namesGarbage > _names.size() - _namesGarbage)
+        _compactNames();
+}
+
+void AlarmLineStore::_compactNames()
+{
+    std::vector<char> names;
+    names.reserve(_names.size() - _namesGarbage);
+    for (uint16_t slot : _byId)
+    {
+        alarm_line_record_t &record = _slots[slot];
+        const char *name = &_names[record.nameOffset];
+        record.nameOffset = names.size();
+        names.insert(names.end(), name, name + record.nameLength + 1);
+    }
+
+    _names.swap(names);
+    _namesGarbage = 0;
+}
+
+StateUpdateResult AlarmLines::update(JsonObject &root, AlarmLines &alarmLines)
+{
+    if (!root["lines"].is<JsonArray>())
+    {
+        ESP_LOGV(AlarmLines::TAG, "No lines array in JSON, no changes made.");
+        return StateUpdateResult::UNCHANGED;
+    }
+
+    JsonArray jsonLines = root["lines"].as<JsonArray>();
+
+    // Validate all lines first, an invalid configuration leaves the store untouched
+    std::vector<genius_alarm_line_t> newLines;
+    std::vector<uint32_t> newIds; // Sorted, for duplicate detection
+    newLines.reserve(std::min(jsonLines.size(), AlarmLineStore::CAPACITY));
+    newIds.reserve(newLines.capacity());
+    for (JsonVariant jsonLineArrItem : jsonLines)
+    {
+        if (newLines.size() >= AlarmLineStore::CAPACITY)
+        {
+            ESP_LOGE(AlarmLines::TAG, "Too many alarm lines. Maximum allowed is %d.", ALARMLINES_MAX_NUM);
+            break;
+        }
+
+        JsonObject jsonLine = jsonLineArrItem.as<JsonObject>();
+        if (!jsonLine["id"].is<uint32_t>() ||
+            !jsonLine["name"].is<String>() ||
+            !jsonLine["created"].is<String>() ||
+            !jsonLine["acquisition"].is<alarm_line_acquisition_t>())
         {
-            ESP_LOGE(TAG, "Failed to create NVS namespace and save initial packet sequence number: %s", esp_err_to_name(save_err));
-            err = save_err;
+            ESP_LOGE(AlarmLines::TAG, "Invalid alarm line configuration.");
+            return StateUpdateResult::ERROR;
         }
-        else
+
+        genius_alarm_line_t newLine;
+        newLine.id = jsonLine["id"].as<uint32_t>();
+
+        auto idPos = std::lower_bound(newIds.begin(), newIds.end(), newLine.id);
+        if (idPos != newIds.end() && *idPos == newLine.id)
         {
-            err = ESP_OK;
+            ESP_LOGW(AlarmLines::TAG, "Duplicate alarm line ID %lu in lines list, ignoring duplicate.", newLine.id);
+            continue;
         }
+        newIds.insert(idPos, newLine.id);
+
+        newLine.name = jsonLine["name"].as<String>();
+        if (newLine.name.length() > ALARMLINES_NAME_MAX_LENGTH)
+            ESP_LOGW(AlarmLines::TAG, "Name of alarm line %lu is too long, truncated to %d characters.", newLine.id, ALARMLINES_NAME_MAX_LENGTH);
+        newLine.created = Utils::iso8601_to_time_t(jsonLine["created"].as<const char *>());
+        newLine.acquisition = jsonLine["acquisition"].as<alarm_line_acquisition_t>();
+
+        newLines.push_back(std::move(newLine));
     }
-    else // Any other error
+
+    AlarmLineStore &store = alarmLines.lines;
+    AlarmLinesChangeSet &changes = alarmLines.changes;
+    changes.clear();
+
+    // Remove lines no longer present first, so their slots are free for added ones
+    std::vector<uint32_t> existingIds;
+    store.ids(existingIds);
+    for (uint32_t id : existingIds)
     {
-        ESP_LOGE(TAG, "Failed to open NVS handle for reading packet sequence number: %s.", esp_err_to_name(err));
+        if (!std::binary_search(newIds.begin(), newIds.end(), id))
+        {
+            store.remove(id);
+            changes.removed.push_back(id);
+        }
     }
 
-    return err;
+    // Add new lines at the end, update existing ones in place
+    std::vector<uint32_t> order;
+    order.reserve(newLines.size());
+    for (const auto &line : newLines)
+    {
+        if (!store.contains(line.id))
+        {
+            store.insert(line);
+            changes.added.push_back(line.id);
+        }
+        else if (store.assign(line))
+        {
+            changes.updated.push_back(line.id);
+        }
+        order.push_back(line.id);
+    }
+
+    // Apply the order of the JSON lines
+    changes.reordered = store.reorder(order);
+
+    ESP_LOGV(AlarmLines::TAG, "Alarm lines configurations updated (added: %u, updated: %u, removed: %u, reordered: %s).",
+             changes.added.size(), changes.updated.size(), changes.removed.size(), changes.reordered ? "yes" : "no");
+
+    return changes.empty() ? StateUpdateResult::UNCHANGED : StateUpdateResult::CHANGED;
 }
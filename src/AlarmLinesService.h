@@ -41,10 +41,16 @@
 #include <cc1101.h>
 #include <nvs_flash.h>
 #include <nvs.h>
+#include <driver/gptimer.h>
+#include <vector>
+#include <deque>
+#include <atomic>
 
 #define ALARMLINES_FILE "/config/alarm-lines.json"            ///< Configuration file path
 #define ALARMLINES_SERVICE_PATH "/rest/alarm-lines"           ///< HTTP REST API service endpoint
 #define ALARMLINES_PATH_ACTIONS ALARMLINES_SERVICE_PATH "/do" ///< HTTP endpoint for actions
+#define ALARMLINES_PATH_TX_STATS ALARMLINES_SERVICE_PATH "/tx-stats" ///< HTTP endpoint for transmission timing statistics
+#define ALARMLINES_PATH_TX_QUEUE ALARMLINES_SERVICE_PATH "/tx-queue" ///< HTTP endpoint for pending actions and scheduler statistics
 #define ALARMLINES_ID_BROADCAST 0xFFFFFFFF                    ///< Broadcast alarm line ID (all lines)
 #define ALARMLINES_ID_NONE 0x00000000                         ///< No alarm line ID (unassigned)
 #define ALARMLINES_MAX_NUM 100                                ///< Maximum number of alarm lines supported
@@ -55,8 +61,11 @@
 #define ALARMLINES_TX_TASK_PRIORITY 20                        ///< Priority level for transmission task
 #define ALARMLINES_TX_TASK_NAME "alarmlines-tx"               ///< Name identifier for transmission task
 #define ALARMLINES_TX_TASK_CORE_AFFINITY 1                    ///< CPU core affinity for transmission task (0 or 1)
-#define ALARMLINES_TX_PERIOD_TIMER_NAME "alarmlines-tx-timer" ///< Timer name for transmission period timing
+#define ALARMLINES_TX_TIMER_RESOLUTION_HZ 1000000             ///< Resolution of the hardware timer pacing the packets (1 us)
 #define ALARMLINES_TX_TIMEOUT_MS 10000LU                      ///< Transmission timeout in milliseconds (10 seconds)
+#define ALARMLINES_TX_STATS_HISTORY_SIZE 16                   ///< Number of transmissions kept in the timing statistics
+#define ALARMLINES_TX_QUEUE_SIZE 8                            ///< Maximum number of pending actions
+#define ALARMLINES_TX_DEADLINE_TOLERANCE_US 500               ///< Packet start later than its slot by more than this counts as missed deadline
 
 /// Task notification array index for transmission task (must be < CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES)
 #define ALARMLINES_TX_TASK_NOTIFICATION_INDEX 0
@@ -69,20 +78,29 @@
 #define ALARMLINES_LINETEST_FIRST_PCKTCNT 0x18CC ///< First packet count value for line test sequence
 #define ALARMLINES_LINETEST_LAST_PCKTCNT 0x0002  ///< Last packet count value for line test sequence
 
-#define ALARMLINES_LINETEST_PCKTCNT_STEP (float)(ALARMLINES_LINETEST_FIRST_PCKTCNT - ALARMLINES_LINETEST_LAST_PCKTCNT) / (float)(ALARMLINES_TX_NUM_REPEAT_LINETEST - 1)  ///< Packet count step size calculation for line test
-
 #define ALARMLINES_TX_PERIOD_FIREALARM_US 9855  ///< Transmission period for fire alarm packets in microseconds (9.855 ms)
 #define ALARMLINES_TX_NUM_REPEAT_FIREALARM 315  ///< Number of fire alarm packet repetitions
 #define ALARMLINES_FIREALARM_FIRST_PCKTCNT 0x18CC  ///< First packet count value for fire alarm sequence
 #define ALARMLINES_FIREALARM_LAST_PCKTCNT 0x000A  ///< Last packet count value for fire alarm sequence
-#define ALARMLINES_FIREALARM_PCKTCNT_STEP (float)(ALARMLINES_FIREALARM_FIRST_PCKTCNT - ALARMLINES_FIREALARM_LAST_PCKTCNT) / (float)(ALARMLINES_TX_NUM_REPEAT_FIREALARM - 1)  ///< Packet count step size calculation for fire alarm
+
+#define ALARMLINES_RF_BYTE_DURATION_NS 208360 ///< Air time of one byte at 38.383 kBaud
+#define ALARMLINES_RF_OVERHEAD_BYTES 9        ///< Bytes sent in addition to the payload (preamble 4, sync 2, length 1, CRC 2)
+#define ALARMLINES_TX_SLOT_GUARD_US 200       ///< Guard time per packet slot (FIFO write, TX settling)
+
+#define ALARMLINES_PACKET_POS_COUNTER 1  ///< Position of the packet counter (2 bytes, little-endian)
+#define ALARMLINES_PACKET_POS_LINE_ID 18 ///< Position of the alarm line ID (4 bytes, network byte order)
+#define ALARMLINES_PACKET_POS_SEQ_NUM 23 ///< Position of the packet sequence number
 
 #define ALARMLINES_EVENT_NEW_LINE "new-alarm-line"  ///< WebSocket event for new alarm line discovery
 #define ALARMLINES_EVENT_ACTION_FINISHED "alarm-line-action-finished"  ///< WebSocket event for action completion notification
+#define ALARMLINES_EVENT_LINES_CHANGED "alarm-lines-changed"  ///< WebSocket event for per-line changes of the configuration
 
 #define ALARMLINES_NVS_NAMESPACE "gg-alarmlines"  ///< NVS namespace for alarm lines data storage
-#define ALARMLINES_NVS_SEQ_KEY "pkt_seq_num"  ///< NVS key for packet sequence number storage
+#define ALARMLINES_NVS_SEQ_KEY "pkt_seq_num"  ///< NVS key of the last used packet sequence number (legacy, read on upgrade only)
+#define ALARMLINES_NVS_SEQ_BOUND_KEY "pkt_seq_bound"  ///< NVS key of the end of the reserved sequence number block
 #define ALARMLINES_NVS_SEQ_DEFAULT 0  ///< Default packet sequence number value
+#define ALARMLINES_NVS_SEQ_BLOCK 16  ///< Sequence numbers reserved per NVS write (skipped on reboot at most)
+#define ALARMLINES_NVS_SEQ_RETRY_MS 1000  ///< Delay before retrying a failed background commit
 
 /// Enumeration for alarm line acquisition methods
 typedef enum alarm_line_acquisition
@@ -103,77 +121,227 @@ typedef struct genius_alarm_line
     alarm_line_acquisition_t acquisition; ///< How this line was discovered/added
 } genius_alarm_line_t;
 
+/// Actions that can be performed on an alarm line
+typedef enum alarm_lines_action
+{
+    ALACT_LINE_TEST_START = 0, ///< Start line test
+    ALACT_LINE_TEST_STOP,      ///< Stop line test
+    ALACT_FIRE_ALARM_START,    ///< Start fire alarm
+    ALACT_FIRE_ALARM_STOP      ///< Stop fire alarm
+} alarm_lines_action_t;
+
+/// Pending action in the TX queue
+typedef struct alarm_lines_tx_request
+{
+    std::vector<uint32_t> lineIds; ///< Target alarm line IDs (host byte order), more than one for batch actions
+    alarm_lines_action_t action;   ///< Requested action
+    int64_t enqueuedUs;            ///< Time of the request (us since boot)
+    bool started;                  ///< Partly transmitted before (preempted or remaining lines of a batch)
+} alarm_lines_tx_request_t;
+
+/// Statistics of the packet sequence number persistence
+typedef struct alarm_lines_seq_stats
+{
+    uint32_t nvsWrites;      ///< Number of NVS writes (reserved blocks)
+    uint32_t blockingWrites; ///< NVS writes the TX task had to wait for (block exhausted before the background commit)
+    uint32_t writeLastUs;    ///< Duration of the last NVS write
+    uint32_t writeMaxUs;     ///< Maximum duration of an NVS write
+    uint64_t writeSumUs;     ///< Sum of NVS write durations (for the mean)
+} alarm_lines_seq_stats_t;
+
+/// Statistics of the TX action scheduler
+typedef struct alarm_lines_tx_queue_stats
+{
+    uint32_t enqueued;  ///< Actions accepted into the queue
+    uint32_t merged;    ///< Actions merged into a pending action of the same line
+    uint32_t rejected;  ///< Actions rejected because the queue was full
+    uint32_t started;   ///< Actions taken from the queue for transmission
+    uint32_t preempted; ///< Transmissions interrupted by a higher priority action
+    uint32_t waitMinMs; ///< Minimum queue wait time
+    uint32_t waitMaxMs; ///< Maximum queue wait time
+    uint64_t waitSumMs; ///< Sum of queue wait times (for the mean)
+    uint32_t requests;     ///< Handled action requests
+    uint32_t requestMinUs; ///< Minimum processing time of an action request
+    uint32_t requestMaxUs; ///< Maximum processing time of an action request
+    uint64_t requestSumUs; ///< Sum of action request processing times (for the mean)
+} alarm_lines_tx_queue_stats_t;
+
+/// Precomputed packet train of an action: all repetitions including their packet counters
+typedef struct alarm_lines_tx_train
+{
+    std::vector<uint8_t> packets; ///< Packets back to back, numPackets * packetLength bytes
+    size_t packetLength;          ///< Length of a single packet
+    uint32_t numPackets;          ///< Number of packets (repetitions of all lines)
+    uint32_t periodUs;            ///< Period between two packets in microseconds (protocol period / numLines)
+    uint32_t lineId;              ///< Target alarm line ID (host byte order), first line for interleaved trains
+    uint32_t numLines;            ///< Number of lines interleaved in the train
+    const char *action;           ///< Requested action (static string)
+} alarm_lines_tx_train_t;
+
+/// Min/mean/max of a duration measured per packet, in microseconds
+typedef struct alarm_lines_tx_duration_stats
+{
+    uint32_t min;  ///< Minimum duration
+    uint32_t mean; ///< Mean duration
+    uint32_t max;  ///< Maximum duration
+} alarm_lines_tx_duration_stats_t;
+
+/// Timing statistics of a single packet train transmission
+typedef struct alarm_lines_tx_stats
+{
+    time_t timestamp;                                ///< Start of the transmission (Unix epoch)
+    const char *action;                              ///< Performed action (static string)
+    uint32_t lineId;                                 ///< Target alarm line ID (first one for interleaved trains)
+    uint32_t numLines;                               ///< Number of lines interleaved in the train
+    uint32_t numPackets;                             ///< Number of packets of the train
+    uint32_t numSent;                                ///< Number of packets actually sent
+    bool timedOut;                                   ///< Transmission was cancelled by timeout
+    bool preempted;                                  ///< Transmission was interrupted by a higher priority action
+    uint32_t targetPeriodUs;                         ///< Protocol packet period
+    uint32_t periodMinUs;                            ///< Minimum period between two packet starts
+    uint32_t periodMeanUs;                           ///< Mean period between two packet starts
+    uint32_t periodMaxUs;                            ///< Maximum period between two packet starts
+    float periodStddevUs;                            ///< Standard deviation of the period
+    uint32_t missedDeadlines;                        ///< Packets started later than their slot (+ tolerance)
+    alarm_lines_tx_duration_stats_t fifoWrite;       ///< Duration of the TX FIFO write
+    alarm_lines_tx_duration_stats_t gdo0HighWait;    ///< Wait for GDO0 high (sync word sent)
+    alarm_lines_tx_duration_stats_t gdo0LowWait;     ///< Wait for GDO0 low (packet sent)
+    uint32_t durationUs;                             ///< Total duration of the train
+    uint32_t targetDurationUs;                       ///< Protocol duration of the train ((numPackets - 1) * period)
+    float cpuLoad;                                   ///< Share of the train duration the TX task was busy sending (percent)
+} alarm_lines_tx_stats_t;
+
+/// Alarm line entry of the indexed store, the name is kept in the store's name arena
+typedef struct alarm_line_record
+{
+    uint32_t id;                          ///< Unique alarm line ID (0xFFFFFFFF = broadcast, 0x00000000 = none)
+    time_t created;                       ///< Creation timestamp (Unix epoch)
+    alarm_line_acquisition_t acquisition; ///< How this line was discovered/added
+    uint16_t nameOffset;                  ///< Offset of the NUL-terminated name in the name arena
+    uint16_t nameLength;                  ///< Length of the name (without NUL)
+} alarm_line_record_t;
+
+/// Per-line changes caused by the most recent state update
+struct AlarmLinesChangeSet
+{
+    std::vector<uint32_t> added;   ///< IDs of lines added
+    std::vector<uint32_t> updated; ///< IDs of existing lines whose name, creation time or acquisition changed
+    std::vector<uint32_t> removed; ///< IDs of lines removed
+    bool reordered = false;        ///< Whether the display order changed (beyond lines appended at the end)
+
+    void clear()
+    {
+        added.clear();
+        updated.clear();
+        removed.clear();
+        reordered = false;
+    }
+
+    bool empty() const
+    {
+        return added.empty() && updated.empty() && removed.empty() && !reordered;
+    }
+};
+
+/**
+ * Indexed store of alarm lines
+ *
+ * Records live in stable slots, referenced by an index sorted by line ID (binary search) and by the display order.
+ * Inserting at the front or removing a line only moves 16 bit slot numbers. Names are stored back to back in a
+ * string arena, which is compacted once replaced or removed names take more space than the names in use.
+ */
+class AlarmLineStore
+{
+public:
+    static constexpr size_t CAPACITY = ALARMLINES_MAX_NUM + 1; ///< Maximum number of lines (configurable lines plus broadcast line)
+
+    AlarmLineStore();
+
+    /// Number of stored lines
+    size_t size() const { return _order.size(); }
+
+    /// Check if no further line can be inserted
+    bool full() const { return _order.size() >= CAPACITY; }
+
+    /// Find a line by its ID, nullptr if unknown
+    const alarm_line_record_t *find(uint32_t id) const;
+
+    /// Check if a line is stored
+    bool contains(uint32_t id) const { return find(id) != nullptr; }
+
+    /// Line at a position of the display order
+    const alarm_line_record_t &at(size_t position) const { return _slots[_order[position]]; }
+
+    /// Name of a line (valid until the next modification of the store)
+    const char *name(const alarm_line_record_t &record) const { return &_names[record.nameOffset]; }
+
+    /// Get the IDs of all lines, sorted ascending
+    void ids(std::vector<uint32_t> &ids) const;
+
+    /// Insert a new line at the end (or front) of the display order, false if the ID exists or the store is full
+    bool insert(const genius_alarm_line_t &line, bool toFront = false);
+
+    /// Remove a line, false if unknown
+    bool remove(uint32_t id);
+
+    /// Update name, creation time and acquisition of an existing line, returns true if anything changed
+    bool assign(const genius_alarm_line_t &line);
+
+    /// Set the display order to the given IDs (exactly the stored ones), returns true if the order changed
+    bool reorder(const std::vector<uint32_t> &ids);
+
+private:
+    std::vector<alarm_line_record_t> _slots; ///< Records, addressed by slot number
+    std::vector<uint16_t> _freeSlots;        ///< Slots of removed lines, reused first
+    std::vector<uint16_t> _byId;             ///< Slots sorted by line ID
+    std::vector<uint16_t> _order;            ///< Slots in display order
+    std::vector<char> _names;                ///< Name arena
+    size_t _namesGarbage;                    ///< Bytes of replaced or removed names in the arena
+
+    static_assert(2 * CAPACITY * (ALARMLINES_NAME_MAX_LENGTH + 1) < UINT16_MAX, "Name arena offsets exceed 16 bit");
+
+    /// Position of the first slot in the ID index with an ID not less than the given one
+    size_t _lowerBound(uint32_t id) const;
+
+    /// Append a name to the arena (truncated to the maximum length) and set offset and length of the record
+    void _storeName(alarm_line_record_t &record, const String &name);
+
+    /// Release the name of a record, compacting the arena when it is mostly garbage
+    void _releaseName(const alarm_line_record_t &record);
+
+    /// Move all names in use to the start of the arena
+    void _compactNames();
+};
+
 /// Data model class for managing alarm line collections
 class AlarmLines
 {
 public:
     static constexpr const char *TAG = "AlarmLines"; ///< Logging tag
-    std::vector<genius_alarm_line_t> lines;          ///< Vector containing all managed alarm lines
+    AlarmLineStore lines;                            ///< All managed alarm lines
+    AlarmLinesChangeSet changes;                     ///< Changes caused by the most recent update
 
     /// Deserialize alarm lines from JSON object
     static void read(AlarmLines &alarmLines, JsonObject &root)
     {
         JsonArray jsonDevices = root["lines"].to<JsonArray>();
-        for (auto &line : alarmLines.lines)
+        char dateBuf[Utils::ISO8601_BUFFER_SIZE];
+        for (size_t i = 0; i < alarmLines.lines.size(); i++)
         {
+            const alarm_line_record_t &line = alarmLines.lines.at(i);
             JsonObject jsonLine = jsonDevices.add<JsonObject>();
             jsonLine["id"] = line.id;
-            jsonLine["name"] = line.name;
-            jsonLine["created"] = Utils::time_t_to_iso8601(line.created);
+            jsonLine["name"] = alarmLines.lines.name(line);
+            Utils::time_t_to_iso8601(line.created, dateBuf, sizeof(dateBuf));
+            jsonLine["created"] = dateBuf;
             jsonLine["acquisition"] = line.acquisition;
         }
 
         ESP_LOGV(AlarmLines::TAG, "Alarm lines configurations read.");
     }
 
-    /// Update alarm lines from JSON object
-    static StateUpdateResult update(JsonObject &root, AlarmLines &alarmLines)
-    {
-        if (root["lines"].is<JsonArray>())
-        {
-            alarmLines.lines.clear();
-
-            // iterate over devices
-            int i = 0;
-            for (JsonVariant jsonLineArrItem : root["lines"].as<JsonArray>())
-            {
-                if (i++ >= ALARMLINES_MAX_NUM)
-                {
-                    ESP_LOGE(AlarmLines::TAG, "Too many alarm lines. Maximum allowed is %d.", ALARMLINES_MAX_NUM);
-                    break;
-                }
-
-                JsonObject jsonLine = jsonLineArrItem.as<JsonObject>();
-                if (!jsonLine["id"].is<uint32_t>() ||
-                    !jsonLine["name"].is<String>() ||
-                    !jsonLine["created"].is<String>() ||
-                    !jsonLine["acquisition"].is<alarm_line_acquisition_t>())
-                {
-                    ESP_LOGE(AlarmLines::TAG, "Invalid alarm line configuration.");
-                    return StateUpdateResult::ERROR;
-                }
-
-                genius_alarm_line_t newLine;
-
-                newLine.id = jsonLine["id"].as<uint32_t>();
-                newLine.name = jsonLine["name"].as<String>();
-                newLine.created = Utils::iso8601_to_time_t(jsonLine["created"].as<String>());
-                newLine.acquisition = jsonLine["acquisition"].as<alarm_line_acquisition_t>();
-
-                alarmLines.lines.push_back(newLine);
-
-                ESP_LOGV(AlarmLines::TAG, "Added alarm line: %s", newLine.name.c_str());
-
-                i++;
-            }
-        }
-
-        ESP_LOGV(AlarmLines::TAG, "AlarmLines configurations updated.");
-
-        return StateUpdateResult::CHANGED;
-    }
-
-private:
+    /// Update alarm lines from JSON object, applying the differences to the store
+    static StateUpdateResult update(JsonObject &root, AlarmLines &alarmLines);
 };
 
 /// Service class for managing alarm lines and RF transmission
@@ -187,22 +355,28 @@ public:
     /// Initialize the alarm lines service
     void begin();
 
+    /// Commit reserved packet sequence number blocks in the background (run when a block is requested, retried periodically)
+    void loop();
+
+    /// Check if an alarm line is known, lock-free and without allocation (false negatives possible while lines are updated)
+    bool isKnownAlarmLine(uint32_t id) const;
+
     /// Add a new alarm line to the system
     esp_err_t addAlarmLine(uint32_t id, String name, alarm_line_acquisition_t acquisition = ALA_GENIUS_PACKET, bool toFront = false);
 
-    /// Increment packet sequence number and persist it
+    /// Increment packet sequence number, reserving the next block in the background when the current one runs low
     uint8_t incPcktSeqNum();
 
-    /// Save packet sequence number to NVS
-    esp_err_t savePcktSeqNum();
+    /// Persist the requested end of the reserved sequence number block to NVS (blocking, `blocking` if the TX path waits for it)
+    esp_err_t savePcktSeqNum(bool blocking = false);
 
-    /// Load persisted packet sequence number from NVS
+    /// Load the reserved block end from NVS and continue behind it
     esp_err_t loadPcktSeqNum();
 
 private:
     static const uint8_t _packet_base_linetest[];  ///< Base packet template for line test transmissions
     static const uint8_t _packet_base_firealarm[]; ///< Base packet template for fire alarm transmissions
-    uint8_t _packet_sequence_number;               ///< Current packet sequence number (persisted in NVS)
+    uint8_t _packet_sequence_number;               ///< Last used packet sequence number
 
     ESP32SvelteKit *_sveltekit;               ///< Framework instance
     PsychicHttpServer *_server;               ///< HTTP server instance
@@ -213,20 +387,83 @@ private:
     FSPersistence<AlarmLines> _fsPersistence; ///< File system persistence
     CC1101Controller *_cc1101Ctrl;            ///< RF controller instance
 
-    TaskHandle_t _txTaskHandle;      ///< Transmission task handle
-    SemaphoreHandle_t _txSemaphore;  ///< Transmission synchronization
-    esp_timer_handle_t _timerHandle; ///< High precision timer handle
+    TaskHandle_t _txTaskHandle;     ///< Transmission task handle
+    SemaphoreHandle_t _txSemaphore; ///< Transmission synchronization
+    gptimer_handle_t _txTimer;      ///< Periodic hardware timer pacing the packets of a train
 
     volatile bool _isTransmitting;              ///< Current transmission status
+    volatile bool _preemptRequested;            ///< Higher priority action pending, stop current train at next packet
+    uint8_t _currentPriority;                   ///< Priority of the action being transmitted
     volatile uint32_t _transmissionTimeElapsed; ///< Elapsed transmission time
     volatile uint32_t _lastTXLoop;              ///< Last transmission loop timestamp
 
-    uint32_t _txRepeat;                       ///< Number of transmission repetitions
-    uint8_t _txBuffer[CC1101_MAX_PACKET_LEN]; ///< Transmission buffer
-    size_t _txDataLength;                     ///< Current transmission data length
-    float _packetCntStep;                     ///< Packet count increment step
-    float _currentPacketCnt;                  ///< Current packet count value
-    uint32_t _txPeriodUs;                     ///< Transmission period in microseconds
+    alarm_lines_tx_train_t _train; ///< Packet train of the current action
+
+    std::deque<alarm_lines_tx_request_t> _txQueue; ///< Pending actions (bounded by ALARMLINES_TX_QUEUE_SIZE)
+    SemaphoreHandle_t _txQueueMutex;               ///< Protects queue, its statistics and the current priority
+    alarm_lines_tx_queue_stats_t _txQueueStats;    ///< Scheduler statistics
+
+    alarm_lines_tx_stats_t _txStats[ALARMLINES_TX_STATS_HISTORY_SIZE]; ///< Ring of the last transmissions' timing statistics
+    uint32_t _txStatsWritten;                                          ///< Number of statistics ever recorded
+    portMUX_TYPE _txStatsLock;                                         ///< Protects the statistics ring
+
+    uint8_t _seqPersistedBound;          ///< End of the block of sequence numbers reserved in NVS (exclusive)
+    volatile uint8_t _seqRequestedBound; ///< End of the block to be reserved by the next NVS write
+    SemaphoreHandle_t _seqMutex;         ///< Serializes NVS writes of the sequence number
+    alarm_lines_seq_stats_t _seqStats;   ///< Sequence number persistence statistics
+    uint32_t _lastSeqCommitFailure;      ///< Time of the last failed background commit (ms), throttles retries
+    loop_task_id_t _seqCommitTask;       ///< Loop task committing reserved blocks, run on request and for retries
+
+    std::atomic<uint32_t> _knownLineIds[ALARMLINES_MAX_NUM + 1]; ///< Sorted IDs of the known alarm lines (incl. broadcast)
+    std::atomic<uint32_t> _numKnownLineIds;                      ///< Number of valid entries in _knownLineIds
+    std::atomic<uint32_t> _knownLineIdsSeq;                      ///< Sequence lock of the known IDs, odd while they are rewritten
+    portMUX_TYPE _knownLineIdsLock;                              ///< Serializes writers of the known IDs
+
+    /// Rebuild the known alarm line IDs after the lines changed
+    void _updateKnownLineIds();
+
+    /// Parse an action name, returns false for unknown actions
+    static bool _parseAction(const String &name, alarm_lines_action_t &action);
+
+    /// Name of an action as used by the REST API
+    static const char *_actionName(alarm_lines_action_t action);
+
+    /// Scheduling priority of an action (higher is more urgent, fire alarm > line test)
+    static uint8_t _actionPriority(alarm_lines_action_t action);
+
+    /// Add an action to the TX queue, merging a single line action with a pending action of the same line
+    esp_err_t _enqueueAction(const std::vector<uint32_t> &lineIds, alarm_lines_action_t action, bool &merged, size_t &position);
+
+    /// Take the pending action with highest priority (oldest first) from the TX queue
+    bool _dequeueAction(alarm_lines_tx_request_t &request);
+
+    /// Put a preempted or partly performed batch action back to the front of the TX queue (ignores the queue bound)
+    void _requeueAction(const alarm_lines_tx_request_t &request, bool preempted);
+
+    /// Number of packets of the given length fitting into one protocol period (lines that can be interleaved)
+    static uint32_t _slotsPerPeriod(size_t length, uint32_t periodUs);
+
+    /// Build the packet train of an action for as many of its lines as can be interleaved (assigns sequence numbers), returns the number of lines
+    size_t _buildActionTrain(const alarm_lines_tx_request_t &request);
+
+    /// Precompute a packet train from the base packets of one or more lines, interleaving the lines within each protocol period
+    void _buildTrain(alarm_lines_tx_train_t &train, const uint8_t *basePackets, size_t numLines, size_t length,
+                     uint32_t numPackets, uint16_t firstPacketCnt, uint16_t lastPacketCnt, uint32_t periodUs);
+
+    /// Send a precomputed packet train, paced by the hardware timer, and measure its timing (returns true on timeout)
+    bool _sendTrain(const alarm_lines_tx_train_t &train, alarm_lines_tx_stats_t &stats);
+
+    /// Store timing statistics of a finished transmission
+    void _recordTxStats(const alarm_lines_tx_stats_t &stats);
+
+    /// Serialize timing statistics of a transmission
+    static void _txStatsToJson(const alarm_lines_tx_stats_t &stats, JsonObject &json);
+
+    /// Serve the timing statistics of the last transmissions
+    esp_err_t _handleGetTxStats(PsychicRequest *request);
+
+    /// Serve the pending actions and scheduler statistics
+    esp_err_t _handleGetTxQueue(PsychicRequest *request);
 
     /// Main monitoring loop for alarm line discovery
     void _monitorLoop();
@@ -240,14 +477,8 @@ private:
         static_cast<AlarmLinesService *>(_this)->_txLoop();
     }
 
-    /// Timer callback for transmission timing control
-    void _onTimer();
-
-    /// Static wrapper for timer callback
-    static void _onTimerImpl(void *_this)
-    {
-        static_cast<AlarmLinesService *>(_this)->_onTimer();
-    }
+    /// Hardware timer alarm (ISR context): signals the TX task to write the next packet
+    static bool IRAM_ATTR _onTimerISR(gptimer_handle_t timer, const gptimer_alarm_event_data_t *eventData, void *userContext);
 
     /// Check if alarm line with given ID already exists
     bool _alarmLineExists(uint32_t id);
@@ -261,6 +492,9 @@ private:
     /// Emit WebSocket event for new alarm line discovery
     void _emitNewAlarmLineEvent(uint32_t id);
 
+    /// Emit WebSocket event with the per-line changes of the most recent update (if any)
+    void _emitLinesChangedEvent();
+
     /// Emit WebSocket event for action completion
-    void _emitActionFinishedEvent(bool timedOut = false);
+    void _emitActionFinishedEvent(const alarm_lines_tx_stats_t &stats);
 };
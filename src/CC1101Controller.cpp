@@ -33,14 +33,13 @@
 CC1101Controller::CC1101Controller(ESP32SvelteKit *sveltekit) : _sveltekit(sveltekit),
                                                                 _server(sveltekit->getServer()),
                                                                 _securityManager(sveltekit->getSecurityManager()),
-                                                                _lastGDO0Check(0),
                                                                 _rxMonitorEnabled(false)
 {
 }
 
 void CC1101Controller::begin()
 {
-    _sveltekit->addLoopFunction(std::bind(&CC1101Controller::loop, this));
+    _sveltekit->addLoopTask("cc1101", std::bind(&CC1101Controller::loop, this), CC1101CONTROLLER_LOOP_PERIOD_MS);
 
     // Register endpoint for CC1101 status
     _server->on(CC1101CONTROLLER_SERVICE_PATH "/state",
@@ -57,30 +56,21 @@ void CC1101Controller::begin()
 
 void CC1101Controller::loop()
 {
-    uint32_t currentMillis = millis();
+    // Check for GDO0 stuck-high issue (called every CC1101CONTROLLER_LOOP_PERIOD_MS by the loop scheduler)
+    uint32_t lastRisingEdge = cc1101_get_last_rising_edge();
+    if (!(lastRisingEdge > 0)) // No rising edge stored yet
+        return;
 
-    // Check for GDO0 stuck-high issue every second
-    uint32_t timeElapsed = currentMillis - _lastGDO0Check;
-    if (timeElapsed >= CC1101CONTROLLER_LOOP_PERIOD_MS)
+    uint32_t current_time_ms = (unsigned long)(esp_timer_get_time() / 1000ULL);
+
+    int gpio_level = gpio_get_level(static_cast<gpio_num_t>(CONFIG_GDO0_GPIO));
+    if (gpio_level == 1 &&
+        cc1101_get_mode() == CCM_RX &&
+        current_time_ms - lastRisingEdge > CC1101CONTROLLER_MAX_GDO0_HIGH_DURATION_MS)
     {
-        _lastGDO0Check = currentMillis;
-
-        uint32_t lastRisingEdge = cc1101_get_last_rising_edge();
-        if (!(lastRisingEdge > 0)) // No rising edge stored yet
-            return;
-
-        uint32_t current_time_ms = (unsigned long)(esp_timer_get_time() / 1000ULL);
-
-        int gpio_level = gpio_get_level(static_cast<gpio_num_t>(CONFIG_GDO0_GPIO));
-        if (gpio_level == 1 &&
-            cc1101_get_mode() == CCM_RX &&
-            current_time_ms - lastRisingEdge > CC1101CONTROLLER_MAX_GDO0_HIGH_DURATION_MS)
-        {
-            ESP_LOGW(TAG, "GDO0 was in high state longer than %d ms. Flushing RX FIFO and returning to RX mode.", CC1101CONTROLLER_MAX_GDO0_HIGH_DURATION_MS);
-            cc1101_flush_rx_fifo();
-            cc1101_set_rx_state();
-            return;
-        }
+        ESP_LOGW(TAG, "GDO0 was in high state longer than %d ms. Flushing RX FIFO and returning to RX mode.", CC1101CONTROLLER_MAX_GDO0_HIGH_DURATION_MS);
+        cc1101_flush_rx_fifo();
+        cc1101_set_rx_state();
     }
 }
 
@@ -80,8 +80,7 @@ private:
     PsychicHttpServer *_server;        ///< HTTP server instance
     SecurityManager *_securityManager; ///< Security manager instance
 
-    volatile uint32_t _lastGDO0Check; ///< Last GDO0 state check timestamp (milliseconds)
-    bool _rxMonitorEnabled;           ///< RX monitoring enabled flag
+    bool _rxMonitorEnabled; ///< RX monitoring enabled flag
 
     /// HTTP handler for CC1101 status requests
     esp_err_t _handlerGetStatus(PsychicRequest *request);
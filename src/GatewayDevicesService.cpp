@@ -28,6 +28,7 @@
  */
 
 #include <GatewayDevicesService.h>
+#include <unordered_map>
 
 GatewayDevicesService::GatewayDevicesService(ESP32SvelteKit *sveltekit) : _httpEndpoint(GeniusDevices::read,
                                                                                         GeniusDevices::update,
@@ -35,7 +36,8 @@ GatewayDevicesService::GatewayDevicesService(ESP32SvelteKit *sveltekit) : _httpE
                                                                                         sveltekit->getServer(),
                                                                                         GATEWAY_DEVICES_SERVICE_PATH,
                                                                                         sveltekit->getSecurityManager(),
-                                                                                        AuthenticationPredicates::IS_ADMIN),
+                                                                                        AuthenticationPredicates::IS_ADMIN,
+                                                                                        GATEWAY_DEVICES_MAX_BODY_SIZE),
                                                                           _fsPersistence(GeniusDevices::read,
                                                                                          GeniusDevices::update,
                                                                                          this,
@@ -51,10 +53,16 @@ void GatewayDevicesService::begin()
     _httpEndpoint.begin();
     _fsPersistence.readFromFS();
 
-    /* Update alarming state after every device update */
+    /* Update alarming state after every device update, except for
+     * alarm state changes and device additions from packets, which maintain the counters themselves */
     this->addUpdateHandler([&](const String &originId)
-                           { _updateAlarmingState(); },
+                           { if (originId != ALARM_STATE_CHANGE &&
+                                 originId != GENIUS_DEVICE_ADDED_FROM_PACKET)
+                                _updateAlarmingState(); },
                            false);
+
+    /* Initial counters for the devices read from file system */
+    _updateAlarmingState();
 }
 
 bool GatewayDevicesService::AddGeniusDevice(const uint32_t snRadioModule,
@@ -75,6 +83,8 @@ bool GatewayDevicesService::AddGeniusDevice(const uint32_t snRadioModule,
     newDevice.registration = GDR_GENIUS_PACKET;
     // Add the new device to the state
     _state.devices.push_back(newDevice);
+    _state.changes.clear();
+    _state.changes.added.push_back(newDevice.id);
 
     endTransaction();
 
@@ -83,7 +93,7 @@ bool GatewayDevicesService::AddGeniusDevice(const uint32_t snRadioModule,
     return true;
 }
 
-const GeniusDevice *GatewayDevicesService::setAlarm(uint32_t detectorSN)
+const GeniusDevice *GatewayDevicesService::setAlarm(uint32_t detectorSN, uint32_t lineId)
 {
     GeniusDevice *updatedDevice = nullptr;
 
@@ -93,6 +103,22 @@ const GeniusDevice *GatewayDevicesService::setAlarm(uint32_t detectorSN)
     {
         if (device.smokeDetector.sn == detectorSN)
         {
+            /* Associate device with the alarm line it is alarming on */
+            if (lineId != 0 && device.alarmLineId != lineId)
+            {
+                if (device.isAlarming)
+                {
+                    _countLineAlarm(device.alarmLineId, false);
+                    _countLineAlarm(lineId, true);
+                }
+                device.alarmLineId = lineId;
+                _state.changes.clear();
+                _state.changes.updated.push_back(device.id);
+                updatedDevice = &device;
+
+                ESP_LOGI(GeniusDevices::TAG, "Smoke detector with SN '%lu' associated with alarm line '%lu'.", detectorSN, lineId);
+            }
+
             if (!device.isAlarming)
             {
                 device.isAlarming = true;
@@ -102,10 +128,16 @@ const GeniusDevice *GatewayDevicesService::setAlarm(uint32_t detectorSN)
                 device.alarms.push_back(alarm);
 
                 device.published = false; // Mark as not published for MQTT publishing
+                if (!updatedDevice)
+                {
+                    _state.changes.clear();
+                    _state.changes.updated.push_back(device.id);
+                }
 
                 updatedDevice = &device;
                 _isAlarming = true;
                 _numAlarming++;
+                _countLineAlarm(device.alarmLineId, true);
 
                 ESP_LOGI(GeniusDevices::TAG, "Alarm started for smoke detector with SN '%lu'.", detectorSN);
             }
@@ -146,9 +178,12 @@ const GeniusDevice *GatewayDevicesService::resetAlarm(uint32_t detectorSN, geniu
                 }
 
                 device.published = false; // Mark as not published for MQTT publishing
+                _state.changes.clear();
+                _state.changes.updated.push_back(device.id);
 
                 updatedDevice = &device;
                 _numAlarming--;
+                _countLineAlarm(device.alarmLineId, false);
 
                 ESP_LOGI(GeniusDevices::TAG, "Alarm ended for smoke detector with SN '%lu'.", detectorSN);
             }
@@ -173,6 +208,7 @@ bool GatewayDevicesService::resetAllAlarms()
 
     beginTransaction();
 
+    _state.changes.clear();
     for (GeniusDevice &device : _state.devices)
     {
         if (device.isAlarming)
@@ -190,6 +226,7 @@ bool GatewayDevicesService::resetAllAlarms()
             }
 
             device.published = false; // Mark as not published for MQTT publishing
+            _state.changes.updated.push_back(device.id);
 
             updated = true;
 
@@ -199,6 +236,8 @@ bool GatewayDevicesService::resetAllAlarms()
 
     _isAlarming = false;
     _numAlarming = 0;
+    for (auto &line : _numAlarmingPerLine)
+        line.second = 0;
 
     endTransaction();
 
@@ -213,21 +252,40 @@ void GatewayDevicesService::_updateAlarmingState()
     bool isAlarming = false;
     uint32_t numAlarming = 0;
 
+    beginTransaction();
+
+    // Keep known lines (with zero count), so that their aggregate state can still be published
+    for (auto &line : _numAlarmingPerLine)
+        line.second = 0;
+
     for (const GeniusDevice &device : _state.devices)
     {
         if (device.isAlarming)
         {
             isAlarming = true;
             numAlarming++;
+            _countLineAlarm(device.alarmLineId, true);
         }
     }
 
-    beginTransaction();
     _isAlarming = isAlarming;
     _numAlarming = numAlarming;
+
     endTransaction();
 }
 
+void GatewayDevicesService::_countLineAlarm(uint32_t lineId, bool alarming)
+{
+    if (lineId == 0)
+        return;
+
+    uint32_t &numAlarming = _numAlarmingPerLine[lineId];
+    if (alarming)
+        numAlarming++;
+    else if (numAlarming > 0)
+        numAlarming--;
+}
+
 uint32_t GatewayDevicesService::_generateUniqueDeviceId() const
 {
     uint32_t candidateId = (uint32_t)time(nullptr);
@@ -267,6 +325,15 @@ uint32_t GatewayDevicesService::numAlarmingDevices()
     return numAlarming;
 }
 
+std::unordered_map<uint32_t, uint32_t> GatewayDevicesService::numAlarmingDevicesPerLine()
+{
+    beginTransaction();
+    std::unordered_map<uint32_t, uint32_t> numAlarmingPerLine = _numAlarmingPerLine;
+    endTransaction();
+
+    return numAlarmingPerLine;
+}
+
 bool GatewayDevicesService::isSmokeDetectorKnown(uint32_t detectorSN)
 {
     bool found = false;
@@ -321,285 +388,323 @@ void GatewayDevicesService::setPublished(uint32_t smokeDetectorSN)
     endTransaction();
 }
 
-StateUpdateResult GeniusDevices::update(JsonObject &root, GeniusDevices &geniusDevices)
+GeniusDevice GeniusDevices::_deviceFromJson(JsonVariant jsonDevice, uint32_t deviceId)
 {
-    bool hasChanges = false;
+    JsonObject smokeDetectorJson = jsonDevice["smokeDetector"].as<JsonObject>();
+    JsonObject radioModuleJson = jsonDevice["radioModule"].as<JsonObject>();
 
-    if (!root["devices"].is<JsonArray>())
+    GeniusDevice newDevice = GeniusDevice(
+        GeniusComponent<GeniusSmokeDetector>(
+            static_cast<GeniusSmokeDetector>(smokeDetectorJson["model"].as<int>()),
+            smokeDetectorJson["sn"].as<uint32_t>(),
+            Utils::iso8601_to_time_t(smokeDetectorJson["productionDate"].as<const char *>())),
+        GeniusComponent<GeniusRadioModule>(
+            static_cast<GeniusRadioModule>(radioModuleJson["model"].as<int>()),
+            radioModuleJson["sn"].as<uint32_t>(),
+            Utils::iso8601_to_time_t(radioModuleJson["productionDate"].as<const char *>())),
+        jsonDevice["location"].as<String>(),
+        deviceId); // Use the ID from JSON
+
+    // Set optional properties with defaults
+    newDevice.isAlarming = jsonDevice["isAlarming"].is<bool>() ? jsonDevice["isAlarming"].as<bool>() : false;
+    newDevice.registration = jsonDevice["registration"].is<int>() ? static_cast<genius_device_registration_t>(jsonDevice["registration"].as<int>()) : GDR_MANUAL;
+    newDevice.alarmLineId = jsonDevice["alarmLineId"].is<uint32_t>() ? jsonDevice["alarmLineId"].as<uint32_t>() : 0;
+
+    // Process alarms
+    if (jsonDevice["alarms"].is<JsonArray>())
     {
-        ESP_LOGV(GeniusDevices::TAG, "No devices array in JSON, no changes made.");
-        return StateUpdateResult::UNCHANGED;
+        int alarms_count = 0;
+        for (JsonVariant jsonAlarm : jsonDevice["alarms"].as<JsonArray>())
+        {
+            if (alarms_count++ >= GATEWAY_MAX_ALARMS)
+            {
+                ESP_LOGE(GeniusDevices::TAG, "Too many alarms for smoke detector device. Maximum allowed is %d.", GATEWAY_MAX_ALARMS);
+                break;
+            }
+
+            newDevice.alarms.push_back(genius_device_alarm_t{
+                .startTime = Utils::iso8601_to_time_t(jsonAlarm["startTime"].as<const char *>()),
+                .endTime = Utils::iso8601_to_time_t(jsonAlarm["endTime"].as<const char *>()),
+                .endingReason = static_cast<genius_alarm_ending_t>(jsonAlarm["endingReason"].as<int>())});
+        }
     }
 
-    JsonArray jsonDevices = root["devices"].as<JsonArray>();
-    std::vector<GeniusDevice> newDevicesVector; // Build new devices vector in JSON order
-    std::vector<uint32_t> processedDeviceIds;   // Track which device IDs we've seen in JSON
+    // Mark for publishing
+    newDevice.published = false;
 
-    // Process each device from JSON - add new or update existing
-    int deviceCount = 0;
-    for (JsonVariant jsonDeviceArrItem : jsonDevices)
+    return newDevice;
+}
+
+bool GeniusDevices::_updateDeviceFromJson(GeniusDevice &device, JsonVariant jsonDevice)
+{
+    JsonObject smokeDetectorJson = jsonDevice["smokeDetector"].as<JsonObject>();
+    JsonObject radioModuleJson = jsonDevice["radioModule"].as<JsonObject>();
+
+    bool deviceChanged = false;
+
+    // Update smoke detector component...
+    // ...model
+    GeniusSmokeDetector newSmokeDetectorModel = static_cast<GeniusSmokeDetector>(smokeDetectorJson["model"].as<int>());
+    if (device.smokeDetector.model != newSmokeDetectorModel)
     {
-        if (deviceCount++ >= GATEWAY_MAX_DEVICES)
-        {
-            ESP_LOGE(GeniusDevices::TAG, "Too many smoke detector devices. Maximum allowed is %d.", GATEWAY_MAX_DEVICES);
-            break;
-        }
+        ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old model: %d, New model: %d",
+                 device.location.c_str(),
+                 static_cast<int>(device.smokeDetector.model),
+                 static_cast<int>(newSmokeDetectorModel));
 
-        JsonObject smokeDetectorJson = jsonDeviceArrItem["smokeDetector"].as<JsonObject>();
-        JsonObject radioModuleJson = jsonDeviceArrItem["radioModule"].as<JsonObject>();
+        device.smokeDetector.model = newSmokeDetectorModel;
+        deviceChanged = true;
+    }
+    // ...serial number
+    uint32_t newSmokeDetectorSN = smokeDetectorJson["sn"].as<uint32_t>();
+    if (device.smokeDetector.sn != newSmokeDetectorSN)
+    {
+        ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old SN: %lu, New SN: %lu",
+                 device.location.c_str(),
+                 device.smokeDetector.sn,
+                 newSmokeDetectorSN);
 
-        uint32_t deviceId = jsonDeviceArrItem["id"].as<uint32_t>();
-        processedDeviceIds.push_back(deviceId);
+        device.smokeDetector.sn = newSmokeDetectorSN;
+        deviceChanged = true;
+    }
+    // ...production date
+    time_t newSmokeDetectorProdDate = Utils::iso8601_to_time_t(smokeDetectorJson["productionDate"].as<const char *>());
+    if (device.smokeDetector.productionDate != newSmokeDetectorProdDate)
+    {
+        char oldDateBuf[Utils::ISO8601_BUFFER_SIZE];
+        char newDateBuf[Utils::ISO8601_BUFFER_SIZE];
+        Utils::time_t_to_iso8601(device.smokeDetector.productionDate, oldDateBuf, sizeof(oldDateBuf));
+        Utils::time_t_to_iso8601(newSmokeDetectorProdDate, newDateBuf, sizeof(newDateBuf));
+        ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old production date: %s, New production date: %s",
+                 device.location.c_str(),
+                 oldDateBuf,
+                 newDateBuf);
+
+        device.smokeDetector.productionDate = newSmokeDetectorProdDate;
+        deviceChanged = true;
+    }
 
-        // Check if device exists by ID
-        auto existingDevice = std::find_if(geniusDevices.devices.begin(), geniusDevices.devices.end(),
-                                           [deviceId](const GeniusDevice &device)
-                                           {
-                                               return device.id == deviceId;
-                                           });
+    // Update radio module component...
+    // ...model
+    GeniusRadioModule newRadioModuleModel = static_cast<GeniusRadioModule>(radioModuleJson["model"].as<int>());
+    if (device.radioModule.model != newRadioModuleModel)
+    {
+        ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old model: %d, New model: %d",
+                 device.location.c_str(),
+                 static_cast<int>(device.radioModule.model),
+                 static_cast<int>(newRadioModuleModel));
 
-        if (existingDevice == geniusDevices.devices.end())
-        {
-            // New device - add it (use ID from JSON)
-            GeniusDevice newDevice = GeniusDevice(
-                GeniusComponent<GeniusSmokeDetector>(
-                    static_cast<GeniusSmokeDetector>(smokeDetectorJson["model"].as<int>()),
-                    smokeDetectorJson["sn"].as<uint32_t>(),
-                    Utils::iso8601_to_time_t(smokeDetectorJson["productionDate"].as<String>())),
-                GeniusComponent<GeniusRadioModule>(
-                    static_cast<GeniusRadioModule>(radioModuleJson["model"].as<int>()),
-                    radioModuleJson["sn"].as<uint32_t>(),
-                    Utils::iso8601_to_time_t(radioModuleJson["productionDate"].as<String>())),
-                jsonDeviceArrItem["location"].as<String>(),
-                deviceId); // Use the ID from JSON
-
-            // Set optional properties with defaults
-            newDevice.isAlarming = jsonDeviceArrItem["isAlarming"].is<bool>() ? jsonDeviceArrItem["isAlarming"].as<bool>() : false;
-            newDevice.registration = jsonDeviceArrItem["registration"].is<int>() ? static_cast<genius_device_registration_t>(jsonDeviceArrItem["registration"].as<int>()) : GDR_MANUAL;
-
-            // Process alarms
-            if (jsonDeviceArrItem["alarms"].is<JsonArray>())
-            {
-                int alarms_count = 0;
-                for (JsonVariant jsonAlarm : jsonDeviceArrItem["alarms"].as<JsonArray>())
-                {
-                    if (alarms_count++ >= GATEWAY_MAX_ALARMS)
-                    {
-                        ESP_LOGE(GeniusDevices::TAG, "Too many alarms for smoke detector device. Maximum allowed is %d.", GATEWAY_MAX_ALARMS);
-                        break;
-                    }
-
-                    newDevice.alarms.push_back(genius_device_alarm_t{
-                        .startTime = Utils::iso8601_to_time_t(jsonAlarm["startTime"].as<String>()),
-                        .endTime = Utils::iso8601_to_time_t(jsonAlarm["endTime"].as<String>()),
-                        .endingReason = static_cast<genius_alarm_ending_t>(jsonAlarm["endingReason"].as<int>())});
-                }
-            }
+        device.radioModule.model = newRadioModuleModel;
+        deviceChanged = true;
+    }
+    // ...serial number
+    uint32_t newRadioModuleSN = radioModuleJson["sn"].as<uint32_t>();
+    if (device.radioModule.sn != newRadioModuleSN)
+    {
+        ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old SN: %lu, New SN: %lu",
+                 device.location.c_str(),
+                 device.radioModule.sn,
+                 newRadioModuleSN);
 
-            // Mark for republishing
-            newDevice.published = false;
+        device.radioModule.sn = newRadioModuleSN;
+        deviceChanged = true;
+    }
+    // ...production date
+    time_t newRadioModuleProdDate = Utils::iso8601_to_time_t(radioModuleJson["productionDate"].as<const char *>());
+    if (device.radioModule.productionDate != newRadioModuleProdDate)
+    {
+        char oldDateBuf[Utils::ISO8601_BUFFER_SIZE];
+        char newDateBuf[Utils::ISO8601_BUFFER_SIZE];
+        Utils::time_t_to_iso8601(device.radioModule.productionDate, oldDateBuf, sizeof(oldDateBuf));
+        Utils::time_t_to_iso8601(newRadioModuleProdDate, newDateBuf, sizeof(newDateBuf));
+        ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old production date: %s, New production date: %s",
+                 device.location.c_str(),
+                 oldDateBuf,
+                 newDateBuf);
+                 
+        device.radioModule.productionDate = newRadioModuleProdDate;
+        deviceChanged = true;
+    }
 
-            // Add the new device to our ordered vector
-            newDevicesVector.push_back(newDevice);
+    // Update location
+    String newLocation = jsonDevice["location"].as<String>();
+    if (device.location != newLocation)
+    {
+        ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old location: '%s', New location: '%s'",
+                 device.location.c_str(),
+                 device.location.c_str(),
+                 newLocation.c_str());
 
-            hasChanges = true;
-        }
-        else
-        {
-            // Copy existing device and update it (preserves order from JSON)
-            GeniusDevice updatedDevice = *existingDevice;
-            bool deviceChanged = false;
-
-            // Update smoke detector component...
-            // ...model
-            GeniusSmokeDetector newSmokeDetectorModel = static_cast<GeniusSmokeDetector>(smokeDetectorJson["model"].as<int>());
-            if (updatedDevice.smokeDetector.model != newSmokeDetectorModel)
-            {
-                ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old model: %d, New model: %d",
-                         updatedDevice.location.c_str(),
-                         static_cast<int>(updatedDevice.smokeDetector.model),
-                         static_cast<int>(newSmokeDetectorModel));
+        device.location = newLocation;
+        deviceChanged = true;
+    }
 
-                updatedDevice.smokeDetector.model = newSmokeDetectorModel;
-                deviceChanged = true;
-            }
-            // ...serial number
-            uint32_t newSmokeDetectorSN = smokeDetectorJson["sn"].as<uint32_t>();
-            if (updatedDevice.smokeDetector.sn != newSmokeDetectorSN)
-            {
-                ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old SN: %lu, New SN: %lu",
-                         updatedDevice.location.c_str(),
-                         updatedDevice.smokeDetector.sn,
-                         newSmokeDetectorSN);
+    // NOTE: The following attributes are managed internally and should not be updated from JSON:
+    // - isAlarming: Controlled by alarm detection system
+    // - registration: Set when device is first added/detected
+    // - alarms: Managed by alarm start/stop events
 
-                updatedDevice.smokeDetector.sn = newSmokeDetectorSN;
-                deviceChanged = true;
-            }
-            // ...production date
-            time_t newSmokeDetectorProdDate = Utils::iso8601_to_time_t(smokeDetectorJson["productionDate"].as<String>());
-            if (updatedDevice.smokeDetector.productionDate != newSmokeDetectorProdDate)
-            {
-                ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old production date: %s, New production date: %s",
-                         updatedDevice.location.c_str(),
-                         Utils::time_t_to_iso8601(updatedDevice.smokeDetector.productionDate).c_str(),
-                         Utils::time_t_to_iso8601(newSmokeDetectorProdDate).c_str());
+    /*
+    // Update isAlarming
+    bool newIsAlarming = jsonDevice["isAlarming"].is<bool>() ?
+        jsonDevice["isAlarming"].as<bool>() : false;
+    if (device.isAlarming != newIsAlarming)
+    {
+        ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old isAlarming: %s, New isAlarming: %s",
+                 device.location.c_str(),
+                 device.isAlarming ? "true" : "false",
+                 newIsAlarming ? "true" : "false");
 
-                updatedDevice.smokeDetector.productionDate = newSmokeDetectorProdDate;
-                deviceChanged = true;
-            }
+        device.isAlarming = newIsAlarming;
+        deviceChanged = true;
+    }
 
-            // Update radio module component...
-            // ...model
-            GeniusRadioModule newRadioModuleModel = static_cast<GeniusRadioModule>(radioModuleJson["model"].as<int>());
-            if (updatedDevice.radioModule.model != newRadioModuleModel)
-            {
-                ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old model: %d, New model: %d",
-                         updatedDevice.location.c_str(),
-                         static_cast<int>(updatedDevice.radioModule.model),
-                         static_cast<int>(newRadioModuleModel));
+    // Update registration
+    genius_device_registration_t newRegistration = jsonDevice["registration"].is<int>() ?
+        static_cast<genius_device_registration_t>(jsonDevice["registration"].as<int>()) : GDR_MANUAL;
+    if (device.registration != newRegistration)
+    {
+        ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old registration: %d, New registration: %d",
+                 device.location.c_str(),
+                 static_cast<int>(device.registration),
+                 static_cast<int>(newRegistration));
 
-                updatedDevice.radioModule.model = newRadioModuleModel;
-                deviceChanged = true;
-            }
-            // ...serial number
-            uint32_t newRadioModuleSN = radioModuleJson["sn"].as<uint32_t>();
-            if (updatedDevice.radioModule.sn != newRadioModuleSN)
-            {
-                ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old SN: %lu, New SN: %lu",
-                         updatedDevice.location.c_str(),
-                         updatedDevice.radioModule.sn,
-                         newRadioModuleSN);
+        device.registration = newRegistration;
+        deviceChanged = true;
+    }
 
-                updatedDevice.radioModule.sn = newRadioModuleSN;
-                deviceChanged = true;
-            }
-            // ...production date
-            time_t newRadioModuleProdDate = Utils::iso8601_to_time_t(radioModuleJson["productionDate"].as<String>());
-            if (updatedDevice.radioModule.productionDate != newRadioModuleProdDate)
+    // Update alarms (for simplicity, we replace the entire alarms vector if it has changed)
+    // A more sophisticated approach would compare individual alarms
+    std::vector<genius_device_alarm_t> newAlarms;
+    if (jsonDevice["alarms"].is<JsonArray>())
+    {
+        int alarms_count = 0;
+        for (JsonVariant jsonAlarm : jsonDevice["alarms"].as<JsonArray>())
+        {
+            if (alarms_count++ >= GATEWAY_MAX_ALARMS)
             {
-                ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old production date: %s, New production date: %s",
-                         updatedDevice.location.c_str(),
-                         Utils::time_t_to_iso8601(updatedDevice.radioModule.productionDate).c_str(),
-                         Utils::time_t_to_iso8601(newRadioModuleProdDate).c_str());
-                         
-                updatedDevice.radioModule.productionDate = newRadioModuleProdDate;
-                deviceChanged = true;
+                ESP_LOGE(GeniusDevices::TAG, "Too many alarms for smoke detector device. Maximum allowed is %d.", GATEWAY_MAX_ALARMS);
+                break;
             }
 
-            // Update location
-            String newLocation = jsonDeviceArrItem["location"].as<String>();
-            if (updatedDevice.location != newLocation)
-            {
-                ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old location: '%s', New location: '%s'",
-                         updatedDevice.location.c_str(),
-                         updatedDevice.location.c_str(),
-                         newLocation.c_str());
+            newAlarms.push_back(genius_device_alarm_t{
+                .startTime = Utils::iso8601_to_time_t(jsonAlarm["startTime"].as<const char *>()),
+                .endTime = Utils::iso8601_to_time_t(jsonAlarm["endTime"].as<const char *>()),
+                .endingReason = static_cast<genius_alarm_ending_t>(jsonAlarm["endingReason"].as<int>())});
+        }
+    }
 
-                updatedDevice.location = newLocation;
-                deviceChanged = true;
-            }
+    // Compare alarms (simple size comparison - could be more sophisticated)
+    if (device.alarms.size() != newAlarms.size())
+    {
+        ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Alarms count changed from %d to %d.",
+                 device.location.c_str(),
+                 device.alarms.size(),
+                 newAlarms.size());
 
-            // NOTE: The following attributes are managed internally and should not be updated from JSON:
-            // - isAlarming: Controlled by alarm detection system
-            // - registration: Set when device is first added/detected
-            // - alarms: Managed by alarm start/stop events
+        device.alarms = newAlarms;
+        deviceChanged = true;
+    }
+    */
 
-            /*
-            // Update isAlarming
-            bool newIsAlarming = jsonDeviceArrItem["isAlarming"].is<bool>() ?
-                jsonDeviceArrItem["isAlarming"].as<bool>() : false;
-            if (updatedDevice.isAlarming != newIsAlarming)
-            {
-                ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old isAlarming: %s, New isAlarming: %s",
-                         updatedDevice.location.c_str(),
-                         updatedDevice.isAlarming ? "true" : "false",
-                         newIsAlarming ? "true" : "false");
+    // Mark for republishing if device changed
+    if (deviceChanged)
+        device.published = false;
 
-                updatedDevice.isAlarming = newIsAlarming;
-                deviceChanged = true;
-            }
+    return deviceChanged;
+}
 
-            // Update registration
-            genius_device_registration_t newRegistration = jsonDeviceArrItem["registration"].is<int>() ?
-                static_cast<genius_device_registration_t>(jsonDeviceArrItem["registration"].as<int>()) : GDR_MANUAL;
-            if (updatedDevice.registration != newRegistration)
-            {
-                ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Old registration: %d, New registration: %d",
-                         updatedDevice.location.c_str(),
-                         static_cast<int>(updatedDevice.registration),
-                         static_cast<int>(newRegistration));
+GeniusDevicesChangeSet GatewayDevicesService::getLastChangeSet()
+{
+    beginTransaction();
+    GeniusDevicesChangeSet changes = _state.changes;
+    endTransaction();
+    return changes;
+}
 
-                existingDevice->registration = newRegistration;
-                deviceChanged = true;
-            }
+StateUpdateResult GeniusDevices::update(JsonObject &root, GeniusDevices &geniusDevices)
+{
+    if (!root["devices"].is<JsonArray>())
+    {
+        ESP_LOGV(GeniusDevices::TAG, "No devices array in JSON, no changes made.");
+        return StateUpdateResult::UNCHANGED;
+    }
 
-            // Update alarms (for simplicity, we replace the entire alarms vector if it has changed)
-            // A more sophisticated approach would compare individual alarms
-            std::vector<genius_device_alarm_t> newAlarms;
-            if (jsonDeviceArrItem["alarms"].is<JsonArray>())
-            {
-                int alarms_count = 0;
-                for (JsonVariant jsonAlarm : jsonDeviceArrItem["alarms"].as<JsonArray>())
-                {
-                    if (alarms_count++ >= GATEWAY_MAX_ALARMS)
-                    {
-                        ESP_LOGE(GeniusDevices::TAG, "Too many alarms for smoke detector device. Maximum allowed is %d.", GATEWAY_MAX_ALARMS);
-                        break;
-                    }
-
-                    newAlarms.push_back(genius_device_alarm_t{
-                        .startTime = Utils::iso8601_to_time_t(jsonAlarm["startTime"].as<String>()),
-                        .endTime = Utils::iso8601_to_time_t(jsonAlarm["endTime"].as<String>()),
-                        .endingReason = static_cast<genius_alarm_ending_t>(jsonAlarm["endingReason"].as<int>())});
-                }
-            }
+    JsonArray jsonDevices = root["devices"].as<JsonArray>();
+    std::vector<GeniusDevice> &existingDevices = geniusDevices.devices;
+    GeniusDevicesChangeSet &changes = geniusDevices.changes;
+    changes.clear();
+
+    // Index existing devices by ID, so every JSON device is matched in O(1)
+    constexpr size_t ADDED_SLOT = SIZE_MAX; // Slot of devices added by this update
+    std::unordered_map<uint32_t, size_t> slotById;
+    slotById.reserve(existingDevices.size() + std::min(jsonDevices.size(), static_cast<size_t>(GATEWAY_MAX_DEVICES)));
+    for (size_t slot = 0; slot < existingDevices.size(); slot++)
+        slotById.emplace(existingDevices[slot].id, slot);
+
+    std::vector<bool> slotTaken(existingDevices.size(), false);
+    std::vector<GeniusDevice> newDevicesVector; // Build new devices vector in JSON order
+    newDevicesVector.reserve(std::min(jsonDevices.size(), static_cast<size_t>(GATEWAY_MAX_DEVICES)));
 
-            // Compare alarms (simple size comparison - could be more sophisticated)
-            if (updatedDevice.alarms.size() != newAlarms.size())
-            {
-                ESP_LOGD(GeniusDevices::TAG, "Device @ '%s': Alarms count changed from %d to %d.",
-                         updatedDevice.location.c_str(),
-                         updatedDevice.alarms.size(),
-                         newAlarms.size());
+    // Process each device from JSON - add new or update existing
+    int deviceCount = 0;
+    size_t keptDevices = 0;  // Existing devices kept so far
+    size_t lastKeptSlot = 0; // Old slot of the last kept device
+    for (JsonVariant jsonDeviceArrItem : jsonDevices)
+    {
+        if (deviceCount++ >= GATEWAY_MAX_DEVICES)
+        {
+            ESP_LOGE(GeniusDevices::TAG, "Too many smoke detector devices. Maximum allowed is %d.", GATEWAY_MAX_DEVICES);
+            break;
+        }
 
-                updatedDevice.alarms = newAlarms;
-                deviceChanged = true;
-            }
-            */
+        uint32_t deviceId = jsonDeviceArrItem["id"].as<uint32_t>();
 
-            // Mark for republishing if device changed
-            if (deviceChanged)
-            {
-                updatedDevice.published = false;
-                hasChanges = true;
-            }
+        auto existingSlot = slotById.find(deviceId);
+        if (existingSlot == slotById.end())
+        {
+            // New device - add it (use ID from JSON) and remember its ID to catch duplicates of it
+            newDevicesVector.push_back(_deviceFromJson(jsonDeviceArrItem, deviceId));
+            changes.added.push_back(deviceId);
+            slotById.emplace(deviceId, ADDED_SLOT);
+            continue;
+        }
 
-            // Add updated device to our ordered vector
-            newDevicesVector.push_back(updatedDevice);
+        size_t slot = existingSlot->second;
+        if (slot == ADDED_SLOT || slotTaken[slot])
+        {
+            ESP_LOGW(GeniusDevices::TAG, "Duplicate device ID %lu in devices list, ignoring duplicate.", deviceId);
+            continue;
         }
-    }
+        slotTaken[slot] = true;
+
+        // Update existing device in place and move it to its new position (preserves order from JSON)
+        GeniusDevice &existingDevice = existingDevices[slot];
+        if (_updateDeviceFromJson(existingDevice, jsonDeviceArrItem))
+            changes.updated.push_back(deviceId);
 
-    // Check if devices have been added or removed
-    if (!hasChanges)
-        hasChanges = geniusDevices.devices.size() != newDevicesVector.size();
+        // Kept devices changed their relative order, if their old slots are not strictly increasing
+        // (shifts by added or removed devices do not count as reordering)
+        if (keptDevices > 0 && slot < lastKeptSlot)
+            changes.reordered = true;
+        lastKeptSlot = slot;
+        keptDevices++;
 
-    // Check if order changed
-    if (!hasChanges)
+        newDevicesVector.push_back(std::move(existingDevice));
+    }
+
+    // Collect devices no longer present in JSON
+    for (size_t slot = 0; slot < existingDevices.size(); slot++)
     {
-        for (size_t i = 0; i < geniusDevices.devices.size(); i++)
-        {
-            if (geniusDevices.devices[i].id != newDevicesVector[i].id)
-            {
-                hasChanges = true;
-                break;
-            }
-        }
+        if (!slotTaken[slot])
+            changes.removed.push_back(existingDevices[slot].id);
     }
 
     // Replace the original vector with the new ordered one
-    geniusDevices.devices = std::move(newDevicesVector);
+    existingDevices = std::move(newDevicesVector);
 
-    ESP_LOGV(GeniusDevices::TAG, "Smoke detector devices configurations updated.");
+    ESP_LOGV(GeniusDevices::TAG, "Smoke detector devices configurations updated (added: %u, updated: %u, removed: %u, reordered: %s).",
+             changes.added.size(), changes.updated.size(), changes.removed.size(), changes.reordered ? "yes" : "no");
 
-    return hasChanges ? StateUpdateResult::CHANGED : StateUpdateResult::UNCHANGED;
-}
\ No newline at end of file
+    return changes.empty() ? StateUpdateResult::UNCHANGED : StateUpdateResult::CHANGED;
+}
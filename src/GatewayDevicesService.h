@@ -38,12 +38,14 @@
 #include <PsychicHttp.h>
 #include <ESP32SvelteKit.h>
 #include <Utils.hpp>
+#include <unordered_map>
 
 #define GATEWAY_DEVICES_FILE "/config/gateway-devices.json"  ///< Configuration file path for device data
 #define GATEWAY_DEVICES_SERVICE_PATH "/rest/gateway-devices"  ///< REST API service endpoint path
 
 #define GATEWAY_MAX_DEVICES 50   ///< Maximum number of devices supported
 #define GATEWAY_MAX_ALARMS 100   ///< Maximum number of alarms supported
+#define GATEWAY_DEVICES_MAX_BODY_SIZE (64 * 1024)  ///< Maximum size of a posted device list (devices incl. alarm history)
 
 #define ALARM_STATE_CHANGE "alarm-state-change"  ///< WebSocket event for alarm state changes
 
@@ -114,7 +116,11 @@ public:
         root["sn"] = sn;
         // Production date (if any set)
         if (productionDate > 0)
-            root["productionDate"] = Utils::time_t_to_iso8601(productionDate);
+        {
+            char dateBuf[Utils::ISO8601_BUFFER_SIZE];
+            Utils::time_t_to_iso8601(productionDate, dateBuf, sizeof(dateBuf));
+            root["productionDate"] = dateBuf;
+        }
         // Model (if any set)
         if (static_cast<int>(model) != -1)
             root["model"] = static_cast<int>(model);
@@ -146,6 +152,7 @@ public:
                                    location(location),
                                    id(id), // Use provided ID (from JSON) or will be set by service
                                    registration(GDR_MANUAL),
+                                   alarmLineId(0),
                                    isAlarming(false),
                                    published(false)
     {
@@ -167,14 +174,19 @@ public:
         root["isAlarming"] = this->isAlarming;
         // Registration
         root["registration"] = this->registration;
+        // Alarm line (as learned from received alarm packets)
+        root["alarmLineId"] = this->alarmLineId;
         // Alarms
         JsonArray alarms = root["alarms"].to<JsonArray>();
+        char dateBuf[Utils::ISO8601_BUFFER_SIZE];
         for (auto &alarm : this->alarms)
         {
             JsonObject alarm_as_json = alarms.add<JsonObject>();
 
-            alarm_as_json["startTime"] = Utils::time_t_to_iso8601(alarm.startTime);
-            alarm_as_json["endTime"] = Utils::time_t_to_iso8601(alarm.endTime);
+            Utils::time_t_to_iso8601(alarm.startTime, dateBuf, sizeof(dateBuf));
+            alarm_as_json["startTime"] = dateBuf;
+            Utils::time_t_to_iso8601(alarm.endTime, dateBuf, sizeof(dateBuf));
+            alarm_as_json["endTime"] = dateBuf;
             alarm_as_json["endingReason"] = alarm.endingReason;
         }
     }
@@ -185,10 +197,39 @@ public:
     String location;
     std::vector<genius_device_alarm_t> alarms;
     genius_device_registration_t registration;
+    uint32_t alarmLineId; // Alarm line the device was last seen alarming on (0 if unknown)
     bool isAlarming;
     bool published; // Whether the current device configuration has been published via MQTT
 };
 
+/// Per-device changes caused by the most recent state update
+struct GeniusDevicesChangeSet
+{
+    std::vector<uint32_t> added;   ///< IDs of devices added
+    std::vector<uint32_t> updated; ///< IDs of existing devices whose configuration or state changed
+    std::vector<uint32_t> removed; ///< IDs of devices removed
+    bool reordered = false;        ///< Whether the order of the remaining devices changed
+
+    void clear()
+    {
+        added.clear();
+        updated.clear();
+        removed.clear();
+        reordered = false;
+    }
+
+    /// Check if any device was added or changed, i.e. has to be (re-)published
+    bool hasAddedOrUpdated() const
+    {
+        return !added.empty() || !updated.empty();
+    }
+
+    bool empty() const
+    {
+        return !hasAddedOrUpdated() && removed.empty() && !reordered;
+    }
+};
+
 class GeniusDevices
 {
 
@@ -196,6 +237,7 @@ public:
     static constexpr const char *TAG = "GeniusDevices";
 
     std::vector<GeniusDevice> devices;
+    GeniusDevicesChangeSet changes; ///< Changes caused by the most recent update
 
     static void read(GeniusDevices &geniusDevices, JsonObject &root)
     {
@@ -211,6 +253,13 @@ public:
 
     /// Update genius devices from JSON object
     static StateUpdateResult update(JsonObject &root, GeniusDevices &geniusDevices);
+
+private:
+    /// Create a new device from its JSON representation
+    static GeniusDevice _deviceFromJson(JsonVariant jsonDevice, uint32_t deviceId);
+
+    /// Apply the user-editable properties of a JSON device to an existing device, returns true if anything changed
+    static bool _updateDeviceFromJson(GeniusDevice &device, JsonVariant jsonDevice);
 };
 
 /// Service for managing gateway devices and smoke detector communication
@@ -226,8 +275,8 @@ public:
     bool AddGeniusDevice(const uint32_t snRadioModule,
                          const uint32_t snSmokeDetector);
 
-    /// Set alarm state for a device by detector serial number
-    const GeniusDevice *setAlarm(uint32_t detectorSN);
+    /// Set alarm state for a device by detector serial number, associating it with the alarm line (if given)
+    const GeniusDevice *setAlarm(uint32_t detectorSN, uint32_t lineId = 0);
 
     /// Reset alarm state for a device with specified ending reason
     const GeniusDevice *resetAlarm(uint32_t detectorSN, genius_alarm_ending_t endingReason);
@@ -241,6 +290,9 @@ public:
     /// Get the number of devices currently alarming
     uint32_t numAlarmingDevices();
 
+    /// Get the number of devices currently alarming per alarm line (lines that have seen alarms only)
+    std::unordered_map<uint32_t, uint32_t> numAlarmingDevicesPerLine();
+
     /// Check if a smoke detector is known/registered
     bool isSmokeDetectorKnown(uint32_t detectorSN);
 
@@ -250,15 +302,22 @@ public:
     /// Mark device as published to MQTT
     void setPublished(uint32_t smokeDetectorSN);
 
+    /// Get a copy of the per-device change set of the most recent update
+    GeniusDevicesChangeSet getLastChangeSet();
+
 private:
     HttpEndpoint<GeniusDevices> _httpEndpoint;   ///< REST API endpoint handler
     FSPersistence<GeniusDevices> _fsPersistence; ///< File system persistence handler
     bool _isAlarming;                            ///< Current global alarming state
     uint32_t _numAlarming;                       ///< Number of devices currently alarming
+    std::unordered_map<uint32_t, uint32_t> _numAlarmingPerLine; ///< Number of devices currently alarming by alarm line ID
 
     /// Update internal alarming state counters
     void _updateAlarmingState();
 
+    /// Adjust the alarming counter of an alarm line by +1/-1 (must be called within transaction)
+    void _countLineAlarm(uint32_t lineId, bool alarming);
+
     /// Generate a unique device ID for new devices
     uint32_t _generateUniqueDeviceId() const;
 };
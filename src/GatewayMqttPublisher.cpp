@@ -0,0 +1,671 @@
+/**
+ * @file GatewayMqttPublisher.cpp
+ * @brief Implementation of the asynchronous MQTT publisher
+ * 
+ * @copyright Copyright (c) 2024-2025 Genius Gateway Project
+ * @license AGPL-3.0 with Commons Clause
+ * 
+ * This file is part of Genius Gateway.
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the Commons Clause restriction.
+ * 
+ * "Commons Clause" License Condition v1.0
+ * The Software is provided to you by the Licensor under the License,
+ * as defined below, subject to the following condition:
+ * Without limiting other conditions in the License, the grant of rights
+ * under the License will not include, and the License does not grant to you,
+ * the right to Sell the Software.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * 
+ * See https://github.com/hmbacher/genius-gateway/blob/main/LICENSE for details.
+ */
+
+#include <GatewayMqttPublisher.h>
+#include <IPUtils.h>
+#include <Utils.hpp>
+
+GatewayMqttPublisher::GatewayMqttPublisher(ESP32SvelteKit *sveltekit,
+                                           GatewayDevicesService *gatewayDevices,
+                                           GatewayMqttSettingsService *gatewayMqttSettings) : _server(sveltekit->getServer()),
+                                                                                              _securityManager(sveltekit->getSecurityManager()),
+                                                                                              _mqttClient(sveltekit->getMqttClient()),
+                                                                                              _gatewayDevices(gatewayDevices),
+                                                                                              _gatewayMqttSettingsService(gatewayMqttSettings),
+                                                                                              _taskHandle(nullptr),
+                                                                                              _pendingRequests(0),
+                                                                                              _maxPendingRequests(0),
+                                                                                              _numRequests(0),
+                                                                                              _numFlushes(0),
+                                                                                              _numPublishes(0),
+                                                                                              _firstPendingTime(0),
+                                                                                              _lastLatencyUs(0),
+                                                                                              _maxLatencyUs(0),
+                                                                                              _sumLatencyUs(0),
+                                                                                              _rateWindowStart(0),
+                                                                                              _rateWindowPublishes(0),
+                                                                                              _publishesPerSecond(0.0f),
+                                                                                              _numCacheHits(0),
+                                                                                              _numCacheMisses(0),
+                                                                                              _alarmPublished(false),
+                                                                                              _lastAlarmIsAlarming(false),
+                                                                                              _lastAlarmNumAlarming(0),
+                                                                                              _numAlarmSent(0),
+                                                                                              _numAlarmSuppressed(0),
+                                                                                              _numLineSent(0),
+                                                                                              _outboxHead(0),
+                                                                                              _outboxCount(0),
+                                                                                              _outboxSeq(0),
+                                                                                              _outboxMaxCount(0),
+                                                                                              _numQueued(0),
+                                                                                              _numReplayed(0),
+                                                                                              _numCoalesced(0),
+                                                                                              _numDropped(0),
+                                                                                              _lastDrainCount(0),
+                                                                                              _lastDrainUs(0)
+{
+}
+
+void GatewayMqttPublisher::begin()
+{
+    BaseType_t xReturned;
+    xReturned = xTaskCreatePinnedToCore(
+        _loopImpl,
+        GATEWAY_MQTT_PUBLISHER_TASK_NAME,
+        GATEWAY_MQTT_PUBLISHER_TASK_STACK_SIZE,
+        this,
+        GATEWAY_MQTT_PUBLISHER_TASK_PRIORITY,
+        &_taskHandle,
+        GATEWAY_MQTT_PUBLISHER_TASK_CORE_AFFINITY);
+
+    if (xReturned != pdPASS)
+    {
+        ESP_LOGE(TAG, "MQTT publisher task creation failed.");
+        return;
+    }
+
+    ESP_LOGI(TAG, "MQTT publisher task created (%p).", _taskHandle);
+
+    // Register endpoint for publisher statistics
+    _server->on(GATEWAY_MQTT_PUBLISHER_SERVICE_PATH,
+                HTTP_GET,
+                _securityManager->wrapRequest(std::bind(&GatewayMqttPublisher::_handlerGetStats, this, std::placeholders::_1),
+                                              AuthenticationPredicates::IS_AUTHENTICATED));
+}
+
+void GatewayMqttPublisher::_request(uint32_t bits)
+{
+    if (_taskHandle == nullptr)
+        return;
+
+    beginTransaction();
+    if (_pendingRequests == 0)
+        _firstPendingTime = esp_timer_get_time();
+    _pendingRequests++;
+    if (_pendingRequests > _maxPendingRequests)
+        _maxPendingRequests = _pendingRequests;
+    _numRequests++;
+
+    // Setting bits never blocks and never overflows: repeated requests coalesce into the pending bits.
+    // Set within the transaction, so the publisher takes the bits together with the counters of the same requests.
+    xTaskNotifyIndexed(_taskHandle, GATEWAY_MQTT_PUBLISHER_TASK_NOTIFICATION_INDEX, bits, eSetBits);
+    endTransaction();
+}
+
+void GatewayMqttPublisher::_loop()
+{
+    uint32_t bits;
+    uint32_t moreBits;
+
+    ESP_LOGI(pcTaskGetName(0), "Started.");
+
+    while (1)
+    {
+        if (xTaskNotifyWaitIndexed(GATEWAY_MQTT_PUBLISHER_TASK_NOTIFICATION_INDEX, 0, ULONG_MAX, &bits, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        // Give bursts (e.g. repeated alarm packets) the chance to be coalesced into this flush
+        vTaskDelay(pdMS_TO_TICKS(GATEWAY_MQTT_PUBLISHER_COALESCE_MS));
+
+        // Collect requests that arrived during the coalescing window and reset the queue depth for exactly
+        // these requests, a later request starts a new latency measurement with its own timestamp
+        beginTransaction();
+        if (xTaskNotifyWaitIndexed(GATEWAY_MQTT_PUBLISHER_TASK_NOTIFICATION_INDEX, 0, ULONG_MAX, &moreBits, 0) == pdTRUE)
+            bits |= moreBits;
+        int64_t firstPendingTime = _firstPendingTime;
+        _pendingRequests = 0;
+        endTransaction();
+
+        uint32_t numPublished = _flush(bits);
+
+        int64_t now = esp_timer_get_time();
+        uint32_t latencyUs = static_cast<uint32_t>(now - firstPendingTime);
+
+        beginTransaction();
+        _numFlushes++;
+        _numPublishes += numPublished;
+        _rateWindowPublishes += numPublished;
+        _lastLatencyUs = latencyUs;
+        if (latencyUs > _maxLatencyUs)
+            _maxLatencyUs = latencyUs;
+        _sumLatencyUs += latencyUs;
+        _updatePublishRate(now);
+        endTransaction();
+
+        ESP_LOGV(TAG, "Flush published %lu messages (latency: %lu us).", numPublished, latencyUs);
+    }
+}
+
+uint32_t GatewayMqttPublisher::_flush(uint32_t bits)
+{
+    uint32_t numPublished = 0;
+    bool publishAlarm = (bits & GATEWAY_MQTT_PUBLISH_ALARM) != 0;
+    bool onlyState = (bits & GATEWAY_MQTT_PUBLISH_DEVICES_CONFIG) == 0;
+
+    // A new broker session does not know what has been published before
+    if (bits & GATEWAY_MQTT_PUBLISH_SESSION_START)
+    {
+        _alarmPublished = false;
+        _publishedLines.clear();
+    }
+
+    GatewayMqttSettings mqttSettings = _gatewayMqttSettingsService->getSettingsCopy(); // Explicit deep copy for thread safety
+
+    bool connected = _mqttClient->connected();
+
+    // Transitions buffered while offline go first to keep the order of occurrence
+    if (connected && _outboxCount > 0)
+        numPublished += _drainOutbox(mqttSettings);
+
+    if (!connected || _outboxCount > 0)
+    {
+        // Dirty devices stay unpublished and will be published on (re-)connect,
+        // their state transitions are buffered to be replayed in order
+        _queueTransitions(mqttSettings);
+        return numPublished;
+    }
+
+    if (bits & (GATEWAY_MQTT_PUBLISH_DEVICES_STATE | GATEWAY_MQTT_PUBLISH_DEVICES_CONFIG))
+    {
+        // Get optimized MQTT data - only the minimal properties needed for publishing,
+        // thread-safe and performance optimized
+        std::vector<DeviceMqttData> devicesMqttData = _gatewayDevices->getDevicesMqttData();
+        if (devicesMqttData.empty())
+        {
+            ESP_LOGV(TAG, "No pending devices, skipping MQTT device publish.");
+        }
+        else
+        {
+            // Global alarm state may have changed along with the devices' states
+            publishAlarm = true;
+
+            /* Publish Home Assistant compatible topics */
+            if (mqttSettings.haMQTTEnabled)
+            {
+                if (mqttSettings.haMQTTTopicPrefix.isEmpty())
+                {
+                    ESP_LOGW(TAG, "Home Assistant MQTT topic prefix is empty. Cannot publish config topic.");
+                }
+                else
+                {
+                    // Topics and discovery payloads depend on the topic prefix and the IP address (entity picture)
+                    _validateDeviceCache(mqttSettings.haMQTTTopicPrefix, WiFi.localIP());
+
+                    for (const auto &deviceData : devicesMqttData) // Now thread safe and lightweight
+                    {
+                        GatewayMqttDeviceCache &cache = _getDeviceCache(deviceData);
+
+                        /* Publish config and attributes topics for device discovery */
+                        if (!onlyState)
+                        {
+                            if (cache.configPayload.isEmpty())
+                            {
+                                _buildDiscoveryPayloads(deviceData, cache);
+                                _numCacheMisses++;
+                            }
+                            else
+                            {
+                                _numCacheHits++;
+                            }
+
+                            _mqttClient->publish(cache.configTopic.c_str(), 0, true, cache.configPayload.c_str());
+                            _mqttClient->publish(cache.attrTopic.c_str(), 0, true, cache.attrPayload.c_str());
+                            numPublished += 2;
+                        }
+
+                        /* Pubish state topic */
+                        _mqttClient->publish(cache.stateTopic.c_str(), 0, true,
+                                             deviceData.isAlarming ? GATEWAY_MQTT_STATE_PAYLOAD_ON : GATEWAY_MQTT_STATE_PAYLOAD_OFF);
+                        cache.lastState = deviceData.isAlarming ? 1 : 0;
+                        numPublished++;
+
+                        // Set device as published
+                        _gatewayDevices->setPublished(deviceData.smokeDetectorSN);
+                    }
+                }
+            }
+        }
+    }
+
+    /* Publish generic alarming topic, but only if its value changed within the current broker session */
+    if (mqttSettings.alarmEnabled)
+    {
+        if (mqttSettings.alarmTopic.isEmpty())
+        {
+            ESP_LOGW(TAG, "Alarm MQTT topic is empty. Cannot publish alarming state.");
+        }
+        else
+        {
+            bool isAlarming = _gatewayDevices->isAlarming();
+            uint32_t numAlarming = _gatewayDevices->numAlarmingDevices();
+
+            if (_alarmPublished &&
+                _lastAlarmIsAlarming == isAlarming &&
+                _lastAlarmNumAlarming == numAlarming &&
+                _lastAlarmTopic == mqttSettings.alarmTopic)
+            {
+                if (publishAlarm)
+                    _numAlarmSuppressed++;
+            }
+            else
+            {
+                char payload[64];
+                snprintf(payload, sizeof(payload), "{\"isAlarming\":%s,\"numAlarmingDevices\":%lu}",
+                         isAlarming ? "true" : "false",
+                         numAlarming);
+                if (_mqttClient->publish(mqttSettings.alarmTopic.c_str(), 0, true, payload) >= 0)
+                {
+                    _alarmPublished = true;
+                    _lastAlarmIsAlarming = isAlarming;
+                    _lastAlarmNumAlarming = numAlarming;
+                    _lastAlarmTopic = mqttSettings.alarmTopic;
+                    _numAlarmSent++;
+                    numPublished++;
+                }
+            }
+
+            numPublished += _publishLineStates(mqttSettings.alarmTopic);
+        }
+    }
+
+    return numPublished;
+}
+
+uint32_t GatewayMqttPublisher::_publishLineStates(const String &alarmTopic)
+{
+    uint32_t numPublished = 0;
+    char payload[64];
+
+    // Line topics are derived from the alarm topic
+    if (_publishedLinesTopic != alarmTopic)
+    {
+        _publishedLines.clear();
+        _publishedLinesTopic = alarmTopic;
+    }
+
+    for (const auto &line : _gatewayDevices->numAlarmingDevicesPerLine())
+    {
+        auto published = _publishedLines.find(line.first);
+        if (published != _publishedLines.end() && published->second == line.second)
+            continue;
+
+        String lineTopic = alarmTopic + GATEWAY_MQTT_LINE_TOPIC_INFIX + line.first;
+        snprintf(payload, sizeof(payload), "{\"isAlarming\":%s,\"numAlarmingDevices\":%lu}",
+                 line.second > 0 ? "true" : "false",
+                 line.second);
+        if (_mqttClient->publish(lineTopic.c_str(), 0, true, payload) >= 0)
+        {
+            _publishedLines[line.first] = line.second;
+            _numLineSent++;
+            numPublished++;
+        }
+    }
+
+    return numPublished;
+}
+
+void GatewayMqttPublisher::_queueTransitions(const GatewayMqttSettings &mqttSettings)
+{
+    time_t now = time(nullptr);
+
+    /* Device state transitions */
+    if (mqttSettings.haMQTTEnabled && !mqttSettings.haMQTTTopicPrefix.isEmpty())
+    {
+        _validateDeviceCache(mqttSettings.haMQTTTopicPrefix, WiFi.localIP());
+
+        std::vector<DeviceMqttData> devicesMqttData = _gatewayDevices->getDevicesMqttData();
+        for (const auto &deviceData : devicesMqttData)
+        {
+            GatewayMqttDeviceCache &cache = _getDeviceCache(deviceData);
+            int8_t state = deviceData.isAlarming ? 1 : 0;
+            if (cache.lastState == state)
+                continue;
+
+            gateway_mqtt_outbox_entry_t entry = {};
+            entry.eventTime = now;
+            entry.type = GMO_DEVICE_STATE;
+            entry.smokeDetectorSN = deviceData.smokeDetectorSN;
+            entry.isAlarming = deviceData.isAlarming;
+            _outboxPush(entry);
+
+            cache.lastState = state;
+        }
+    }
+
+    /* Alarm summary transition */
+    if (mqttSettings.alarmEnabled && !mqttSettings.alarmTopic.isEmpty())
+    {
+        bool isAlarming = _gatewayDevices->isAlarming();
+        uint32_t numAlarming = _gatewayDevices->numAlarmingDevices();
+
+        // Compare with the most recent summary queued, or the one published last
+        bool known = _alarmPublished;
+        bool lastIsAlarming = _lastAlarmIsAlarming;
+        uint32_t lastNumAlarming = _lastAlarmNumAlarming;
+        for (uint32_t pos = _outboxCount; pos > 0; pos--)
+        {
+            const gateway_mqtt_outbox_entry_t &queued = _outboxAt(pos - 1);
+            if (queued.type == GMO_ALARM_SUMMARY)
+            {
+                known = true;
+                lastIsAlarming = queued.isAlarming;
+                lastNumAlarming = queued.numAlarmingDevices;
+                break;
+            }
+        }
+
+        if (!known || lastIsAlarming != isAlarming || lastNumAlarming != numAlarming)
+        {
+            gateway_mqtt_outbox_entry_t entry = {};
+            entry.eventTime = now;
+            entry.type = GMO_ALARM_SUMMARY;
+            entry.isAlarming = isAlarming;
+            entry.numAlarmingDevices = numAlarming;
+            _outboxPush(entry);
+        }
+    }
+}
+
+void GatewayMqttPublisher::_outboxPush(gateway_mqtt_outbox_entry_t entry)
+{
+    if (_outboxCount == GATEWAY_MQTT_OUTBOX_SIZE)
+    {
+        // Full: remove the oldest entry superseded by a later one of the same topic (the new entry included),
+        // as only the latest retained state of a topic matters in the end
+        uint32_t victim = GATEWAY_MQTT_OUTBOX_SIZE;
+        for (uint32_t pos = 0; pos < _outboxCount && victim == GATEWAY_MQTT_OUTBOX_SIZE; pos++)
+        {
+            const gateway_mqtt_outbox_entry_t &candidate = _outboxAt(pos);
+            if (candidate.type == entry.type && candidate.smokeDetectorSN == entry.smokeDetectorSN)
+            {
+                victim = pos;
+                break;
+            }
+            for (uint32_t later = pos + 1; later < _outboxCount; later++)
+            {
+                const gateway_mqtt_outbox_entry_t &other = _outboxAt(later);
+                if (candidate.type == other.type && candidate.smokeDetectorSN == other.smokeDetectorSN)
+                {
+                    victim = pos;
+                    break;
+                }
+            }
+        }
+
+        if (victim == GATEWAY_MQTT_OUTBOX_SIZE)
+        {
+            victim = 0;
+            _numDropped++;
+            ESP_LOGW(TAG, "MQTT outbox full, dropping oldest transition (seq %lu).", _outboxAt(0).seq);
+        }
+        else
+        {
+            _numCoalesced++;
+        }
+
+        // Close the gap by moving the older entries one position up
+        for (uint32_t pos = victim; pos > 0; pos--)
+            _outboxAt(pos) = _outboxAt(pos - 1);
+        _outboxHead = (_outboxHead + 1) % GATEWAY_MQTT_OUTBOX_SIZE;
+        _outboxCount--;
+    }
+
+    entry.seq = _outboxSeq++;
+    _outboxAt(_outboxCount) = entry;
+    _outboxCount++;
+    _numQueued++;
+    if (_outboxCount > _outboxMaxCount)
+        _outboxMaxCount = _outboxCount;
+
+    ESP_LOGD(TAG, "Queued transition seq %lu (type %d, SN %lu, alarming: %d).", entry.seq, entry.type, entry.smokeDetectorSN, entry.isAlarming);
+}
+
+uint32_t GatewayMqttPublisher::_drainOutbox(const GatewayMqttSettings &mqttSettings)
+{
+    int64_t start = esp_timer_get_time();
+    uint32_t numPublished = 0;
+    char timeBuf[Utils::ISO8601_BUFFER_SIZE];
+    char payload[96];
+
+    while (_outboxCount > 0)
+    {
+        const gateway_mqtt_outbox_entry_t &entry = _outboxAt(0);
+        Utils::time_t_to_iso8601(entry.eventTime, timeBuf, sizeof(timeBuf));
+
+        int msgId = 0;
+        bool sent = false;
+        if (entry.type == GMO_DEVICE_STATE)
+        {
+            // Publishing might have been disabled meanwhile
+            if (mqttSettings.haMQTTEnabled && !mqttSettings.haMQTTTopicPrefix.isEmpty())
+            {
+                String stateTopic = mqttSettings.haMQTTTopicPrefix + entry.smokeDetectorSN + "/state";
+                snprintf(payload, sizeof(payload), "{\"state\":\"%s\",\"time\":\"%s\"}",
+                         entry.isAlarming ? "ON" : "OFF", timeBuf);
+                msgId = _mqttClient->publish(stateTopic.c_str(), GATEWAY_MQTT_OUTBOX_QOS, true, payload);
+                sent = true;
+            }
+        }
+        else
+        {
+            if (mqttSettings.alarmEnabled && !mqttSettings.alarmTopic.isEmpty())
+            {
+                snprintf(payload, sizeof(payload), "{\"isAlarming\":%s,\"numAlarmingDevices\":%lu,\"time\":\"%s\"}",
+                         entry.isAlarming ? "true" : "false", entry.numAlarmingDevices, timeBuf);
+                msgId = _mqttClient->publish(mqttSettings.alarmTopic.c_str(), GATEWAY_MQTT_OUTBOX_QOS, true, payload);
+                sent = true;
+                if (msgId >= 0)
+                {
+                    _alarmPublished = true;
+                    _lastAlarmIsAlarming = entry.isAlarming;
+                    _lastAlarmNumAlarming = entry.numAlarmingDevices;
+                    _lastAlarmTopic = mqttSettings.alarmTopic;
+                    _numAlarmSent++;
+                }
+            }
+        }
+
+        if (msgId < 0)
+        {
+            // Connection lost again, keep the remaining transitions for the next session
+            ESP_LOGW(TAG, "Replaying MQTT outbox interrupted at seq %lu.", entry.seq);
+            break;
+        }
+
+        if (sent)
+        {
+            ESP_LOGV(TAG, "Replayed transition seq %lu.", entry.seq);
+            _numReplayed++;
+            numPublished++;
+        }
+        _outboxHead = (_outboxHead + 1) % GATEWAY_MQTT_OUTBOX_SIZE;
+        _outboxCount--;
+    }
+
+    _lastDrainCount = numPublished;
+    _lastDrainUs = static_cast<uint32_t>(esp_timer_get_time() - start);
+    ESP_LOGI(TAG, "Replayed %lu buffered MQTT transitions in %lu us.", _lastDrainCount, _lastDrainUs);
+
+    return numPublished;
+}
+
+void GatewayMqttPublisher::_validateDeviceCache(const String &topicPrefix, const IPAddress &localIP)
+{
+    if (_cacheTopicPrefix == topicPrefix && _cacheLocalIP == localIP)
+        return;
+
+    ESP_LOGD(TAG, "Topic prefix or IP address changed, invalidating MQTT device cache.");
+
+    _deviceCache.clear();
+    _cacheTopicPrefix = topicPrefix;
+    _cacheLocalIP = localIP;
+}
+
+GatewayMqttDeviceCache &GatewayMqttPublisher::_getDeviceCache(const DeviceMqttData &deviceData)
+{
+    auto it = _deviceCache.find(deviceData.smokeDetectorSN);
+    if (it == _deviceCache.end())
+    {
+        // Entries of removed devices are never used again, start over instead of growing without bounds
+        if (_deviceCache.size() >= GATEWAY_MQTT_PUBLISHER_MAX_CACHED_DEVICES)
+            _deviceCache.clear();
+
+        it = _deviceCache.emplace(deviceData.smokeDetectorSN, GatewayMqttDeviceCache()).first;
+        GatewayMqttDeviceCache &cache = it->second;
+
+        String baseTopic = _cacheTopicPrefix + deviceData.smokeDetectorSN;
+        cache.configTopic = baseTopic + "/config";
+        cache.attrTopic = baseTopic + "/attributes";
+        cache.stateTopic = baseTopic + "/state";
+        cache.setKey(deviceData);
+    }
+    else if (!it->second.matchesKey(deviceData))
+    {
+        // Device configuration changed, payloads are rebuilt on next full publish
+        it->second.setKey(deviceData);
+        it->second.configPayload = String();
+        it->second.attrPayload = String();
+    }
+
+    return it->second;
+}
+
+void GatewayMqttPublisher::_buildDiscoveryPayloads(const DeviceMqttData &deviceData, GatewayMqttDeviceCache &cache)
+{
+    JsonDocument config_jsonDoc;
+    config_jsonDoc["~"] = _cacheTopicPrefix + deviceData.smokeDetectorSN;
+    config_jsonDoc["name"] = "Genius Plus X";
+    config_jsonDoc["unique_id"] = deviceData.smokeDetectorSN;
+    config_jsonDoc["device_class"] = "smoke";
+    config_jsonDoc["state_topic"] = "~/state";
+    config_jsonDoc["schema"] = "json";
+    config_jsonDoc["value_template"] = "{{value_json.state}}";
+    // Only add entity_picture if we have a valid IP
+    if (IPUtils::isSet(_cacheLocalIP))
+    {
+        config_jsonDoc["entity_picture"] = "http://" + _cacheLocalIP.toString() + "/hekatron-genius-plus-x.png";
+    }
+    JsonObject dev_jsonObj = config_jsonDoc["device"].to<JsonObject>();
+    dev_jsonObj["identifiers"] = deviceData.smokeDetectorSN;
+    dev_jsonObj["manufacturer"] = "Hekatron Vertriebs GmbH";
+    dev_jsonObj["model"] = "Genius Plus X";
+    dev_jsonObj["name"] = "Rauchmelder";
+    dev_jsonObj["serial_number"] = deviceData.smokeDetectorSN;
+    dev_jsonObj["suggested_area"] = deviceData.location;
+
+    // Add attributes topic for entity attributes
+    config_jsonDoc["json_attributes_topic"] = "~/attributes";
+
+    cache.configPayload = String();
+    serializeJson(config_jsonDoc, cache.configPayload);
+
+    JsonDocument attr_jsonDoc;
+    char dateBuf[12]; // dd.mm.yy
+
+    // Add production date in dd.mm.yy format
+    if (deviceData.smokeDetectorProdDate > 0)
+    {
+        _formatShortDate(deviceData.smokeDetectorProdDate, dateBuf, sizeof(dateBuf));
+        attr_jsonDoc["Production Date"] = dateBuf;
+    }
+
+    // Add radio module information as flat attributes for better rendering
+    if (deviceData.radioModuleSN > 0)
+    {
+        attr_jsonDoc["FM Basis X - Serial"] = String(deviceData.radioModuleSN);
+
+        if (deviceData.radioModuleProdDate > 0)
+        {
+            _formatShortDate(deviceData.radioModuleProdDate, dateBuf, sizeof(dateBuf));
+            attr_jsonDoc["FM Basis X - Production Date"] = dateBuf;
+        }
+    }
+
+    cache.attrPayload = String();
+    serializeJson(attr_jsonDoc, cache.attrPayload);
+}
+
+void GatewayMqttPublisher::_formatShortDate(time_t time, char *buf, size_t bufSize)
+{
+    Utils::CivilTime civil;
+    Utils::time_t_to_civil(time, civil);
+    snprintf(buf, bufSize, "%02u.%02u.%02u", civil.day, civil.month, static_cast<unsigned>(civil.year % 100));
+}
+
+void GatewayMqttPublisher::_updatePublishRate(int64_t now)
+{
+    int64_t elapsed = now - _rateWindowStart;
+    if (elapsed >= GATEWAY_MQTT_PUBLISHER_RATE_WINDOW_US)
+    {
+        _publishesPerSecond = static_cast<float>(_rateWindowPublishes) * 1000000.0f / static_cast<float>(elapsed);
+        _rateWindowPublishes = 0;
+        _rateWindowStart = now;
+    }
+}
+
+esp_err_t GatewayMqttPublisher::_handlerGetStats(PsychicRequest *request)
+{
+    PsychicJsonResponse response = PsychicJsonResponse(request, false);
+    JsonObject json = response.getRoot();
+
+    beginTransaction();
+
+    _updatePublishRate(esp_timer_get_time());
+
+    json["connected"] = _mqttClient->connected();
+    json["queueDepth"] = _pendingRequests;
+    json["maxQueueDepth"] = _maxPendingRequests;
+    json["requests"] = _numRequests;
+    json["flushes"] = _numFlushes;
+    json["publishes"] = _numPublishes;
+    json["publishesPerSecond"] = _publishesPerSecond;
+    json["lastLatencyUs"] = _lastLatencyUs;
+    json["maxLatencyUs"] = _maxLatencyUs;
+    json["avgLatencyUs"] = _numFlushes > 0 ? static_cast<uint32_t>(_sumLatencyUs / _numFlushes) : 0;
+    json["payloadCacheHits"] = _numCacheHits;
+    json["payloadCacheMisses"] = _numCacheMisses;
+    json["alarmTopicSent"] = _numAlarmSent;
+    json["alarmTopicSuppressed"] = _numAlarmSuppressed;
+    json["lineTopicSent"] = _numLineSent;
+
+    JsonObject outbox = json["outbox"].to<JsonObject>();
+    outbox["depth"] = _outboxCount;
+    outbox["maxDepth"] = _outboxMaxCount;
+    outbox["capacity"] = GATEWAY_MQTT_OUTBOX_SIZE;
+    outbox["queued"] = _numQueued;
+    outbox["replayed"] = _numReplayed;
+    outbox["coalesced"] = _numCoalesced;
+    outbox["dropped"] = _numDropped;
+    outbox["lastDrainCount"] = _lastDrainCount;
+    outbox["lastDrainUs"] = _lastDrainUs;
+
+    endTransaction();
+
+    return response.send();
+}
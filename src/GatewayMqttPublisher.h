@@ -0,0 +1,265 @@
+/**
+ * @file GatewayMqttPublisher.h
+ * @brief Asynchronous, coalescing MQTT publisher for device and alarm states
+ * 
+ * @copyright Copyright (c) 2024-2025 Genius Gateway Project
+ * @license AGPL-3.0 with Commons Clause
+ * 
+ * This file is part of Genius Gateway.
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the Commons Clause restriction.
+ * 
+ * "Commons Clause" License Condition v1.0
+ * The Software is provided to you by the Licensor under the License,
+ * as defined below, subject to the following condition:
+ * Without limiting other conditions in the License, the grant of rights
+ * under the License will not include, and the License does not grant to you,
+ * the right to Sell the Software.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * 
+ * See https://github.com/hmbacher/genius-gateway/blob/main/LICENSE for details.
+ */
+
+#pragma once
+
+#include <ESP32SvelteKit.h>
+#include <PsychicHttp.h>
+#include <SecurityManager.h>
+#include <GatewayDevicesService.h>
+#include <GatewayMqttSettingsService.h>
+#include <ThreadSafeService.h>
+#include <unordered_map>
+
+#define GATEWAY_MQTT_PUBLISHER_SERVICE_PATH "/rest/mqtt-publisher" ///< REST API endpoint for publisher statistics
+#define GATEWAY_MQTT_PUBLISHER_TASK_STACK_SIZE 6144                ///< Stack size for publisher task in bytes
+#define GATEWAY_MQTT_PUBLISHER_TASK_PRIORITY 5                     ///< Priority level for publisher task (below RX/TX tasks)
+#define GATEWAY_MQTT_PUBLISHER_TASK_NAME "gateway-mqtt-pub"        ///< Name identifier for publisher task
+#define GATEWAY_MQTT_PUBLISHER_TASK_CORE_AFFINITY 0                ///< CPU core affinity for publisher task (0 or 1)
+
+/// Task notification array index for publisher task (must be < CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES)
+#define GATEWAY_MQTT_PUBLISHER_TASK_NOTIFICATION_INDEX 0
+
+/// Time to wait after the first request for further requests to be coalesced into the same flush
+#define GATEWAY_MQTT_PUBLISHER_COALESCE_MS 20
+
+#define GATEWAY_MQTT_PUBLISHER_RATE_WINDOW_US 1000000LL ///< Window for publishes per second calculation (1 second)
+
+#define GATEWAY_MQTT_PUBLISHER_MAX_CACHED_DEVICES (2 * GATEWAY_MAX_DEVICES) ///< Maximum number of cached devices before the cache is reset
+
+#define GATEWAY_MQTT_STATE_PAYLOAD_ON "{\"state\":\"ON\"}"   ///< Preformatted state payload of an alarming device
+#define GATEWAY_MQTT_STATE_PAYLOAD_OFF "{\"state\":\"OFF\"}" ///< Preformatted state payload of a non-alarming device
+
+#define GATEWAY_MQTT_LINE_TOPIC_INFIX "/line/" ///< Per-alarm-line topics: <alarm topic>/line/<line ID>
+
+#define GATEWAY_MQTT_OUTBOX_SIZE 128 ///< Number of state transitions buffered while the broker is unreachable
+#define GATEWAY_MQTT_OUTBOX_QOS 1    ///< QoS for replayed state transitions
+
+/* Publish request bits (task notification value) */
+#define GATEWAY_MQTT_PUBLISH_DEVICES_STATE (1UL << 0)  ///< Publish state of all dirty (unpublished) devices
+#define GATEWAY_MQTT_PUBLISH_DEVICES_CONFIG (1UL << 1) ///< Publish discovery config and attributes of all dirty devices
+#define GATEWAY_MQTT_PUBLISH_ALARM (1UL << 2)          ///< Publish the global alarm topic (if changed)
+#define GATEWAY_MQTT_PUBLISH_SESSION_START (1UL << 3)  ///< A new broker session started, republish everything tracked per session
+
+/// Precomputed MQTT topics and discovery payloads of a single device
+struct GatewayMqttDeviceCache
+{
+    String configTopic;   ///< Home Assistant discovery config topic
+    String attrTopic;     ///< Home Assistant attributes topic
+    String stateTopic;    ///< Home Assistant state topic
+    String configPayload; ///< Serialized discovery config payload (empty if not built yet)
+    String attrPayload;   ///< Serialized attributes payload
+    int8_t lastState = -1; ///< Last published or queued alarm state (-1: unknown, 0: OFF, 1: ON)
+
+    /* Device properties the payloads were built from */
+    String location;              ///< Device location string
+    time_t smokeDetectorProdDate; ///< Smoke detector production date
+    uint32_t radioModuleSN;       ///< Radio module serial number
+    time_t radioModuleProdDate;   ///< Radio module production date
+
+    /// Check if the payloads were built from the given device data
+    bool matchesKey(const DeviceMqttData &deviceData) const
+    {
+        return smokeDetectorProdDate == deviceData.smokeDetectorProdDate &&
+               radioModuleSN == deviceData.radioModuleSN &&
+               radioModuleProdDate == deviceData.radioModuleProdDate &&
+               location == deviceData.location;
+    }
+
+    /// Remember the device data the payloads are built from
+    void setKey(const DeviceMqttData &deviceData)
+    {
+        location = deviceData.location;
+        smokeDetectorProdDate = deviceData.smokeDetectorProdDate;
+        radioModuleSN = deviceData.radioModuleSN;
+        radioModuleProdDate = deviceData.radioModuleProdDate;
+    }
+};
+
+typedef enum gateway_mqtt_outbox_type
+{
+    GMO_DEVICE_STATE = 0, ///< State of a single device (Home Assistant state topic)
+    GMO_ALARM_SUMMARY     ///< Global alarm summary (alarm topic)
+} gateway_mqtt_outbox_type_t;
+
+/// State transition buffered while the broker is unreachable
+typedef struct gateway_mqtt_outbox_entry
+{
+    uint32_t seq;                    ///< Sequence number (order of occurrence)
+    time_t eventTime;                ///< Time the transition was observed
+    gateway_mqtt_outbox_type_t type; ///< Kind of transition, determines the topic
+    uint32_t smokeDetectorSN;        ///< Smoke detector serial number (device state only)
+    uint32_t numAlarmingDevices;     ///< Number of alarming devices (alarm summary only)
+    bool isAlarming;                 ///< Alarming state
+} gateway_mqtt_outbox_entry_t;
+
+/**
+ * @brief Publishes device and alarm states to MQTT from a dedicated task
+ *
+ * Producers (RX task, REST handlers, update handlers) only mark work as pending
+ * by setting bits in the task's notification value and never block on network I/O.
+ * Which devices are dirty is tracked by the devices service (see GeniusDevice::published),
+ * so any number of requests arriving before a flush results in one publish per dirty device.
+ */
+class GatewayMqttPublisher : public ThreadSafeService
+{
+public:
+    static constexpr const char *TAG = "GatewayMqttPublisher"; ///< Logging tag
+
+    GatewayMqttPublisher(ESP32SvelteKit *sveltekit,
+                         GatewayDevicesService *gatewayDevices,
+                         GatewayMqttSettingsService *gatewayMqttSettings);
+
+    /// Create the publisher task and register the statistics endpoint
+    void begin();
+
+    /// Request publishing of all dirty devices (state only, or including discovery config) and the global alarm topic
+    void requestPublish(bool onlyState = false)
+    {
+        _request(onlyState ? GATEWAY_MQTT_PUBLISH_DEVICES_STATE : (GATEWAY_MQTT_PUBLISH_DEVICES_STATE | GATEWAY_MQTT_PUBLISH_DEVICES_CONFIG));
+    }
+
+    /// Request publishing of the global alarm topic only (suppressed if unchanged)
+    void requestAlarmPublish()
+    {
+        _request(GATEWAY_MQTT_PUBLISH_ALARM);
+    }
+
+    /// Request a full publish after (re-)connecting to the broker
+    void requestSessionStart()
+    {
+        _request(GATEWAY_MQTT_PUBLISH_DEVICES_STATE | GATEWAY_MQTT_PUBLISH_DEVICES_CONFIG |
+                 GATEWAY_MQTT_PUBLISH_ALARM | GATEWAY_MQTT_PUBLISH_SESSION_START);
+    }
+
+private:
+    PsychicHttpServer *_server;                              ///< HTTP server instance
+    SecurityManager *_securityManager;                       ///< Security manager instance
+    PsychicMqttClient *_mqttClient;                          ///< MQTT client instance
+    GatewayDevicesService *_gatewayDevices;                  ///< Gateway devices service
+    GatewayMqttSettingsService *_gatewayMqttSettingsService; ///< MQTT settings service
+    TaskHandle_t _taskHandle;                                ///< Publisher task handle
+
+    /* Statistics shared with the requesting tasks (protected by transaction) */
+    uint32_t _pendingRequests;      ///< Requests since last flush (queue depth)
+    uint32_t _maxPendingRequests;   ///< Maximum queue depth observed
+    uint32_t _numRequests;          ///< Total number of publish requests
+    uint32_t _numFlushes;           ///< Total number of flushes performed
+    uint32_t _numPublishes;         ///< Total number of MQTT messages published
+    int64_t _firstPendingTime;      ///< Timestamp of the oldest pending request (microseconds)
+    uint32_t _lastLatencyUs;        ///< Latency of last flush, from oldest request to completion (microseconds)
+    uint32_t _maxLatencyUs;         ///< Maximum flush latency (microseconds)
+    uint64_t _sumLatencyUs;         ///< Sum of flush latencies for average calculation (microseconds)
+    int64_t _rateWindowStart;       ///< Start of the current publish rate window (microseconds)
+    uint32_t _rateWindowPublishes;  ///< Publishes within the current rate window
+    float _publishesPerSecond;      ///< Publishes per second of the last completed rate window
+
+    /*
+     * The members below are only written by the publisher task, without transaction. The statistics
+     * handler reads their 32 bit counters under the transaction, which may be one flush behind but never torn.
+     */
+
+    /* Device cache */
+    uint32_t _numCacheHits;                                            ///< Discovery publishes served from cached payloads
+    uint32_t _numCacheMisses;                                          ///< Discovery publishes that required building the payloads
+    std::unordered_map<uint32_t, GatewayMqttDeviceCache> _deviceCache; ///< Cached topics and payloads by smoke detector SN
+    String _cacheTopicPrefix;                                          ///< Topic prefix the cache was built with
+    IPAddress _cacheLocalIP;                                           ///< IP address the cache was built with
+
+    /* Global alarm topic, last value published within the current broker session */
+    bool _alarmPublished;           ///< Whether the alarm topic has been published in the current session
+    bool _lastAlarmIsAlarming;      ///< Last published alarming state
+    uint32_t _lastAlarmNumAlarming; ///< Last published number of alarming devices
+    String _lastAlarmTopic;         ///< Topic the last value was published to
+    uint32_t _numAlarmSent;         ///< Alarm topic messages sent
+    uint32_t _numAlarmSuppressed;   ///< Alarm topic publish requests suppressed as unchanged
+
+    /* Per-alarm-line topics, last values published within the current broker session */
+    std::unordered_map<uint32_t, uint32_t> _publishedLines; ///< Last published number of alarming devices by line ID
+    String _publishedLinesTopic;                            ///< Alarm topic the line topics were derived from
+    uint32_t _numLineSent;                                  ///< Line topic messages sent
+
+    /* Outbox ring buffer for transitions while offline */
+    gateway_mqtt_outbox_entry_t _outbox[GATEWAY_MQTT_OUTBOX_SIZE]; ///< Buffered state transitions
+    uint32_t _outboxHead;                                          ///< Index of the oldest entry
+    uint32_t _outboxCount;                                         ///< Number of buffered entries
+    uint32_t _outboxSeq;                                           ///< Next sequence number
+    uint32_t _outboxMaxCount;                                      ///< Maximum number of buffered entries observed
+    uint32_t _numQueued;                                           ///< Transitions buffered
+    uint32_t _numReplayed;                                         ///< Transitions replayed after reconnecting
+    uint32_t _numCoalesced;                                        ///< Transitions replaced by a later one of the same topic (outbox full)
+    uint32_t _numDropped;                                          ///< Transitions lost (outbox full, nothing to coalesce)
+    uint32_t _lastDrainCount;                                      ///< Transitions replayed by the last drain
+    uint32_t _lastDrainUs;                                         ///< Duration of the last drain (microseconds)
+
+    /// Mark work as pending and wake up the publisher task
+    void _request(uint32_t bits);
+
+    /// Publisher task loop
+    void _loop();
+
+    /// Static wrapper for publisher task
+    static void _loopImpl(void *_this) { static_cast<GatewayMqttPublisher *>(_this)->_loop(); }
+
+    /// Publish all pending work, returns number of messages published
+    uint32_t _flush(uint32_t bits);
+
+    /// Invalidate the device cache if the topic prefix or IP address changed
+    void _validateDeviceCache(const String &topicPrefix, const IPAddress &localIP);
+
+    /// Get the cache entry of a device, creating its topics and invalidating stale payloads as needed
+    GatewayMqttDeviceCache &_getDeviceCache(const DeviceMqttData &deviceData);
+
+    /// Build the serialized discovery config and attributes payloads of a device
+    void _buildDiscoveryPayloads(const DeviceMqttData &deviceData, GatewayMqttDeviceCache &cache);
+
+    /// Publish the aggregate state of every alarm line whose number of alarming devices changed
+    uint32_t _publishLineStates(const String &alarmTopic);
+
+    /// Buffer the state transitions of all dirty devices and the alarm summary while offline
+    void _queueTransitions(const GatewayMqttSettings &mqttSettings);
+
+    /// Append a transition to the outbox, coalescing superseded entries if full
+    void _outboxPush(gateway_mqtt_outbox_entry_t entry);
+
+    /// Access an outbox entry by its position (0 = oldest)
+    gateway_mqtt_outbox_entry_t &_outboxAt(uint32_t pos) { return _outbox[(_outboxHead + pos) % GATEWAY_MQTT_OUTBOX_SIZE]; }
+
+    /// Replay buffered transitions in order, returns number of messages published
+    uint32_t _drainOutbox(const GatewayMqttSettings &mqttSettings);
+
+    /// Format a timestamp as dd.mm.yy (UTC)
+    static void _formatShortDate(time_t time, char *buf, size_t bufSize);
+
+    /// Roll the publish rate window if it has elapsed (must be called within transaction)
+    void _updatePublishRate(int64_t now);
+
+    /// HTTP handler for publisher statistics
+    esp_err_t _handlerGetStats(PsychicRequest *request);
+};
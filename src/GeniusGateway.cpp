@@ -29,7 +29,6 @@
 
 #include <GeniusGateway.h>
 #include <GatewaySettingsService.h>
-#include <IPUtils.h>
 #include <Utils.hpp>
 
 TaskHandle_t GeniusGateway::xRxTaskHandle = nullptr;
@@ -48,13 +47,15 @@ static void nofifyReceivedPacket() // !!! This function is called from ISR !!!
     portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
-GeniusGateway::GeniusGateway(ESP32SvelteKit *sveltekit) : _server(sveltekit->getServer()),
+GeniusGateway::GeniusGateway(ESP32SvelteKit *sveltekit) : _sveltekit(sveltekit),
+                                                          _server(sveltekit->getServer()),
                                                           _securityManager(sveltekit->getSecurityManager()),
                                                           _gatewayDevices(sveltekit),
                                                           _alarmLines(sveltekit, &this->_cc1101Controller),
                                                           _gatewaySettings(sveltekit),
                                                           _gatewayMqttSettingsService(sveltekit),
                                                           _mqttClient(sveltekit->getMqttClient()),
+                                                          _mqttPublisher(sveltekit, &this->_gatewayDevices, &this->_gatewayMqttSettingsService),
                                                           _wsLogger(sveltekit),
                                                           _visualizerSettingsService(sveltekit),
                                                           _cc1101Controller(sveltekit),
@@ -62,7 +63,9 @@ GeniusGateway::GeniusGateway(ESP32SvelteKit *sveltekit) : _server(sveltekit->get
                                                           _eventSocket(sveltekit->getSocket()),
                                                           _featureService(sveltekit->getFeatureService()),
                                                           _lastPacketHash(0),
-                                                          _hasLastPacketHash(false)
+                                                          _hasLastPacketHash(false),
+                                                          _alarmEvent(EVENT_HANDLE_INVALID),
+                                                          _alarmStateEmitter(GATEWAY_ALARM_STATE_EMIT_INTERVAL_MS, std::bind(&GeniusGateway::_emitAlarmState, this))
 {
 }
 
@@ -120,6 +123,8 @@ void GeniusGateway::begin()
     _wsLogger.begin();
     /* Initialize Packet Vizualizer Settings */
     _visualizerSettingsService.begin();
+    /* Initialize MQTT Publisher */
+    _mqttPublisher.begin();
 
 #if FT_ENABLED(FT_CC1101_CONTROLLER)
     _featureService->addFeature("cc1101_controller", true);
@@ -132,24 +137,27 @@ void GeniusGateway::begin()
 
     /* Perform a full publish (all devices and states), if MQTT client connects. */
     _mqttClient->onConnect([this](bool /*sessionPresent*/)
-                           { this->_mqttPublishDevices(false); });
+                           { this->_mqttPublisher.requestSessionStart(); });
 
     /* Configure update handler for when the smoke detector devices change.
      * Only updates the MQTT state if the change did not originate from a
-     * device addition over received alarm packets or alarm state change. */
+     * device addition over received alarm packets or alarm state change,
+     * and only if devices were actually added or changed (not just removed or reordered). */
     _gatewayDevices.addUpdateHandler([&](const String &originId)
                                      { if (originId != GENIUS_DEVICE_ADDED_FROM_PACKET &&
-                                           originId != ALARM_STATE_CHANGE)
-                                        _mqttPublishDevices(); },
+                                           originId != ALARM_STATE_CHANGE &&
+                                           _gatewayDevices.getLastChangeSet().hasAddedOrUpdated())
+                                        _mqttPublisher.requestPublish(); },
                                      false);
 
     /* Configure update handler for when the MQTT settings change:
      * Perform a full publish (all devices and states), if settings change. */
     _gatewayMqttSettingsService.addUpdateHandler([&](const String &originId)
-                                                 { _mqttPublishDevices(); },
+                                                 { _mqttPublisher.requestPublish(); },
                                                  false);
 
-    _eventSocket->registerEvent(GATEWAY_EVENT_ALARM);
+    _alarmEvent = _eventSocket->registerEvent(GATEWAY_EVENT_ALARM);
+    _alarmStateEmitter.begin(_sveltekit, "alarm-state-emit");
 
     /* Initialize Alarm Blocking Service */
     _alarmBlocker.begin();
@@ -187,8 +195,8 @@ esp_err_t GeniusGateway::_handleEndAlarming(PsychicRequest *request, JsonVariant
 
     if (_gatewayDevices.resetAllAlarms())
     {
-        _mqttPublishDevices(true); // Re-Publish all silenced devices' state
-        _emitAlarmState();
+        _mqttPublisher.requestPublish(true); // Re-Publish all silenced devices' state
+        _updateAlarmState();
     }
 
     ESP_LOGI(TAG, "All active alarms have been ended.");
@@ -219,147 +227,23 @@ esp_err_t GeniusGateway::_handleEndBlocking(PsychicRequest *request)
     return request->reply(200, "application/json", "{\"success\": true}");
 }
 
+void GeniusGateway::_updateAlarmState()
+{
+    /* State is identified by alarming flag (bit 31) and number of alarming devices */
+    uint32_t state = (_gatewayDevices.isAlarming() ? 0x80000000UL : 0) | (_gatewayDevices.numAlarmingDevices() & 0x7FFFFFFFUL);
+    _alarmStateEmitter.update(state);
+}
+
 void GeniusGateway::_emitAlarmState()
 {
     /* Prepare event data (payload) */
     JsonDocument doc;
     JsonObject root = doc.to<JsonObject>();
     root["isAlarming"] = _gatewayDevices.isAlarming();
+    root["numAlarmingDevices"] = _gatewayDevices.numAlarmingDevices();
 
     /* Emit event */
-    _eventSocket->emitEvent(GATEWAY_EVENT_ALARM, root);
-}
-
-void GeniusGateway::_mqttPublishDevices(bool onlyState)
-{
-    if (!_mqttClient->connected())
-    {
-        return;
-    }
-
-    GatewayMqttSettings mqttSettings = _gatewayMqttSettingsService.getSettingsCopy(); // Explicit deep copy for thread safety
-
-    // Get optimized MQTT data - only the minimal properties needed for publishing,
-    // thread-safe and performance optimized
-    std::vector<DeviceMqttData> devicesMqttData = _gatewayDevices.getDevicesMqttData();
-    if (devicesMqttData.empty())
-    {
-        ESP_LOGV(TAG, "No pending devices, skipping MQTT publish.");
-        return;
-    }
-
-    /* Publish Home Assistant compatible topics */
-    if (mqttSettings.haMQTTEnabled)
-    {
-        if (mqttSettings.haMQTTTopicPrefix.isEmpty())
-        {
-            ESP_LOGW(TAG, "Home Assistant MQTT topic prefix is empty. Cannot publish config topic.");
-        }
-        else
-        {
-            for (const auto &deviceData : devicesMqttData) // Now thread safe and lightweight
-            {
-                /* Publish config topic for device discovery */
-                if (!onlyState)
-                {
-                    String configTopic = mqttSettings.haMQTTTopicPrefix + deviceData.smokeDetectorSN + "/config";
-
-                    JsonDocument config_jsonDoc;
-                    config_jsonDoc["~"] = mqttSettings.haMQTTTopicPrefix + deviceData.smokeDetectorSN;
-                    config_jsonDoc["name"] = "Genius Plus X";
-                    config_jsonDoc["unique_id"] = deviceData.smokeDetectorSN;
-                    config_jsonDoc["device_class"] = "smoke";
-                    config_jsonDoc["state_topic"] = "~/state";
-                    config_jsonDoc["schema"] = "json";
-                    config_jsonDoc["value_template"] = "{{value_json.state}}";
-                    // Get the current IP address and only add entity_picture if we have a valid IP
-                    IPAddress localIP = WiFi.localIP();
-                    if (IPUtils::isSet(localIP))
-                    {
-                        config_jsonDoc["entity_picture"] = "http://" + localIP.toString() + "/hekatron-genius-plus-x.png";
-                    }
-                    JsonObject dev_jsonObj = config_jsonDoc["device"].to<JsonObject>();
-                    dev_jsonObj["identifiers"] = deviceData.smokeDetectorSN;
-                    dev_jsonObj["manufacturer"] = "Hekatron Vertriebs GmbH";
-                    dev_jsonObj["model"] = "Genius Plus X";
-                    dev_jsonObj["name"] = "Rauchmelder";
-                    dev_jsonObj["serial_number"] = deviceData.smokeDetectorSN;
-                    dev_jsonObj["suggested_area"] = deviceData.location;
-                    
-                    // Add attributes topic for entity attributes
-                    config_jsonDoc["json_attributes_topic"] = "~/attributes";
-
-                    String config_payload;
-                    serializeJson(config_jsonDoc, config_payload);
-                    _mqttClient->publish(configTopic.c_str(), 0, true, config_payload.c_str());
-                }
-
-                /* Publish attributes topic with additional device metadata */
-                if (!onlyState)
-                {
-                    String attrTopic = mqttSettings.haMQTTTopicPrefix + deviceData.smokeDetectorSN + "/attributes";
-                    JsonDocument attr_jsonDoc;
-                    
-                    // Add production date in dd.mm.yy format
-                    if (deviceData.smokeDetectorProdDate > 0) {
-                        struct tm *tm = gmtime(&deviceData.smokeDetectorProdDate);
-                        char dateBuf[9];
-                        strftime(dateBuf, sizeof(dateBuf), "%d.%m.%y", tm);
-                        attr_jsonDoc["Production Date"] = String(dateBuf);
-                    }
-                    
-                    // Add radio module information as flat attributes for better rendering
-                    if (deviceData.radioModuleSN > 0) {
-                        attr_jsonDoc["FM Basis X - Serial"] = String(deviceData.radioModuleSN);
-                        
-                        if (deviceData.radioModuleProdDate > 0) {
-                            struct tm *tm = gmtime(&deviceData.radioModuleProdDate);
-                            char dateBuf[9];
-                            strftime(dateBuf, sizeof(dateBuf), "%d.%m.%y", tm);
-                            attr_jsonDoc["FM Basis X - Production Date"] = String(dateBuf);
-                        }
-                    }
-                    
-                    String attr_payload;
-                    serializeJson(attr_jsonDoc, attr_payload);
-                    _mqttClient->publish(attrTopic.c_str(), 0, true, attr_payload.c_str());
-                }
-
-                /* Pubish state topic */
-                String stateTopic = mqttSettings.haMQTTTopicPrefix + deviceData.smokeDetectorSN + "/state";
-
-                JsonDocument state_jsonDoc;
-                state_jsonDoc["state"] = deviceData.isAlarming ? "ON" : "OFF";
-
-                String payload;
-                serializeJson(state_jsonDoc, payload);
-                _mqttClient->publish(stateTopic.c_str(), 0, true, payload.c_str());
-
-                // Set device as published
-                _gatewayDevices.setPublished(deviceData.smokeDetectorSN);
-            }
-        }
-    }
-
-    /* Publish generic alarming topic */
-    if (mqttSettings.alarmEnabled)
-    {
-        if (mqttSettings.alarmTopic.isEmpty())
-        {
-            ESP_LOGW(TAG, "Alarm MQTT topic is empty. Cannot publish alarming state.");
-        }
-        else
-        {
-            JsonDocument alarming_jsonDoc;
-            bool isAlarming = _gatewayDevices.isAlarming();
-            alarming_jsonDoc["isAlarming"] = isAlarming;
-            alarming_jsonDoc["numAlarmingDevices"] = _gatewayDevices.numAlarmingDevices();
-
-            String payload;
-            serializeJson(alarming_jsonDoc, payload);
-            _mqttClient->publish(mqttSettings.alarmTopic.c_str(), 0, true, payload.c_str());
-        }
-    }
+    _eventSocket->emitEvent(_alarmEvent, root);
 }
 
 esp_err_t GeniusGateway::_genius_analyze_packet_data(uint8_t *packet_data, size_t data_length, genius_packet_t *analyzed_packet)
@@ -469,18 +353,21 @@ void GeniusGateway::_rx_packets()
                     }
                 }
 
+                genius_packet_t packet_details;
+                esp_err_t analyzeResult = _genius_analyze_packet_data(packet.data, packet.length, &packet_details);
+
                 // Only process packet if it's not a duplicate, i.e. repeated packet
                 if (!isDuplicate)
                 {
-                    genius_packet_t packet_details;
-                    if (_genius_analyze_packet_data(packet.data, packet.length, &packet_details) == ESP_OK)
+                    if (analyzeResult == ESP_OK)
                     {
                         if (packet_details.type == HPT_COMMISSIONING)
                         {
                             /* Store new alarm line id */
-                            if (_gatewaySettings.isAddAlarmLineFromCommissioningPacketEnabled())
+                            uint32_t newLineID = EXTRACT32(packet.data, DATAPOS_COMISSIONING_NEW_LINE_ID);
+                            if (_gatewaySettings.isAddAlarmLineFromCommissioningPacketEnabled() &&
+                                !_alarmLines.isKnownAlarmLine(newLineID))
                             {
-                                uint32_t newLineID = EXTRACT32(packet.data, DATAPOS_COMISSIONING_NEW_LINE_ID);
                                 snprintf(lineName, sizeof(lineName), "Added from received comissioning packet", newLineID);
                                 _alarmLines.addAlarmLine(newLineID, String(lineName), ALA_GENIUS_PACKET);
                             }
@@ -506,25 +393,26 @@ void GeniusGateway::_rx_packets()
                                     /* Set/Reset alarm */
                                     if (isDetectorKnown)
                                     {
-                                        const GeniusDevice *dev = _gatewayDevices.setAlarm(source_id);
+                                        const GeniusDevice *dev = _gatewayDevices.setAlarm(source_id, packet_details.line_id);
                                         if (dev)
-                                            _mqttPublishDevices(!deviceAdded);
+                                            _mqttPublisher.requestPublish(!deviceAdded);
                                     }
                                 }
                                 else // packet_details.type == HPT_ALARM_SILENCING
                                 {
                                     const GeniusDevice *dev = _gatewayDevices.resetAlarm(source_id, GAE_BY_SMOKE_DETECTOR);
                                     if (dev)
-                                        _mqttPublishDevices(true);
+                                        _mqttPublisher.requestPublish(true);
                                 }
 
-                                /* Emit alarm state to front end */
-                                _emitAlarmState(); // TODO: Is this necessary on every single packet???
+                                /* Emit alarm state to front end (only if it changed, repeated packets are suppressed) */
+                                _updateAlarmState();
 
                                 /* Store alarm line id */
-                                if (_gatewaySettings.isAddAlarmLineFromAlarmPacketEnabled())
+                                uint32_t lineID = EXTRACT32(packet.data, DATAPOS_GENERAL_LINE_ID);
+                                if (_gatewaySettings.isAddAlarmLineFromAlarmPacketEnabled() &&
+                                    !_alarmLines.isKnownAlarmLine(lineID))
                                 {
-                                    uint32_t lineID = EXTRACT32(packet.data, DATAPOS_GENERAL_LINE_ID);
                                     snprintf(lineName, sizeof(lineName), "Added from received alarming/silencing packet", lineID);
                                     _alarmLines.addAlarmLine(lineID, String(lineName), ALA_GENIUS_PACKET);
                                 }
@@ -533,9 +421,10 @@ void GeniusGateway::_rx_packets()
                         else if (packet_details.type == HPT_LINE_TEST_START ||
                                  packet_details.type == HPT_LINE_TEST_STOP)
                         {
-                            if (_gatewaySettings.isAddAlarmLineFromLineTestPacketEnabled())
+                            uint32_t lineID = EXTRACT32(packet.data, DATAPOS_GENERAL_LINE_ID);
+                            if (_gatewaySettings.isAddAlarmLineFromLineTestPacketEnabled() &&
+                                !_alarmLines.isKnownAlarmLine(lineID))
                             {
-                                uint32_t lineID = EXTRACT32(packet.data, DATAPOS_GENERAL_LINE_ID);
                                 snprintf(lineName, sizeof(lineName), "Added from received line test packet", lineID);
                                 _alarmLines.addAlarmLine(lineID, String(lineName), ALA_GENIUS_PACKET);
                             }
@@ -543,9 +432,17 @@ void GeniusGateway::_rx_packets()
                     }
                 } // End of !isDuplicate check
 
-                /* Send data to WebSocket logger - log ALL packets including duplicates */
+                /* Send data to WebSocket logger - log ALL packets including duplicates, clients may filter them */
+                wslogger_packet_info_t loggerInfo = {WEB_SOCKET_LOGGER_PACKET_TYPE_UNKNOWN, 0, 0, 0, isDuplicate};
+                if (analyzeResult == ESP_OK)
+                {
+                    loggerInfo.type = static_cast<int8_t>(packet_details.type);
+                    loggerInfo.originId = packet_details.origin_id;
+                    loggerInfo.senderId = packet_details.sender_id;
+                    loggerInfo.lineId = packet_details.line_id;
+                }
                 gpio_set_level(static_cast<gpio_num_t>(GPIO_TEST2), 1); // Temporary: Measuring execution time
-                _wsLogger.logPacket(&packet);
+                _wsLogger.logPacket(&packet, &loggerInfo);
                 gpio_set_level(static_cast<gpio_num_t>(GPIO_TEST2), 0); // Temporary: Measuring execution time
             }
 
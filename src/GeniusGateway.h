@@ -36,9 +36,11 @@
 #include <AlarmLinesService.h>
 #include <GatewaySettingsService.h>
 #include <GatewayMqttSettingsService.h>
+#include <GatewayMqttPublisher.h>
 #include <CC1101Controller.h>
 #include <cc1101.h>
 #include <AlarmBlocker.h>
+#include <ThrottledEmitter.h>
 
 #define RX_TASK_STACK_SIZE 4096  ///< Stack size for RX task in bytes
 #define RX_TASK_PRIORITY 20      ///< Priority level for RX task
@@ -79,7 +81,7 @@
 
 #define GATEWAY_EVENT_ALARM "alarm" ///< WebSocket event name for alarm notifications
 
-#define GATEWAY_ALARM_STATE_EMIT_INTERVAL_MS 1000 ///< Alarm state emission interval (1 second)
+#define GATEWAY_ALARM_STATE_EMIT_INTERVAL_MS 1000 ///< Minimum interval between two alarm state emissions (1 second)
 
 #define GATEWAY_SERVICE_PATH_END_ALARMS "/rest/end-alarms"               ///< REST endpoint for ending alarms
 #define GATEWAY_SERVICE_PATH_END_ALARMBLOCKING "/rest/end-alarmblocking" ///< REST endpoint for ending alarm blocking
@@ -120,6 +122,7 @@ public:
 private:
   static constexpr const char *TAG = "GeniusGateway"; ///< Logging tag
 
+  ESP32SvelteKit *_sveltekit;                             ///< ESP32SvelteKit framework instance
   PsychicHttpServer *_server;                             ///< HTTP server instance
   SecurityManager *_securityManager;                      ///< Security manager instance
   EventSocket *_eventSocket;                              ///< WebSocket event manager
@@ -129,6 +132,7 @@ private:
   AlarmLinesService _alarmLines;                          ///< Alarm lines service
   GatewaySettingsService _gatewaySettings;                ///< Gateway settings service
   GatewayMqttSettingsService _gatewayMqttSettingsService; ///< MQTT settings service
+  GatewayMqttPublisher _mqttPublisher;                    ///< Asynchronous MQTT publisher
   WSLogger _wsLogger;                                     ///< WebSocket logger service
   VisualizerSettingsService _visualizerSettingsService;   ///< Visualizer settings service
   CC1101Controller _cc1101Controller;                     ///< CC1101 radio controller
@@ -137,15 +141,15 @@ private:
   uint32_t _lastPacketHash; ///< Hash of last received packet for duplicate detection
   bool _hasLastPacketHash;  ///< Flag indicating if last packet hash is valid
 
+  EventHandle _alarmEvent;             ///< Handle of the alarm WebSocket event
+  ThrottledEmitter _alarmStateEmitter; ///< Emits the alarm state on changes only, rate limited
+
   /// Handle REST request to end alarming for devices
   esp_err_t _handleEndAlarming(PsychicRequest *request, JsonVariant &json);
 
   /// Handle REST request to end alarm blocking
   esp_err_t _handleEndBlocking(PsychicRequest *request);
 
-  /// Publish device states to MQTT
-  void _mqttPublishDevices(bool onlyState = false);
-
   /// Main packet reception loop
   void _rx_packets();
 
@@ -155,6 +159,9 @@ private:
   /// Analyze received packet data and extract packet information
   esp_err_t _genius_analyze_packet_data(uint8_t *packet_data, size_t data_length, genius_packet_t *analyzed_packet);
 
+  /// Report a possible alarm state change, emitted via WebSocket if the state changed
+  void _updateAlarmState();
+
   /// Emit current alarm state via WebSocket
   void _emitAlarmState();
 };
@@ -0,0 +1,154 @@
+/**
+ * @file ThrottledEmitter.h
+ * @brief Change-driven, rate-limited emission of state events
+ * 
+ * @copyright Copyright (c) 2024-2025 Genius Gateway Project
+ * @license AGPL-3.0 with Commons Clause
+ * 
+ * This file is part of Genius Gateway.
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the Commons Clause restriction.
+ * 
+ * "Commons Clause" License Condition v1.0
+ * The Software is provided to you by the Licensor under the License,
+ * as defined below, subject to the following condition:
+ * Without limiting other conditions in the License, the grant of rights
+ * under the License will not include, and the License does not grant to you,
+ * the right to Sell the Software.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * 
+ * See https://github.com/hmbacher/genius-gateway/blob/main/LICENSE for details.
+ */
+
+
+#pragma once
+
+#include <ESP32SvelteKit.h>
+#include <ThreadSafeService.h>
+#include <functional>
+
+/**
+ * Emits a state (e.g. as WebSocket event) only when it changes, at most once per minimum interval
+ *
+ * The state is identified by a 32 bit value supplied by the caller. A change is emitted
+ * immediately if the minimum interval since the last emission has passed (leading edge),
+ * otherwise it is held back and emitted by loop() once the interval has passed (trailing edge).
+ * loop() is scheduled for exactly that point in time, it does not poll.
+ * Changes within the interval are coalesced, changes back to the emitted state are dropped.
+ * Forced updates (e.g. a switch the user waits for) bypass the interval and are emitted immediately.
+ */
+class ThrottledEmitter : public ThreadSafeService
+{
+public:
+    typedef std::function<void()> EmitFunction; ///< Reads the current state and emits it
+
+    ThrottledEmitter(uint32_t minIntervalMs, EmitFunction emit) : _minIntervalMs(minIntervalMs),
+                                                                  _emit(emit),
+                                                                  _sveltekit(nullptr),
+                                                                  _loopTask(0),
+                                                                  _hasEmitted(false),
+                                                                  _lastState(0),
+                                                                  _pendingState(0),
+                                                                  _isPending(false),
+                                                                  _lastEmitMs(0),
+                                                                  _numEmitted(0),
+                                                                  _numSuppressed(0)
+    {
+    }
+
+    /// Register the trailing edge check in the framework loop (run on request only)
+    void begin(ESP32SvelteKit *sveltekit, const char *name)
+    {
+        _sveltekit = sveltekit;
+        _loopTask = sveltekit->addLoopTask(name, std::bind(&ThrottledEmitter::loop, this), 0);
+    }
+
+    /// Report the current state, emitted if it differs from the last emitted one (immediately if forced)
+    void update(uint32_t state, bool force = false)
+    {
+        beginTransaction();
+        if (_isPending ? state == _pendingState : (_hasEmitted && state == _lastState))
+        {
+            _numSuppressed++;
+            endTransaction();
+            return;
+        }
+
+        if (_isPending)
+            _numSuppressed++; // The pending state is replaced without being emitted
+
+        _pendingState = state;
+        _isPending = true;
+        bool emitNow = _takePending(force);
+        endTransaction();
+
+        if (emitNow)
+            _emit();
+    }
+
+    /// Emit a pending state once the minimum interval has passed
+    void loop()
+    {
+        beginTransaction();
+        bool emitNow = _takePending();
+        endTransaction();
+
+        if (emitNow)
+            _emit();
+    }
+
+    uint32_t numEmitted() { return _numEmitted; }       ///< Number of emitted states
+    uint32_t numSuppressed() { return _numSuppressed; } ///< Number of unchanged or coalesced states
+
+private:
+    uint32_t _minIntervalMs;    ///< Minimum interval between two emissions
+    EmitFunction _emit;         ///< Function emitting the current state
+    ESP32SvelteKit *_sveltekit; ///< Framework instance running the trailing edge check
+    loop_task_id_t _loopTask;   ///< Loop task of the trailing edge check
+
+    bool _hasEmitted;        ///< A state has been emitted before
+    uint32_t _lastState;     ///< Last emitted state
+    uint32_t _pendingState;  ///< State waiting for emission
+    bool _isPending;         ///< A state is waiting for emission
+    uint32_t _lastEmitMs;    ///< Time of the last emission (ms)
+    uint32_t _numEmitted;    ///< Number of emitted states
+    uint32_t _numSuppressed; ///< Number of unchanged or coalesced states
+
+    /// Check whether the pending state is due (or forced) and mark it as emitted (must be called within transaction)
+    bool _takePending(bool force = false)
+    {
+        if (!_isPending)
+            return false;
+
+        // Changed back to the emitted state in the meantime
+        if (_hasEmitted && _pendingState == _lastState)
+        {
+            _isPending = false;
+            _numSuppressed++;
+            return false;
+        }
+
+        uint32_t now = millis();
+        if (!force && _hasEmitted && now - _lastEmitMs < _minIntervalMs)
+        {
+            // Emit on the trailing edge
+            if (_sveltekit)
+                _sveltekit->runLoopTaskSoon(_loopTask, _minIntervalMs - (now - _lastEmitMs));
+            return false;
+        }
+
+        _lastState = _pendingState;
+        _isPending = false;
+        _hasEmitted = true;
+        _lastEmitMs = now;
+        _numEmitted++;
+        return true;
+    }
+};
@@ -29,28 +29,174 @@
 
 #include <Utils.hpp>
 
-time_t Utils::iso8601_to_time_t(const String &iso8601_date)
+namespace
 {
-    struct tm tm = {0};
-    int millis = 0; // Ignore milliseconds
-    if (sscanf(iso8601_date.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d.%3dZ",
-               &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
-               &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &millis) != 7)
+    constexpr int64_t SECONDS_PER_DAY = 86400;
+
+    /// Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant's days_from_civil)
+    inline int64_t daysFromCivil(int64_t y, uint32_t m, uint32_t d)
+    {
+        y -= m <= 2;
+        const int64_t era = (y >= 0 ? y : y - 399) / 400;
+        const uint32_t yoe = static_cast<uint32_t>(y - era * 400);           // [0, 399]
+        const uint32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1; // [0, 365]
+        const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;          // [0, 146096]
+        return era * 146097 + static_cast<int64_t>(doe) - 719468;
+    }
+
+    /// Proleptic Gregorian date for days since 1970-01-01 (H. Hinnant's civil_from_days)
+    inline void civilFromDays(int64_t z, int32_t &y, uint8_t &m, uint8_t &d)
+    {
+        z += 719468;
+        const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+        const uint32_t doe = static_cast<uint32_t>(z - era * 146097);                 // [0, 146096]
+        const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;   // [0, 399]
+        const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);                 // [0, 365]
+        const uint32_t mp = (5 * doy + 2) / 153;                                      // [0, 11]
+        d = static_cast<uint8_t>(doy - (153 * mp + 2) / 5 + 1);                      // [1, 31]
+        m = static_cast<uint8_t>(mp < 10 ? mp + 3 : mp - 9);                          // [1, 12]
+        y = static_cast<int32_t>(static_cast<int64_t>(yoe) + era * 400 + (m <= 2));
+    }
+
+    inline bool isLeapYear(int32_t y)
+    {
+        return (y % 4 == 0) && (y % 100 != 0 || y % 400 == 0);
+    }
+
+    inline uint8_t daysInMonth(int32_t y, uint8_t m)
+    {
+        static const uint8_t days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        return (m == 2 && isLeapYear(y)) ? 29 : days[m - 1];
+    }
+
+    /// Parse exactly `n` decimal digits starting at `p`, returns -1 on any non-digit
+    inline int32_t parseDigits(const char *p, size_t n)
     {
+        int32_t value = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            uint32_t digit = static_cast<uint8_t>(p[i]) - '0';
+            if (digit > 9)
+                return -1;
+            value = value * 10 + static_cast<int32_t>(digit);
+        }
+        return value;
+    }
+
+    inline void writeTwoDigits(char *p, uint32_t value)
+    {
+        p[0] = static_cast<char>('0' + value / 10);
+        p[1] = static_cast<char>('0' + value % 10);
+    }
+}
+
+time_t Utils::iso8601_to_time_t(std::string_view iso8601_date)
+{
+    // Minimum layout: "YYYY-MM-DDTHH:MM:SS" (19 chars)
+    const size_t len = iso8601_date.size();
+    if (len < 19)
+        return -1;
+
+    const char *s = iso8601_date.data();
+    if (s[4] != '-' || s[7] != '-' || s[10] != 'T' || s[13] != ':' || s[16] != ':')
         return -1;
+
+    CivilTime civil;
+    int32_t year = parseDigits(s, 4);
+    int32_t month = parseDigits(s + 5, 2);
+    int32_t day = parseDigits(s + 8, 2);
+    int32_t hour = parseDigits(s + 11, 2);
+    int32_t minute = parseDigits(s + 14, 2);
+    int32_t second = parseDigits(s + 17, 2);
+
+    if (year < 0 || month < 1 || month > 12 || day < 1 ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 59)
+        return -1;
+
+    if (day > daysInMonth(year, static_cast<uint8_t>(month)))
+        return -1;
+
+    // Optional fractional seconds (ignored) and optional UTC designator
+    size_t pos = 19;
+    if (pos < len && s[pos] == '.')
+    {
+        size_t fracStart = ++pos;
+        while (pos < len && static_cast<uint32_t>(static_cast<uint8_t>(s[pos]) - '0') <= 9)
+            pos++;
+        if (pos == fracStart)
+            return -1;
     }
-    tm.tm_year -= 1900; // Adjust year
-    tm.tm_mon -= 1;     // Adjust month (0-based)
-    return mktime(&tm);
+    if (pos < len && s[pos] == 'Z')
+        pos++;
+    if (pos != len)
+        return -1;
+
+    civil.year = year;
+    civil.month = static_cast<uint8_t>(month);
+    civil.day = static_cast<uint8_t>(day);
+    civil.hour = static_cast<uint8_t>(hour);
+    civil.minute = static_cast<uint8_t>(minute);
+    civil.second = static_cast<uint8_t>(second);
+
+    return civil_to_time_t(civil);
+}
+
+size_t Utils::time_t_to_iso8601(time_t time_s, char *buf, size_t bufSize)
+{
+    if (!buf || bufSize == 0)
+        return 0;
+
+    buf[0] = '\0';
+    if (bufSize < ISO8601_BUFFER_SIZE)
+        return 0;
+
+    CivilTime civil;
+    time_t_to_civil(time_s, civil);
+    if (civil.year < 0 || civil.year > 9999)
+        return 0;
+
+    // Layout: "YYYY-MM-DDTHH:MM:SS.000Z"
+    writeTwoDigits(buf, static_cast<uint32_t>(civil.year) / 100);
+    writeTwoDigits(buf + 2, static_cast<uint32_t>(civil.year) % 100);
+    buf[4] = '-';
+    writeTwoDigits(buf + 5, civil.month);
+    buf[7] = '-';
+    writeTwoDigits(buf + 8, civil.day);
+    buf[10] = 'T';
+    writeTwoDigits(buf + 11, civil.hour);
+    buf[13] = ':';
+    writeTwoDigits(buf + 14, civil.minute);
+    buf[16] = ':';
+    writeTwoDigits(buf + 17, civil.second);
+    memcpy(buf + 19, ".000Z", 6); // includes null terminator
+
+    return ISO8601_BUFFER_SIZE - 1;
+}
+
+void Utils::time_t_to_civil(time_t time_s, CivilTime &civil)
+{
+    int64_t t = static_cast<int64_t>(time_s);
+    int64_t days = t / SECONDS_PER_DAY;
+    int64_t secs = t % SECONDS_PER_DAY;
+    if (secs < 0) // Floor division for dates before 1970
+    {
+        secs += SECONDS_PER_DAY;
+        days--;
+    }
+
+    civilFromDays(days, civil.year, civil.month, civil.day);
+
+    uint32_t sod = static_cast<uint32_t>(secs);
+    civil.hour = static_cast<uint8_t>(sod / 3600);
+    civil.minute = static_cast<uint8_t>((sod / 60) % 60);
+    civil.second = static_cast<uint8_t>(sod % 60);
 }
 
-String Utils::time_t_to_iso8601(time_t time_s)
+time_t Utils::civil_to_time_t(const CivilTime &civil)
 {
-    struct tm *tm = gmtime(&time_s);
-    // Buffer size for ISO8601 format: "YYYY-MM-DDTHH:MM:SS.000Z" = 24 chars + null terminator
-    char buf[25];
-    strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S.000Z", tm);
-    return String(buf);
+    int64_t days = daysFromCivil(civil.year, civil.month, civil.day);
+    return static_cast<time_t>(days * SECONDS_PER_DAY +
+                               civil.hour * 3600 + civil.minute * 60 + civil.second);
 }
 
 uint32_t Utils::xorHash(const uint8_t *data, size_t length)
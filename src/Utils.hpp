@@ -33,24 +33,73 @@
 #include <Arduino.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string_view>
 
 /// Utility class providing time conversion and hashing functions
 class Utils
 {
 public:
+    /// Buffer size for ISO 8601 date strings "YYYY-MM-DDTHH:MM:SS.000Z" (24 chars + null terminator)
+    static constexpr size_t ISO8601_BUFFER_SIZE = 25;
+
+    /// Broken-down UTC calendar time (proleptic Gregorian calendar)
+    struct CivilTime
+    {
+        int32_t year;   ///< Full year (e.g. 2025)
+        uint8_t month;  ///< Month of year [1, 12]
+        uint8_t day;    ///< Day of month [1, 31]
+        uint8_t hour;   ///< Hour of day [0, 23]
+        uint8_t minute; ///< Minute of hour [0, 59]
+        uint8_t second; ///< Second of minute [0, 59]
+    };
+
     /**
      * @brief Convert an ISO 8601 date string to time_t
-     * @param iso8601_date A String representing the date in ISO 8601 format (e.g., "2025-03-20T15:30:00.000Z")
+     * @details Parses "YYYY-MM-DDTHH:MM:SS" with an optional fractional part and an optional
+     *          trailing 'Z'. The date is always interpreted as UTC, independent of the TZ
+     *          environment. Neither allocates nor calls into the C library.
+     * @param iso8601_date The date in ISO 8601 format (e.g., "2025-03-20T15:30:00.000Z")
      * @return A `time_t` value representing the date in seconds (Unix Epoch), or -1 if the conversion fails
      */
-    static time_t iso8601_to_time_t(const String &iso8601_date);
+    static time_t iso8601_to_time_t(std::string_view iso8601_date);
+
+    /// @copydoc iso8601_to_time_t(std::string_view)
+    /// @note A null pointer (e.g. a missing JSON member) is treated as a failed conversion
+    static time_t iso8601_to_time_t(const char *iso8601_date)
+    {
+        return iso8601_date ? iso8601_to_time_t(std::string_view(iso8601_date)) : -1;
+    }
+
+    /// @copydoc iso8601_to_time_t(std::string_view)
+    static time_t iso8601_to_time_t(const String &iso8601_date)
+    {
+        return iso8601_to_time_t(std::string_view(iso8601_date.c_str(), iso8601_date.length()));
+    }
 
     /**
      * @brief Convert a time_t value to an ISO 8601 date string
-     * @param time The time_t value in seconds to convert
-     * @return A String representing the date in ISO 8601 format
+     * @details Writes "YYYY-MM-DDTHH:MM:SS.000Z" (UTC) into the caller-provided buffer.
+     * @param time_s The time_t value in seconds to convert
+     * @param buf Destination buffer, should be at least ISO8601_BUFFER_SIZE bytes
+     * @param bufSize Size of the destination buffer in bytes
+     * @return Number of characters written (excluding null terminator), or 0 if the buffer is
+     *         too small or the year is outside [0, 9999]. The buffer is null terminated whenever bufSize > 0.
+     */
+    static size_t time_t_to_iso8601(time_t time_s, char *buf, size_t bufSize);
+
+    /**
+     * @brief Split a time_t value into its UTC calendar fields
+     * @param time_s The time_t value in seconds to convert
+     * @param civil Destination for the calendar fields
+     */
+    static void time_t_to_civil(time_t time_s, CivilTime &civil);
+
+    /**
+     * @brief Convert UTC calendar fields to a time_t value
+     * @param civil Calendar fields (not range checked)
+     * @return Seconds since Unix Epoch
      */
-    static String time_t_to_iso8601(time_t time_s);
+    static time_t civil_to_time_t(const CivilTime &civil);
 
     /**
      * @brief Optimized XOR hash calculation for any data alignment
@@ -26,10 +26,43 @@
 /// See https://github.com/hmbacher/genius-gateway/blob/main/LICENSE for details.
 
 #include <WSLogger.h>
+#include <algorithm>
+#include <esp_heap_caps.h>
 
-WSLogger::WSLogger(ESP32SvelteKit *sveltekit) : _server(sveltekit->getServer()),
+bool wslogger_filter::matches(const wslogger_packet_info_t *info, int8_t rssiRaw)
+{
+    if (info->isDuplicate && !duplicates)
+        return false;
+
+    if (typeMask != 0 && !(typeMask & (1UL << (info->type + 1))))
+        return false;
+
+    if (hasMinRssi && rssiRaw < minRssiRaw)
+        return false;
+
+    if (!origins.empty() && !std::binary_search(origins.begin(), origins.end(), info->originId))
+        return false;
+
+    if (!senders.empty() && !std::binary_search(senders.begin(), senders.end(), info->senderId))
+        return false;
+
+    if (!lines.empty() && !std::binary_search(lines.begin(), lines.end(), info->lineId))
+        return false;
+
+    // Sampling: pass the first of every sampleRate matching packets
+    return (sampleCounter++ % sampleRate) == 0;
+}
+
+WSLogger::WSLogger(ESP32SvelteKit *sveltekit) : _sveltekit(sveltekit),
+                                                _server(sveltekit->getServer()),
                                                 _securityManager(sveltekit->getSecurityManager()),
-                                                _settings(sveltekit)
+                                                _settings(sveltekit),
+                                                _flushTask(0),
+                                                _batch{nullptr, 0},
+                                                _history(nullptr),
+                                                _historyCapacity(0),
+                                                _historyWritten(0),
+                                                _historyLock(portMUX_INITIALIZER_UNLOCKED)
 {
 }
 
@@ -38,6 +71,32 @@ void WSLogger::begin()
     // Initialize/Load settings
     _settings.begin();
 
+    // Send batched packets when due, the task is scheduled whenever a batch is started
+    _flushTask = _sveltekit->addLoopTask("wslogger-flush", std::bind(&WSLogger::loop, this), 0);
+
+    // Allocate the packet history once, so recording never allocates
+    if (psramFound())
+    {
+        _history = static_cast<wslogger_history_record_t *>(heap_caps_malloc(WEB_SOCKET_LOGGER_HISTORY_SIZE_PSRAM * sizeof(wslogger_history_record_t), MALLOC_CAP_SPIRAM));
+        if (_history)
+            _historyCapacity = WEB_SOCKET_LOGGER_HISTORY_SIZE_PSRAM;
+    }
+    if (!_history)
+    {
+        _history = static_cast<wslogger_history_record_t *>(heap_caps_malloc(WEB_SOCKET_LOGGER_HISTORY_SIZE_INTERNAL * sizeof(wslogger_history_record_t), MALLOC_CAP_8BIT));
+        if (_history)
+            _historyCapacity = WEB_SOCKET_LOGGER_HISTORY_SIZE_INTERNAL;
+    }
+    if (!_history)
+        ESP_LOGE(WSLogger::TAG, "Failed to allocate packet history.");
+    else
+        ESP_LOGI(WSLogger::TAG, "Packet history holds %u packets (%s).", _historyCapacity, psramFound() ? "PSRAM" : "internal RAM");
+
+    _server->on(WEB_SOCKET_LOGGER_HISTORY_PATH,
+                HTTP_GET,
+                _securityManager->wrapRequest(std::bind(&WSLogger::_handleGetHistory, this, std::placeholders::_1),
+                                              AuthenticationPredicates::IS_AUTHENTICATED));
+
     // Check if connection is allowed
     _webSocket.setFilter([this](PsychicRequest *request) -> bool
                          {
@@ -61,23 +120,31 @@ void WSLogger::begin()
     _webSocket.onOpen([this](PsychicWebSocketClient *client)
                       {
         transmitId(client);
+        _streamHistory(client);
 
         ESP_LOGI(WSLogger::TAG, "ws[%s][%u] connect", client->remoteIP().toString().c_str(), client->socket());
         ESP_LOGV(WSLogger::TAG, "Number of connected clients: %d", _webSocket.count()); });
 
     // Registering event handler for WebSocket event OnClose
     _webSocket.onClose([this](PsychicWebSocketClient *client)
-                       { ESP_LOGI(WSLogger::TAG, "ws[%s][%u] disconnect", client->remoteIP().toString().c_str(), client->socket()); });
+                       {
+        // Drop the filter and whatever was batched or held back for the client
+        beginTransaction();
+        _filteredClients.erase(client->socket());
+        _historyPending.erase(client->socket());
+        endTransaction();
+
+        ESP_LOGI(WSLogger::TAG, "ws[%s][%u] disconnect", client->remoteIP().toString().c_str(), client->socket()); });
 
     // Registering event handler for WebSocket event OnFrame
     _webSocket.onFrame([this](PsychicWebSocketRequest *request, httpd_ws_frame *frame) -> esp_err_t
                        {
         ESP_LOGV(WSLogger::TAG, "ws[%s][%u] opcode[%d]", request->client()->remoteIP().toString().c_str(), request->client()->socket(), frame->type);
 
-        if (frame->type == HTTPD_WS_TYPE_BINARY)
-        {
-            ESP_LOGV(WSLogger::TAG, "ws[%s][%u] request: %s", request->client()->remoteIP().toString().c_str(), request->client()->socket(), (char *)frame->payload);
-        }
+        // Clients may only send filter frames
+        if (frame->type == HTTPD_WS_TYPE_TEXT)
+            return _handleFilterFrame(request->client(), frame);
+
         return ESP_OK; });
 
     // Register the WebSocket handler at the web server
@@ -91,12 +158,432 @@ String WSLogger::clientId(PsychicWebSocketClient *client)
     return WEB_SOCKET_LOGGER_ORIGIN_CLIENT_ID_PREFIX + String(client->socket());
 }
 
-void WSLogger::logPacket(cc1101_packet_t *packet)
+void WSLogger::logPacket(cc1101_packet_t *packet, const wslogger_packet_info_t *info)
+{
+    // Status bytes appended by CC1101 follow the packet data: RSSI, LQI (bits 0-6) and CRC_OK (bit 7)
+    uint8_t lqiCrc = packet->buffer[packet->length + 2];
+
+    wslogger_record_header_t record;
+    record.timestampDelta = 0;
+    record.length = static_cast<uint8_t>(packet->length);
+    record.rssi = static_cast<int8_t>(packet->buffer[packet->length + 1]);
+    record.lqi = lqiCrc & 0x7F;
+    record.flags = (lqiCrc & 0x80) ? WEB_SOCKET_LOGGER_FLAG_CRC_OK : 0;
+
+    // Packets are kept in the history, even if no client is connected
+    _recordHistory(&record, packet->data, packet->timestamp);
+
+    if (!_settings.isEnabled() || _webSocket.count() == 0)
+        return;
+
+    beginTransaction();
+
+    // Clients without filter share one frame
+    if (_webSocket.count() > _filteredClients.size())
+        _appendRecord(_batch, -1, &record, packet->data, packet->timestamp);
+
+    // Filters are evaluated before anything is serialized for the client
+    for (auto &filtered : _filteredClients)
+    {
+        if (filtered.second.filter.matches(info, record.rssi))
+            _appendRecord(filtered.second.batch, filtered.first, &record, packet->data, packet->timestamp);
+    }
+
+    endTransaction();
+}
+
+void WSLogger::loop()
+{
+    int64_t now = esp_timer_get_time();
+    int64_t nextDue = INT64_MAX;
+
+    beginTransaction();
+
+    if (_batch.frame && now - _batch.startTime >= WEB_SOCKET_LOGGER_FLUSH_INTERVAL_US)
+        _flushBatch(_batch, -1);
+    else if (_batch.frame)
+        nextDue = _batch.startTime + WEB_SOCKET_LOGGER_FLUSH_INTERVAL_US;
+
+    for (auto &filtered : _filteredClients)
+    {
+        wslogger_batch_t &batch = filtered.second.batch;
+        if (batch.frame && now - batch.startTime >= WEB_SOCKET_LOGGER_FLUSH_INTERVAL_US)
+            _flushBatch(batch, filtered.first);
+        else if (batch.frame)
+            nextDue = std::min(nextDue, batch.startTime + WEB_SOCKET_LOGGER_FLUSH_INTERVAL_US);
+    }
+
+    endTransaction();
+
+    // Come back for the batches that are not due yet
+    if (nextDue != INT64_MAX)
+        _sveltekit->runLoopTaskSoon(_flushTask, (nextDue - now + 999) / 1000);
+}
+
+void WSLogger::_appendRecord(wslogger_batch_t &batch, int socket, const wslogger_record_header_t *record, const uint8_t *data, uint64_t timestamp)
+{
+    size_t recordSize = sizeof(wslogger_record_header_t) + record->length;
+
+    // Send what has been batched so far, if the record does not fit anymore
+    if (batch.frame &&
+        (batch.frame->size() + recordSize > WEB_SOCKET_LOGGER_FRAME_MAX_SIZE ||
+         reinterpret_cast<wslogger_frame_header_t *>(batch.frame->data())->numRecords == UINT8_MAX))
+    {
+        _flushBatch(batch, socket);
+    }
+
+    if (!batch.frame)
+    {
+        batch.frame = std::make_shared<std::vector<uint8_t>>(sizeof(wslogger_frame_header_t));
+        batch.frame->reserve(WEB_SOCKET_LOGGER_FRAME_MAX_SIZE);
+        batch.startTime = esp_timer_get_time();
+        _sveltekit->runLoopTaskSoon(_flushTask, WEB_SOCKET_LOGGER_FLUSH_INTERVAL_US / 1000);
+
+        wslogger_frame_header_t *header = reinterpret_cast<wslogger_frame_header_t *>(batch.frame->data());
+        header->version = WEB_SOCKET_LOGGER_FORMAT_VERSION;
+        header->numRecords = 0;
+        header->flags = 0;
+        header->baseTimestamp = timestamp;
+    }
+
+    std::vector<uint8_t> &frame = *batch.frame;
+    size_t offset = frame.size();
+    frame.resize(offset + recordSize); // Capacity is reserved, no reallocation
+
+    wslogger_frame_header_t *header = reinterpret_cast<wslogger_frame_header_t *>(frame.data());
+    wslogger_record_header_t *frameRecord = reinterpret_cast<wslogger_record_header_t *>(&frame[offset]);
+    *frameRecord = *record;
+    frameRecord->timestampDelta = static_cast<uint32_t>(timestamp - header->baseTimestamp);
+    memcpy(&frame[offset + sizeof(wslogger_record_header_t)], data, record->length);
+
+    header->numRecords++;
+}
+
+void WSLogger::_flushBatch(wslogger_batch_t &batch, int socket)
+{
+    if (!batch.frame)
+        return;
+
+    // The frame is handed over to the client send queues as is, without copying
+    PsychicWebSocketPayload payload = batch.frame;
+    batch.frame = nullptr;
+
+    if (socket >= 0)
+    {
+        PsychicWebSocketClient *client = _webSocket.getClient(socket);
+        if (client)
+            _queueLive(client, payload);
+        return;
+    }
+
+    for (PsychicClient *c : _webSocket.getClientList())
+    {
+        if (_filteredClients.count(c->socket()) > 0)
+            continue;
+
+        PsychicWebSocketClient *client = _webSocket.getClient(c);
+        if (client)
+            _queueLive(client, payload);
+    }
+}
+
+void WSLogger::_queueLive(PsychicWebSocketClient *client, const PsychicWebSocketPayload &payload)
+{
+    auto pending = _historyPending.find(client->socket());
+    if (pending != _historyPending.end())
+        pending->second.push_back(payload);
+    else
+        client->queueMessage(HTTPD_WS_TYPE_BINARY, payload);
+}
+
+static bool parseIdSet(JsonVariant value, std::vector<uint32_t> &ids)
+{
+    ids.clear();
+    if (value.isNull())
+        return true;
+
+    JsonArray array = value.as<JsonArray>();
+    if (array.isNull() || array.size() > WEB_SOCKET_LOGGER_FILTER_MAX_IDS)
+        return false;
+
+    for (JsonVariant id : array)
+    {
+        if (!id.is<uint32_t>())
+            return false;
+        ids.push_back(id.as<uint32_t>());
+    }
+
+    std::sort(ids.begin(), ids.end());
+    return true;
+}
+
+bool WSLogger::_parseFilter(const char *json, size_t length, wslogger_filter_t &filter, bool &reset)
+{
+    JsonDocument doc;
+    if (deserializeJson(doc, json, length) != DeserializationError::Ok)
+        return false;
+
+    if (doc["type"] != "filter")
+        return false;
+
+    filter.typeMask = 0;
+    JsonVariant types = doc["packetTypes"];
+    if (!types.isNull())
+    {
+        JsonArray array = types.as<JsonArray>();
+        if (array.isNull() || array.size() > WEB_SOCKET_LOGGER_FILTER_MAX_IDS)
+            return false;
+
+        for (JsonVariant type : array)
+        {
+            if (!type.is<int>())
+                return false;
+            int value = type.as<int>();
+            if (value < WEB_SOCKET_LOGGER_PACKET_TYPE_UNKNOWN || value >= 31)
+                return false;
+            filter.typeMask |= 1UL << (value + 1);
+        }
+    }
+
+    if (!parseIdSet(doc["origins"], filter.origins) ||
+        !parseIdSet(doc["senders"], filter.senders) ||
+        !parseIdSet(doc["lines"], filter.lines))
+        return false;
+
+    // Threshold in dBm is converted to the raw CC1101 value: dBm = raw / 2 - 74
+    filter.hasMinRssi = doc["minRssi"].is<int>();
+    if (filter.hasMinRssi)
+    {
+        int minRaw = (doc["minRssi"].as<int>() + 74) * 2;
+        filter.minRssiRaw = static_cast<int16_t>(std::max(INT8_MIN, std::min(INT8_MAX + 1, minRaw)));
+    }
+
+    filter.duplicates = doc["duplicates"] | true;
+    filter.sampleRate = std::max(1, std::min(static_cast<int>(UINT16_MAX), doc["sample"] | 1));
+    filter.sampleCounter = 0;
+
+    reset = filter.typeMask == 0 && filter.origins.empty() && filter.senders.empty() && filter.lines.empty() &&
+            !filter.hasMinRssi && filter.duplicates && filter.sampleRate == 1;
+
+    return true;
+}
+
+esp_err_t WSLogger::_handleFilterFrame(PsychicWebSocketClient *client, httpd_ws_frame *frame)
 {
-    if (!_settings.isEnabled())
+    wslogger_filter_t filter;
+    bool reset = false;
+
+    if (frame->len > WEB_SOCKET_LOGGER_FILTER_MAX_FRAME_SIZE ||
+        !_parseFilter(reinterpret_cast<const char *>(frame->payload), frame->len, filter, reset))
+    {
+        ESP_LOGW(WSLogger::TAG, "ws[%s][%u] invalid filter frame", client->remoteIP().toString().c_str(), client->socket());
+        return client->sendMessage("{\"type\":\"filter\",\"success\":false}");
+    }
+
+    int socket = client->socket();
+
+    beginTransaction();
+
+    auto it = _filteredClients.find(socket);
+    if (it != _filteredClients.end())
+    {
+        // Send what has been batched with the previous filter
+        _flushBatch(it->second.batch, socket);
+        if (reset)
+            _filteredClients.erase(it);
+        else
+            it->second.filter = filter;
+    }
+    else if (!reset)
+    {
+        // The shared frame may already hold packets for this client
+        _flushBatch(_batch, -1);
+        _filteredClients[socket] = {filter, {nullptr, 0}};
+    }
+
+    endTransaction();
+
+    ESP_LOGI(WSLogger::TAG, "ws[%s][%u] filter %s", client->remoteIP().toString().c_str(), socket, reset ? "cleared" : "set");
+    return client->sendMessage(reset ? "{\"type\":\"filter\",\"success\":true,\"active\":false}"
+                                     : "{\"type\":\"filter\",\"success\":true,\"active\":true}");
+}
+
+void WSLogger::_recordHistory(const wslogger_record_header_t *record, const uint8_t *data, uint64_t timestamp)
+{
+    if (!_history || record->length > CC1101_MAX_PACKET_LEN)
+        return;
+
+    taskENTER_CRITICAL(&_historyLock);
+    wslogger_history_record_t *slot = &_history[_historyWritten % _historyCapacity];
+    slot->timestamp = timestamp;
+    slot->header = *record;
+    memcpy(slot->data, data, record->length);
+    _historyWritten++;
+    taskEXIT_CRITICAL(&_historyLock);
+}
+
+bool WSLogger::_readHistory(uint32_t sequence, wslogger_history_record_t &record)
+{
+    bool valid = false;
+
+    taskENTER_CRITICAL(&_historyLock);
+    if (sequence < _historyWritten && _historyWritten - sequence <= _historyCapacity)
+    {
+        const wslogger_history_record_t *slot = &_history[sequence % _historyCapacity];
+        record.timestamp = slot->timestamp;
+        record.header = slot->header;
+        memcpy(record.data, slot->data, slot->header.length);
+        valid = true;
+    }
+    taskEXIT_CRITICAL(&_historyLock);
+
+    return valid;
+}
+
+void WSLogger::_streamHistory(PsychicWebSocketClient *client)
+{
+    if (!_history)
         return;
 
-    _webSocket.sendAll(HTTPD_WS_TYPE_BINARY, packet, sizeof(cc1101_packet_t));
+    // Only take the snapshot under the lock, RX keeps batching while the history frames are built.
+    // Live frames flushed in the meantime are held back for the client, so it receives the history first.
+    beginTransaction();
+
+    // Packets in the shared frame being batched will still be sent live
+    uint64_t liveFrom = _batch.frame ? reinterpret_cast<wslogger_frame_header_t *>(_batch.frame->data())->baseTimestamp : UINT64_MAX;
+
+    taskENTER_CRITICAL(&_historyLock);
+    uint32_t end = _historyWritten;
+    taskEXIT_CRITICAL(&_historyLock);
+
+    _historyPending.emplace(client->socket(), std::vector<PsychicWebSocketPayload>());
+    endTransaction();
+
+    uint32_t start = end > _historyCapacity ? end - _historyCapacity : 0;
+
+    std::vector<PsychicWebSocketPayload> frames;
+    std::shared_ptr<std::vector<uint8_t>> frame;
+    size_t numFrames = 0;
+    size_t numRecords = 0;
+    wslogger_history_record_t record;
+
+    for (uint32_t sequence = start; sequence < end; sequence++)
+    {
+        if (!_readHistory(sequence, record) || record.timestamp >= liveFrom)
+            continue;
+
+        size_t recordSize = sizeof(wslogger_record_header_t) + record.header.length;
+        wslogger_frame_header_t *header = frame ? reinterpret_cast<wslogger_frame_header_t *>(frame->data()) : nullptr;
+
+        // Start a new frame if the record does not fit into the current one
+        if (header &&
+            (frame->size() + recordSize > WEB_SOCKET_LOGGER_HISTORY_FRAME_MAX_SIZE ||
+             header->numRecords == UINT8_MAX ||
+             record.timestamp - header->baseTimestamp > UINT32_MAX))
+        {
+            frames.push_back(frame);
+            frame = nullptr;
+            header = nullptr;
+        }
+
+        if (!frame)
+        {
+            frame = std::make_shared<std::vector<uint8_t>>(sizeof(wslogger_frame_header_t));
+            frame->reserve(WEB_SOCKET_LOGGER_HISTORY_FRAME_MAX_SIZE);
+            header = reinterpret_cast<wslogger_frame_header_t *>(frame->data());
+            header->version = WEB_SOCKET_LOGGER_FORMAT_VERSION;
+            header->numRecords = 0;
+            header->flags = WEB_SOCKET_LOGGER_FRAME_FLAG_HISTORY;
+            header->baseTimestamp = record.timestamp;
+        }
+
+        size_t offset = frame->size();
+        frame->resize(offset + recordSize);
+        header = reinterpret_cast<wslogger_frame_header_t *>(frame->data());
+
+        wslogger_record_header_t *frameRecord = reinterpret_cast<wslogger_record_header_t *>(&(*frame)[offset]);
+        *frameRecord = record.header;
+        frameRecord->timestampDelta = static_cast<uint32_t>(record.timestamp - header->baseTimestamp);
+        memcpy(&(*frame)[offset + sizeof(wslogger_record_header_t)], record.data, record.header.length);
+
+        header->numRecords++;
+        numRecords++;
+    }
+
+    if (frame)
+        frames.push_back(frame);
+    numFrames = frames.size();
+
+    // Queue the history ahead of the live frames held back while it was built
+    beginTransaction();
+    for (const PsychicWebSocketPayload &historyFrame : frames)
+        client->queueMessage(HTTPD_WS_TYPE_BINARY, historyFrame);
+
+    auto pending = _historyPending.find(client->socket());
+    if (pending != _historyPending.end())
+    {
+        for (const PsychicWebSocketPayload &liveFrame : pending->second)
+            client->queueMessage(HTTPD_WS_TYPE_BINARY, liveFrame);
+        _historyPending.erase(pending);
+    }
+    endTransaction();
+
+    ESP_LOGD(WSLogger::TAG, "ws[%s][%u] sent history: %u packets in %u frames", client->remoteIP().toString().c_str(), client->socket(), numRecords, numFrames);
+}
+
+esp_err_t WSLogger::_handleGetHistory(PsychicRequest *request)
+{
+    // Time range in microseconds since boot, as the timestamps of the stream
+    uint64_t from = request->hasParam("from") ? strtoull(request->getParam("from")->value().c_str(), nullptr, 10) : 0;
+    uint64_t to = request->hasParam("to") ? strtoull(request->getParam("to")->value().c_str(), nullptr, 10) : UINT64_MAX;
+    size_t limit = WEB_SOCKET_LOGGER_HISTORY_QUERY_MAX_RESULTS;
+    if (request->hasParam("limit"))
+        limit = std::min(limit, static_cast<size_t>(request->getParam("limit")->value().toInt()));
+
+    PsychicJsonResponse response = PsychicJsonResponse(request, false);
+    JsonObject json = response.getRoot();
+    json["capacity"] = _historyCapacity;
+    JsonArray packets = json["packets"].to<JsonArray>();
+
+    bool truncated = false;
+    size_t count = 0;
+    if (_history)
+    {
+        taskENTER_CRITICAL(&_historyLock);
+        uint32_t end = _historyWritten;
+        taskEXIT_CRITICAL(&_historyLock);
+        uint32_t start = end > _historyCapacity ? end - _historyCapacity : 0;
+
+        wslogger_history_record_t record;
+        char hex[CC1101_MAX_PACKET_LEN * 2 + 1];
+
+        for (uint32_t sequence = start; sequence < end; sequence++)
+        {
+            if (!_readHistory(sequence, record) || record.timestamp < from || record.timestamp > to)
+                continue;
+
+            if (count >= limit)
+            {
+                truncated = true;
+                break;
+            }
+            count++;
+
+            for (size_t i = 0; i < record.header.length; i++)
+                snprintf(&hex[i * 2], 3, "%02x", record.data[i]);
+            hex[record.header.length * 2] = '\0';
+
+            JsonObject packet = packets.add<JsonObject>();
+            packet["timestamp"] = record.timestamp;
+            packet["rssi"] = record.header.rssi / 2.0f - 74;
+            packet["lqi"] = record.header.lqi;
+            packet["crcOk"] = (record.header.flags & WEB_SOCKET_LOGGER_FLAG_CRC_OK) != 0;
+            packet["data"] = hex;
+        }
+    }
+    json["truncated"] = truncated;
+
+    return response.send();
 }
 
 void WSLogger::transmitId(PsychicWebSocketClient *client)
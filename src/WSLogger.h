@@ -29,14 +29,114 @@
 
 #include <ESP32SvelteKit.h>
 #include <WSLoggerSettingsService.h>
+#include <ThreadSafeService.h>
 #include <cc1101.h>
+#include <map>
+#include <memory>
+#include <vector>
 
-#define WEB_SOCKET_LOGGER_ORIGIN "wslogger"                   ///< WebSocket logger origin identifier
-#define WEB_SOCKET_LOGGER_ORIGIN_CLIENT_ID_PREFIX "wslogger:" ///< Client ID prefix for logger connections
-#define WEB_SOCKET_LOGGER_PATH "/ws/logger"                   ///< WebSocket endpoint path
+#define WEB_SOCKET_LOGGER_ORIGIN "wslogger"                     ///< WebSocket logger origin identifier
+#define WEB_SOCKET_LOGGER_ORIGIN_CLIENT_ID_PREFIX "wslogger:"   ///< Client ID prefix for logger connections
+#define WEB_SOCKET_LOGGER_PATH "/ws/logger"                     ///< WebSocket endpoint path
+#define WEB_SOCKET_LOGGER_HISTORY_PATH "/rest/wslogger/history" ///< REST endpoint for the packet history
+
+#define WEB_SOCKET_LOGGER_FORMAT_VERSION 1        ///< Version of the binary frame format
+#define WEB_SOCKET_LOGGER_FRAME_MAX_SIZE 1024     ///< Maximum size of a batched frame in bytes
+#define WEB_SOCKET_LOGGER_FLUSH_INTERVAL_US 50000 ///< Maximum time a packet is held back for batching (50 ms)
+
+#define WEB_SOCKET_LOGGER_FLAG_CRC_OK 0x01 ///< Record flag: CRC of the received packet was ok
+
+#define WEB_SOCKET_LOGGER_FRAME_FLAG_HISTORY 0x0001 ///< Frame flag: records are from the packet history, not live
+
+#define WEB_SOCKET_LOGGER_HISTORY_SIZE_PSRAM 512        ///< Packets kept in the history if PSRAM is available
+#define WEB_SOCKET_LOGGER_HISTORY_SIZE_INTERNAL 64      ///< Packets kept in the history in internal RAM
+#define WEB_SOCKET_LOGGER_HISTORY_FRAME_MAX_SIZE 4096   ///< Maximum size of a frame streaming the history
+#define WEB_SOCKET_LOGGER_HISTORY_QUERY_MAX_RESULTS 256 ///< Maximum number of packets returned by one REST query
+
+#define WEB_SOCKET_LOGGER_FILTER_MAX_FRAME_SIZE 1024 ///< Maximum size of a filter frame sent by a client
+#define WEB_SOCKET_LOGGER_FILTER_MAX_IDS 32          ///< Maximum number of IDs per filter set (types, origins, senders, lines)
+#define WEB_SOCKET_LOGGER_PACKET_TYPE_UNKNOWN -1     ///< Packet type of packets not recognized as genius packets
+
+/**
+ * Binary frame format (little endian), one frame carries one or more records:
+ *
+ *   Frame header:  version (u8), number of records (u8), flags (u16), base timestamp in us (u64)
+ *   Record:        timestamp delta to base in us (u32), length (u8), RSSI (i8, raw CC1101 value),
+ *                  LQI (u8), flags (u8), payload[length]
+ */
+typedef struct __attribute__((packed)) wslogger_frame_header
+{
+    uint8_t version;        ///< Frame format version (WEB_SOCKET_LOGGER_FORMAT_VERSION)
+    uint8_t numRecords;     ///< Number of records following the header
+    uint16_t flags;         ///< Frame flags (WEB_SOCKET_LOGGER_FRAME_FLAG_*), 0 for live packets
+    uint64_t baseTimestamp; ///< Timestamp of the first record in microseconds
+} wslogger_frame_header_t;
+
+typedef struct __attribute__((packed)) wslogger_record_header
+{
+    uint32_t timestampDelta; ///< Packet timestamp relative to the frame's base timestamp in microseconds
+    uint8_t length;          ///< Length of the payload following the record header
+    int8_t rssi;             ///< Raw RSSI value as appended by CC1101
+    uint8_t lqi;             ///< Link quality indicator as appended by CC1101
+    uint8_t flags;           ///< Record flags (WEB_SOCKET_LOGGER_FLAG_*)
+} wslogger_record_header_t;
+
+/// Packet kept in the history ring
+typedef struct __attribute__((packed)) wslogger_history_record
+{
+    uint64_t timestamp;                  ///< Packet timestamp in microseconds
+    wslogger_record_header_t header;     ///< Record as sent to clients (timestamp delta unused)
+    uint8_t data[CC1101_MAX_PACKET_LEN]; ///< Packet data
+} wslogger_history_record_t;
+
+/// Packet properties evaluated by the client filters
+typedef struct wslogger_packet_info
+{
+    int8_t type;        ///< Genius packet type (genius_packet_type_t), WEB_SOCKET_LOGGER_PACKET_TYPE_UNKNOWN if not recognized
+    uint32_t originId;  ///< Origin radio module ID (0 if unknown)
+    uint32_t senderId;  ///< Sender radio module ID (0 if unknown)
+    uint32_t lineId;    ///< Alarm line ID (0 if unknown)
+    bool isDuplicate;   ///< Packet is a repetition of the previous packet
+} wslogger_packet_info_t;
+
+/**
+ * Compiled per client packet filter
+ *
+ * Built from a filter frame sent by the client. Empty ID sets match everything,
+ * non-empty sets are kept sorted for binary search.
+ */
+typedef struct wslogger_filter
+{
+    uint32_t typeMask;              ///< Bit (type + 1) set for each accepted packet type, 0 accepts all
+    std::vector<uint32_t> origins;  ///< Accepted origin radio module IDs (sorted)
+    std::vector<uint32_t> senders;  ///< Accepted sender radio module IDs (sorted)
+    std::vector<uint32_t> lines;    ///< Accepted alarm line IDs (sorted)
+    bool hasMinRssi;                ///< RSSI threshold is set
+    int16_t minRssiRaw;             ///< Minimum raw CC1101 RSSI value
+    bool duplicates;                ///< Duplicate packets are accepted
+    uint16_t sampleRate;            ///< Only every Nth matching packet is sent (1 = all)
+    uint32_t sampleCounter;         ///< Number of matching packets so far
+
+    /// Check whether a packet passes the filter (advances the sample counter on match)
+    bool matches(const wslogger_packet_info_t *info, int8_t rssiRaw);
+} wslogger_filter_t;
+
+/// Frame being batched
+typedef struct wslogger_batch
+{
+    std::shared_ptr<std::vector<uint8_t>> frame; ///< Frame data, NULL if no frame is being batched
+    int64_t startTime;                           ///< Time the first record was added (microseconds)
+} wslogger_batch_t;
+
+/// State of a client that has set a filter
+typedef struct wslogger_filtered_client
+{
+    wslogger_filter_t filter; ///< Compiled filter
+    wslogger_batch_t batch;   ///< Frame batched for this client only
+} wslogger_filtered_client_t;
 
 /// WebSocket logger for streaming CC1101 packets to connected clients
-class WSLogger
+class WSLogger : public ThreadSafeService
 {
 public:
     WSLogger(ESP32SvelteKit *sveltekit);
@@ -47,17 +147,61 @@ public:
     /// Generate client ID for WebSocket connection
     String clientId(PsychicWebSocketClient *client);
 
-    /// Log CC1101 packet to all connected WebSocket clients
-    void logPacket(cc1101_packet_t *packet);
+    /// Log CC1101 packet to all connected WebSocket clients whose filter it passes (batched, see WEB_SOCKET_LOGGER_FLUSH_INTERVAL_US)
+    void logPacket(cc1101_packet_t *packet, const wslogger_packet_info_t *info);
+
+    /// Send batched packets that have been held back for longer than the flush interval (run when the oldest batch is due)
+    void loop();
+
+    /// Number of packets the history can hold
+    size_t historyCapacity() { return _historyCapacity; }
 
 private:
     static constexpr const char *TAG = "WSLogger"; ///< Log tag for WebSocket logger
 
+    ESP32SvelteKit *_sveltekit;         ///< ESP32SvelteKit framework instance
     SecurityManager *_securityManager;  ///< Security manager for connection filtering
     PsychicHttpServer *_server;         ///< HTTP server instance
     PsychicWebSocketHandler _webSocket; ///< WebSocket handler
     WSLoggerSettingsService _settings;  ///< Logger settings service
 
+    loop_task_id_t _flushTask;                               ///< Loop task sending batches once they are due
+    wslogger_batch_t _batch;                                 ///< Frame batched for all clients without filter
+    std::map<int, wslogger_filtered_client_t> _filteredClients; ///< Clients with a filter (by socket)
+    std::map<int, std::vector<PsychicWebSocketPayload>> _historyPending; ///< Live frames held back per client until its history is queued
+
+    wslogger_history_record_t *_history; ///< Ring of the last received packets (PSRAM if available)
+    size_t _historyCapacity;             ///< Number of records in the ring
+    uint32_t _historyWritten;            ///< Number of records written so far (sequence of the next record)
+    portMUX_TYPE _historyLock;           ///< Guards the ring, held only for copying a single record
+
+    /// Store a packet in the history ring (RX path: copy only, no allocation)
+    void _recordHistory(const wslogger_record_header_t *record, const uint8_t *data, uint64_t timestamp);
+
+    /// Copy a history record by sequence number, returns false if it has been overwritten or does not exist yet
+    bool _readHistory(uint32_t sequence, wslogger_history_record_t &record);
+
+    /// Stream the history to a newly connected client in large frames
+    void _streamHistory(PsychicWebSocketClient *client);
+
+    /// Handle REST request for the packet history within a time range
+    esp_err_t _handleGetHistory(PsychicRequest *request);
+
+    /// Append a record to a batch, flushing it first if the record does not fit (must be called within transaction)
+    void _appendRecord(wslogger_batch_t &batch, int socket, const wslogger_record_header_t *record, const uint8_t *data, uint64_t timestamp);
+
+    /// Send a batch to the given client (-1 for all clients without filter) and start a new one (must be called within transaction)
+    void _flushBatch(wslogger_batch_t &batch, int socket);
+
+    /// Queue a live frame to a client, held back while its history is being built (must be called within transaction)
+    void _queueLive(PsychicWebSocketClient *client, const PsychicWebSocketPayload &payload);
+
+    /// Compile a filter frame sent by a client, returns false if the frame is not a valid filter
+    bool _parseFilter(const char *json, size_t length, wslogger_filter_t &filter, bool &reset);
+
+    /// Apply a filter frame sent by a client
+    esp_err_t _handleFilterFrame(PsychicWebSocketClient *client, httpd_ws_frame *frame);
+
     /// Send client ID to newly connected client
     void transmitId(PsychicWebSocketClient *client);
 };
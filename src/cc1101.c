@@ -35,6 +35,7 @@
 #include <esp_timer.h> // Required for esp_timer_get_time (ISR-safe timing)
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "cc1101.h"
 
@@ -57,7 +58,8 @@ static const char *TAG = "cc1101";
 
 /* Timeout values as loop counters */
 #define CC1101_MISO_TIMEOUT_LOOPS 10000     // ~1-2ms at typical CPU speeds
-#define CC1101_GDO0_TIMEOUT_LOOPS 100000    // ~10-20ms at typical CPU speeds
+/* Timeout for the end of a packet transmission (signalled by GDO0 ISR) */
+#define CC1101_TX_DONE_TIMEOUT_MS 20
 
 /**
  * @brief Wait until SPI MISO line goes low with timeout
@@ -75,38 +77,6 @@ static inline bool wait_miso_low(void)
     return true;
 }
 
-/**
- * @brief Wait until GDO0 line goes high with timeout
- * @return true if GDO0 went high within timeout, false on timeout
- */
-static inline bool wait_gdo0_high(void)
-{
-    uint32_t timeout_counter = 0;
-    while (!gpio_get_level(CONFIG_GDO0_GPIO)) {
-        if (++timeout_counter > CC1101_GDO0_TIMEOUT_LOOPS) {
-            ESP_LOGE(TAG, "GDO0 timeout: line did not go high");
-            return false;
-        }
-    }
-    return true;
-}
-
-/**
- * @brief Wait until GDO0 line goes low with timeout
- * @return true if GDO0 went low within timeout, false on timeout
- */
-static inline bool wait_gdo0_low(void)
-{
-    uint32_t timeout_counter = 0;
-    while (gpio_get_level(CONFIG_GDO0_GPIO)) {
-        if (++timeout_counter > CC1101_GDO0_TIMEOUT_LOOPS) {
-            ESP_LOGE(TAG, "GDO0 timeout: line did not go low");
-            return false;
-        }
-    }
-    return true;
-}
-
 /* Read CC1101 configuration register value */
 #define READ_CONFIG_REG(regAddr, result) cc1101_read_reg(regAddr, CC1101_CONFIG_REGISTER, result)
 /* Read CC1101 status register */
@@ -123,6 +93,10 @@ static void (*_rx_callback)() = NULL;
 static uint32_t _last_rising_edge = 0; // Last rising edge timestamp for GDO0 in milliseconds
 static uint32_t _last_falling_edge = 0; // Last falling edge timestamp for GDO0 in milliseconds
 
+static SemaphoreHandle_t _tx_done = NULL; // Given by GDO0 ISR at the end of a transmitted packet
+static volatile int64_t _tx_sync_edge_us = 0; // Rising edge on GDO0 in TX mode (sync word sent), microseconds since boot
+static volatile int64_t _tx_end_edge_us = 0; // Falling edge on GDO0 in TX mode (packet sent), microseconds since boot
+
 static const uint8_t defaultCfg[] = {
     CC1101_DEFVAL_IOCFG2,
     CC1101_DEFVAL_IOCFG1,
@@ -251,12 +225,15 @@ static inline esp_err_t cc1101_read_rx_fifo(cc1101_packet_t *packet);
 static void IRAM_ATTR _rxtx_finish_isr(void *arg)
 {
     // Get current time using ISR-safe function (microseconds since boot)
-    uint32_t current_time_ms = (unsigned long)(esp_timer_get_time() / 1000ULL);
+    int64_t current_time_us = esp_timer_get_time();
+    uint32_t current_time_ms = (unsigned long)(current_time_us / 1000ULL);
     // Read current GPIO level to determine edge type
     int gpio_level = gpio_get_level(CONFIG_GDO0_GPIO);
     
     if (gpio_level == 1) {  // Rising edge detected
         _last_rising_edge = current_time_ms;
+        if (_mode == CCM_TX)
+            _tx_sync_edge_us = current_time_us;
     } else {    // Falling edge detected
         _last_falling_edge = current_time_ms;
         
@@ -265,6 +242,15 @@ static void IRAM_ATTR _rxtx_finish_isr(void *arg)
         {
             _rx_callback();
         }
+        else if (_mode == CCM_TX && _tx_done != NULL)
+        {
+            // Wake the task waiting for the end of the transmission
+            BaseType_t higher_priority_task_woken = pdFALSE;
+            _tx_end_edge_us = current_time_us;
+            xSemaphoreGiveFromISR(_tx_done, &higher_priority_task_woken);
+            if (higher_priority_task_woken == pdTRUE)
+                portYIELD_FROM_ISR();
+        }
     }
 }
 
@@ -499,6 +485,12 @@ esp_err_t cc1101_init(void (*rx_callback)())
 
     /* Configure interrupt on GDO0 */
     _rx_callback = rx_callback;
+    _tx_done = xSemaphoreCreateBinary();
+    if (_tx_done == NULL)
+    {
+        ESP_LOGE(TAG, "TX done semaphore could not be created.");
+        return ESP_FAIL;
+    }
     gpio_config_t io_conf = {
         .intr_type = GPIO_INTR_ANYEDGE, // GPIO interrupt type : both rising and falling edges
         .pin_bit_mask = 1ULL << CONFIG_GDO0_GPIO,
@@ -639,7 +631,7 @@ static inline esp_err_t cc1101_read_rx_fifo(cc1101_packet_t *packet)
     return ESP_OK;
 }
 
-static inline esp_err_t cc1101_write_tx_fifo(unsigned char *tx_data, size_t length)
+static inline esp_err_t cc1101_write_tx_fifo(unsigned char *tx_data, size_t length, cc1101_tx_timing_t *timing)
 {
     if (!tx_data)
     {
@@ -655,16 +647,32 @@ static inline esp_err_t cc1101_write_tx_fifo(unsigned char *tx_data, size_t leng
 
     uint8_t marcState;
 
+    int64_t start = esp_timer_get_time();
+
+    // Discard a completion signalled for a previous packet
+    xSemaphoreTake(_tx_done, 0);
+    _tx_sync_edge_us = 0;
+
     cc1101_write_reg(CC1101_TXFIFO, length); // Set data length at the first position of the TX FIFO
     cc1101_write_burst_reg(CC1101_TXFIFO, tx_data, length);
     cc1101_set_tx_state();
 
-    // Wait for the sync word to be transmitted
-    if (!wait_gdo0_high()) {
-        return ESP_ERR_TIMEOUT;
+    int64_t written = esp_timer_get_time();
+
+    // Block until the GDO0 ISR signals the end of the packet (falling edge), the CPU is free meanwhile
+    bool finished = xSemaphoreTake(_tx_done, pdMS_TO_TICKS(CC1101_TX_DONE_TIMEOUT_MS)) == pdTRUE;
+    int64_t woken = esp_timer_get_time();
+
+    if (timing) {
+        int64_t sync_edge = _tx_sync_edge_us;
+        timing->fifo_write_us = (uint32_t)(written - start);
+        timing->gdo0_high_wait_us = sync_edge > written ? (uint32_t)(sync_edge - written) : 0;
+        timing->gdo0_low_wait_us = finished && sync_edge > written ? (uint32_t)(_tx_end_edge_us - sync_edge) : 0;
+        timing->cpu_us = timing->fifo_write_us + (uint32_t)(esp_timer_get_time() - woken);
     }
-    // Wait until the end of the packet transmission
-    if (!wait_gdo0_low()) {
+
+    if (!finished) {
+        ESP_LOGE(TAG, "GDO0 timeout: end of packet transmission not signalled");
         return ESP_ERR_TIMEOUT;
     }
 
@@ -686,7 +694,12 @@ esp_err_t cc1101_receive_data(cc1101_packet_t *packet)
 
 esp_err_t cc1101_send_data(unsigned char *tx_data, size_t length)
 {
-    esp_err_t ret = cc1101_write_tx_fifo(tx_data, length);
+    return cc1101_send_data_timed(tx_data, length, NULL);
+}
+
+esp_err_t cc1101_send_data_timed(unsigned char *tx_data, size_t length, cc1101_tx_timing_t *timing)
+{
+    esp_err_t ret = cc1101_write_tx_fifo(tx_data, length, timing);
 
     if (ret != ESP_OK)
         cc1101_flush_tx_fifo();
@@ -260,6 +260,20 @@ typedef struct cc1101_packet {
 	size_t length;
 } cc1101_packet_t;
 
+/**
+ * Timing of a single packet transmission (all durations in microseconds)
+ */
+typedef struct cc1101_tx_timing {
+	/* Time to write length byte and data to the TX FIFO and strobe STX */
+	uint32_t fifo_write_us;
+	/* Time from STX until GDO0 asserted (sync word sent) */
+	uint32_t gdo0_high_wait_us;
+	/* Time from sync word until GDO0 deasserted (end of packet) */
+	uint32_t gdo0_low_wait_us;
+	/* CPU time spent by the calling task (the wait for GDO0 blocks) */
+	uint32_t cpu_us;
+} cc1101_tx_timing_t;
+
 /**
  * @brief Initialize CC1101 radio controller
  * 
@@ -316,6 +330,18 @@ esp_err_t cc1101_receive_data(cc1101_packet_t *packet);
  */
 esp_err_t cc1101_send_data(unsigned char *tx_data, size_t length);
 
+/**
+ * @brief Send data via CC1101 and measure the timing of the transmission phases.
+ * @details Same as cc1101_send_data(), additionally fills the timing of FIFO write and GDO0 waits.
+ * 
+ * @param tx_data Data to be sent
+ * @param length Length of the data to be sent
+ * @param[out] timing Measured durations, may be NULL
+ * 
+ * @return Same as cc1101_send_data()
+ */
+esp_err_t cc1101_send_data_timed(unsigned char *tx_data, size_t length, cc1101_tx_timing_t *timing);
+
 /**
  * @brief Check if RX FIFO has overflowed. If so, flush RX FIFO and set CC1101 to RX state.
  * @param[in] fail_on_any_data If true, the RX FIFO flushing and setting CC1101 to RX state will also be done if there is any data in the RX FIFO.